@@ -0,0 +1,170 @@
+/**
+ * File: admission.h
+ *       Transfer Admission Control Header File.
+ *
+ *       Bounds the number of concurrent transfers of a process: requests
+ *       received while all the transfer slots are taken wait in a bounded
+ *       pending queue and are started, high priority requests first, as soon
+ *       as a transfer terminates. Requests for files matching one of the
+ *       --priority patterns, such as boot files, are high priority. When the
+ *       queue is full the request is refused with a "Server busy" error
+ *       message, unless a high priority request can take the place of the
+ *       last queued normal one.
+ *
+ *       Requests waiting longer than ADMISSION_MAX_WAIT are dropped when
+ *       dequeued: their clients already gave up or retransmitted them.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "common.h"
+#include "tftp_session.h"
+
+/**
+ * Default maximum number of concurrent transfers.
+ */
+#define ADMISSION_MAX_TRANSFERS 256
+
+/**
+ * Default and maximum number of pending requests.
+ */
+#define ADMISSION_QUEUE_LEN 64
+#define ADMISSION_QUEUE_MAX 256
+
+/**
+ * Maximum number of priority patterns.
+ */
+#define ADMISSION_PATTERNS 16
+
+/**
+ * Maximum time a request may wait in the pending queue (ms).
+ */
+#define ADMISSION_MAX_WAIT 10000
+
+/**
+ * Priority classes of the pending requests.
+ */
+typedef enum {
+	PRIORITY_HIGH,		// files matching a priority pattern
+	PRIORITY_NORMAL,	// all the other files
+	PRIORITIES
+} Priority;
+
+/**
+ * Outcome of a received request.
+ */
+typedef enum {
+	ADMIT_START,		// start the transfer now
+	ADMIT_QUEUED,		// queued until a transfer terminates
+	ADMIT_DUPLICATE,	// retransmission of a queued request
+	ADMIT_BUSY		// refused, a busy error was sent
+} AdmissionResult;
+
+/**
+ * A request waiting for a transfer slot.
+ */
+typedef struct {
+	Request req;			// the received request
+	struct sockaddr_in cli_addr;	// client address
+	uint64_t queued_at;		// enqueue time (ms)
+} PendingRequest;
+
+/**
+ * Pending requests of a priority class, a ring buffer.
+ */
+typedef struct {
+	PendingRequest entries[ADMISSION_QUEUE_MAX];	// queued requests
+	int head;					// oldest request
+	int count;					// queued requests
+} PendingQueue;
+
+/**
+ * Admission control statistics.
+ */
+typedef struct {
+	uint64_t started;	// transfers started without waiting
+	uint64_t queued;	// requests queued
+	uint64_t dequeued;	// queued requests started
+	uint64_t duplicates;	// retransmitted queued requests absorbed
+	uint64_t busy;		// requests refused with a busy error
+	uint64_t displaced;	// normal requests displaced by high ones
+	uint64_t expired;	// queued requests dropped after waiting too long
+	uint64_t wait_total;	// total wait of the dequeued requests (ms)
+	uint64_t wait_max;	// longest wait of a dequeued request (ms)
+	int max_depth;		// deepest pending queue
+} AdmissionStats;
+
+/**
+ * Transfer admission control state.
+ */
+typedef struct {
+	int max_transfers;		// concurrent transfers cap
+	int queue_len;			// pending requests cap
+	const char *patterns[ADMISSION_PATTERNS];
+					// high priority file patterns
+	int patterns_count;		// priority patterns
+	int active;			// transfers running
+	PendingQueue queues[PRIORITIES];	// pending requests
+	AdmissionStats stats;		// admission statistics
+} Admission;
+
+/**
+ * Admission control of the current process.
+ */
+extern Admission admission;
+
+/**
+ * Adds a priority pattern: requests for files matching the given shell
+ * wildcard pattern (fnmatch) are high priority.
+ *
+ * @param  pattern  the pattern, kept as given.
+ *
+ * @return  0 on success, -1 if too many patterns were given.
+ */
+int admission_add_pattern(const char *pattern);
+
+/**
+ * Admits the given request: a transfer slot is taken if the request can be
+ * started, otherwise the request is queued or refused with a busy error
+ * message sent on the given socket.
+ *
+ * @param  socket    socket used to send busy error messages;
+ * @param  req       the received request;
+ * @param  cli_addr  client address.
+ *
+ * @return  the admission outcome.
+ */
+AdmissionResult admission_request(int socket, const Request *req,
+				  const struct sockaddr_in *cli_addr);
+
+/**
+ * Releases the transfer slot of a terminated transfer, or of a transfer which
+ * could not be started.
+ */
+void admission_done();
+
+/**
+ * Dequeues the next pending request if a transfer slot is free, taking it.
+ *
+ * @param  req       the dequeued request to be set;
+ * @param  cli_addr  its client address to be set.
+ *
+ * @return  1 if a request was dequeued, 0 otherwise.
+ */
+int admission_next(Request *req, struct sockaddr_in *cli_addr);
+
+/**
+ * Prints the admission control statistics using the given log function.
+ *
+ * @param  log  log function.
+ */
+void admission_print_stats(void (*log)(LogType, const char *));
+
+#endif
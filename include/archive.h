@@ -0,0 +1,109 @@
+/**
+ * File: archive.h
+ *       Serving Archive Header File.
+ *
+ *       A serving archive packs a whole immutable directory tree in a single
+ *       file, built offline by tftp_pack and mapped by the server at startup:
+ *       requests are then served without any open(), stat() or read() call,
+ *       so the latency no longer depends on the file system metadata.
+ *
+ *       The archive starts with a header, followed by an open addressing hash
+ *       index of the file names (FNV-1a, linear probing, at most half full),
+ *       the file names and finally the file contents, each one aligned to
+ *       ARCHIVE_ALIGN bytes. Integers are stored in the byte order of the
+ *       machine building the archive, checked through the magic number.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+
+/**
+ * Archive magic number and format version.
+ */
+#define ARCHIVE_MAGIC 0x4b43415050544654ULL	// "TFTPPACK"
+#define ARCHIVE_VERSION 1
+
+/**
+ * Alignment of the file contents in the archive: a page, so that each file
+ * can be advised to the kernel on its own.
+ */
+#define ARCHIVE_ALIGN 4096
+
+/**
+ * Archive header.
+ */
+typedef struct {
+	uint64_t magic;		// ARCHIVE_MAGIC
+	uint32_t version;	// ARCHIVE_VERSION
+	uint32_t align;		// file contents alignment
+	uint64_t count;		// number of files
+	uint64_t index_size;	// index slots (power of 2)
+	uint64_t index_offset;	// offset of the index
+	uint64_t size;		// archive size
+} ArchiveHeader;
+
+/**
+ * An index slot, empty if the name length is 0.
+ */
+typedef struct {
+	uint32_t hash;		// hash of the file name
+	uint32_t name_len;	// file name length
+	uint64_t name_offset;	// offset of the file name
+	uint64_t offset;	// offset of the file contents
+	uint64_t size;		// file size
+} ArchiveEntry;
+
+/**
+ * A mapped archive.
+ */
+typedef struct {
+	char *map;			// archive mapping, NULL if not loaded
+	uint64_t size;			// archive size
+	const ArchiveHeader *header;	// archive header
+	const ArchiveEntry *index;	// file names index
+} Archive;
+
+/**
+ * Computes the index hash of the given file name (FNV-1a).
+ *
+ * @param  name  file name;
+ * @param  len   file name length.
+ *
+ * @return  the hash.
+ */
+uint32_t archive_hash(const char *name, uint32_t len);
+
+/**
+ * Maps the given archive file and checks its header and index.
+ *
+ * @param  archive  the archive to be loaded;
+ * @param  path     path of the archive file.
+ *
+ * @return  0 on success, -1 if the file can not be mapped or is not a valid
+ *          archive.
+ */
+int archive_open(Archive *archive, const char *path);
+
+/**
+ * Looks for the given file name in the archive.
+ *
+ * @param  archive  the archive;
+ * @param  name     file name, relative to the packed directory.
+ *
+ * @return  the file entry or NULL if the file is not in the archive.
+ */
+const ArchiveEntry *archive_lookup(const Archive *archive, const char *name);
+
+/**
+ * Unmaps the given archive.
+ *
+ * @param  archive  the archive to be unloaded.
+ */
+void archive_close(Archive *archive);
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * File: async_writer.h
+ *       Asynchronous File Writer Header File.
+ *
+ *       Received payloads are copied into a ring of large buffers and written
+ *       to the destination file by a dedicated thread, each pwritev() call
+ *       covering all the buffers filled in the meantime. The receiver only
+ *       waits for the disk when the whole ring is full: a slow disk costs at
+ *       most the ring memory instead of stalling the ACKs.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "common.h"
+
+/**
+ * Number of buffers of the ring.
+ */
+#define WRITER_SLOTS 16
+
+/**
+ * Size of each buffer of the ring.
+ */
+#define WRITER_SLOT_SIZE (256 * 1024)
+
+/**
+ * An asynchronous writer of a single destination file.
+ */
+typedef struct {
+	int fd;				// destination file descriptor
+	char *buffers;			// ring buffers
+	int head;			// first buffer waiting to be written
+	int count;			// buffers waiting to be written
+	int fill_len;			// bytes in the buffer being filled
+	uint64_t offset;		// file offset of the first waiting byte
+	int closing;			// 1 once no more data will be queued
+	int error;			// errno of the first failed write
+	uint64_t bytes;			// bytes written
+	uint64_t writes;		// pwritev() calls
+	uint64_t stalls;		// times the receiver waited for the disk
+	pthread_mutex_t lock;		// protects the ring state
+	pthread_cond_t not_empty;	// signalled when a buffer is queued
+	pthread_cond_t not_full;	// signalled when a buffer is written
+	pthread_t thread;		// writer thread
+} AsyncWriter;
+
+/**
+ * Creates the given destination file and starts its writer thread. If the
+ * final size is known, the file space is allocated at once.
+ *
+ * @param  path  destination file path;
+ * @param  size  final file size, 0 if unknown.
+ *
+ * @return  the new writer or NULL in case of error (errno is set).
+ */
+AsyncWriter *writer_open(const char *path, uint64_t size);
+
+/**
+ * Queues the given data to be written after the data already queued. Blocks
+ * only if all the ring buffers are waiting to be written.
+ *
+ * @param  writer  the writer;
+ * @param  data    data to be written;
+ * @param  len     data length.
+ *
+ * @return  0 on success, -1 if a previous write failed (errno is set).
+ */
+int writer_write(AsyncWriter *writer, const char *data, size_t len);
+
+/**
+ * Writes all the queued data, stops the writer thread, truncates the file to
+ * the data written and closes it.
+ *
+ * @param  writer  the writer to be closed.
+ *
+ * @return  0 on success, -1 if any write failed (errno is set).
+ */
+int writer_close(AsyncWriter *writer);
+
+#endif
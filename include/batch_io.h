@@ -0,0 +1,183 @@
+/**
+ * File: batch_io.h
+ *       Batched Socket I/O Header File.
+ *
+ *       Outgoing packets are collected in a batch and sent with a single
+ *       sendmmsg() call, while incoming packets are drained with recvmmsg().
+ *       Every call updates a histogram of the batch sizes, so that the batching
+ *       can be tuned looking at how many packets each system call actually
+ *       moves. Including files must define _GNU_SOURCE for struct mmsghdr.
+ *
+ *       Consecutive packets of the same length sent to the same address, as
+ *       the DATA packets of a window are, go out as a single UDP GSO buffer
+ *       (UDP_SEGMENT): the kernel splits it into one datagram per packet, each
+ *       one carrying its own header. If the kernel or the device does not
+ *       support GSO, the packets are sent again with sendmmsg() and GSO is
+ *       disabled for the rest of the process life.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "common.h"
+
+/**
+ * Maximum number of packets moved by a single system call.
+ */
+#define MAX_BATCH 64
+
+/**
+ * Maximum number of segments of a single UDP GSO buffer (UDP_MAX_SEGMENTS of
+ * older kernels).
+ */
+#define MAX_GSO_SEGMENTS 64
+
+/**
+ * Maximum size of a single UDP GSO buffer: the largest IPv4 UDP payload.
+ */
+#define MAX_GSO_BYTES 65507
+
+/**
+ * Number of buckets of the batch sizes histograms: bucket i counts the calls
+ * moving between 2^i and 2^(i+1) - 1 packets.
+ */
+#define BATCH_BUCKETS 7
+
+/**
+ * Outgoing packets waiting to be sent on the same socket. Each packet is made
+ * of a header and a payload, which are gathered by the kernel.
+ */
+typedef struct {
+	int sock;				// socket the batch is sent on
+	int count;				// packets in the batch
+	struct mmsghdr msgs[MAX_BATCH];		// packets headers
+	struct iovec iov[MAX_BATCH][2];		// packets header and payload
+} SendBatch;
+
+/**
+ * Incoming packets received from the same socket.
+ */
+typedef struct {
+	int capacity;				// packets received at most per call
+	int size;				// size of each buffer
+	char *buffers;				// packets buffers
+	struct mmsghdr msgs[MAX_BATCH];		// packets headers
+	struct iovec iov[MAX_BATCH];		// packets buffers
+	struct sockaddr_in addrs[MAX_BATCH];	// packets sender addresses
+} RecvBatch;
+
+/**
+ * Batching counters.
+ */
+typedef struct {
+	uint64_t send_calls;			// sendmmsg() calls
+	uint64_t send_packets;			// packets sent
+	uint64_t send_hist[BATCH_BUCKETS];	// sendmmsg() batch sizes
+	uint64_t recv_calls;			// recvmmsg() calls
+	uint64_t recv_packets;			// packets received
+	uint64_t recv_hist[BATCH_BUCKETS];	// recvmmsg() batch sizes
+	uint64_t gso_calls;			// UDP GSO buffers sent
+	uint64_t gso_segments;			// packets sent as GSO segments
+	uint64_t gso_fallbacks;			// GSO buffers sent again
+} BatchStats;
+
+/**
+ * Batching counters of the current process.
+ */
+extern BatchStats batch_stats;
+
+/**
+ * Set to 1 to send runs of same length packets as UDP GSO buffers. Cleared as
+ * soon as the kernel refuses a GSO buffer.
+ */
+extern int gso_enabled;
+
+/**
+ * Initializes an empty send batch for the given socket.
+ *
+ * @param  batch  the batch to be initialized;
+ * @param  sock   the socket the batch is sent on.
+ */
+void batch_init(SendBatch *batch, int sock);
+
+/**
+ * Adds a packet to the given batch, flushing the batch first if it is full.
+ * Header and payload are not copied and must stay valid until the batch is
+ * flushed.
+ *
+ * @param  batch        the batch;
+ * @param  addr         recipient address;
+ * @param  header       packet header;
+ * @param  header_len   packet header length;
+ * @param  data         packet payload.
+ */
+void batch_add(SendBatch *batch, const struct sockaddr_in *addr, char *header,
+	       int header_len, const struct iovec *data);
+
+/**
+ * Sends all the packets of the given batch with a single sendmmsg() call, runs
+ * of packets of the same length gathered into UDP GSO buffers when enabled.
+ *
+ * @param  batch  the batch to be sent.
+ *
+ * @return  the number of packets sent or -1 in case of error.
+ */
+int batch_flush(SendBatch *batch);
+
+/**
+ * Allocates the buffers of the given receive batch.
+ *
+ * @param  batch  the batch to be allocated;
+ * @param  count  number of packets received at most per call;
+ * @param  size   size of each packet buffer.
+ *
+ * @return  0 on success, -1 if the buffers could not be allocated.
+ */
+int batch_recv_alloc(RecvBatch *batch, int count, int size);
+
+/**
+ * Frees the buffers of the given receive batch.
+ *
+ * @param  batch  the batch to be freed.
+ */
+void batch_recv_free(RecvBatch *batch);
+
+/**
+ * Receives up to the batch capacity packets waiting on the given socket.
+ *
+ * @param  sock   the socket to read;
+ * @param  batch  the batch to be filled;
+ * @param  flags  recvmmsg() flags: MSG_DONTWAIT to never block, MSG_WAITFORONE
+ *                to block only until the first packet is received.
+ *
+ * @return  the number of packets received, -1 in case of error (errno is set).
+ */
+int batch_recv(int sock, RecvBatch *batch, int flags);
+
+/**
+ * Returns the i-th packet of the given receive batch.
+ *
+ * @param  batch  the receive batch;
+ * @param  i      packet index;
+ * @param  len    packet length to be set.
+ *
+ * @return  the packet buffer.
+ */
+char *batch_packet(RecvBatch *batch, int i, int *len);
+
+/**
+ * Prints the batching counters using the given log function.
+ *
+ * @param  log  log function.
+ */
+void batch_print_stats(void (*log)(LogType, const char *));
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * File: block_cache.h
+ *       File Block Cache Header File.
+ *
+ *       Contents of the most requested files kept in memory, shared by all the
+ *       transfers served by the process: boot storms have many clients pull
+ *       the same few files at once. Each file is stored as a single buffer
+ *       already in its transfer encoding (netascii files are cached
+ *       separately), so that every DATA payload is a pointer into the buffer
+ *       whatever the negotiated block size.
+ *
+ *       Files are loaded on demand: each transfer reading past the loaded
+ *       contents loads the next chunks, up to the end of its window, so a cold
+ *       file costs no more per window than a pread() source and never stalls
+ *       the other transfers of the process. The contents and their loading
+ *       state live in a shared mapping, so the children forked by the
+ *       fork-per-request listener load and read the same copy of each file.
+ *       Workers and pool processes are started before any file is cached:
+ *       each one keeps its own cache.
+ *
+ *       The cache holds at most a given number of bytes, text mode files being
+ *       charged twice their size, the largest netascii encoding. When room is
+ *       needed, unused files are evicted with the CLOCK algorithm: the hand
+ *       sweeps the entries, giving a second chance to the ones referenced
+ *       since its last pass. A cached file is checked against the file system
+ *       on every request and invalidated once its inode, size or modification
+ *       time change, or once it could not be read; transfers still reading an
+ *       invalidated file keep their copy until they end.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "common.h"
+
+/**
+ * Default memory budget of the cache (bytes).
+ */
+#define CACHE_BUDGET (64 * 1024 * 1024)
+
+/**
+ * Maximum number of cached files.
+ */
+#define CACHE_ENTRIES 1024
+
+/**
+ * Bytes of a file read by each load.
+ */
+#define CACHE_CHUNK (256 * 1024)
+
+/**
+ * Loading state of a cached file, stored in the shared mapping right before
+ * the contents.
+ */
+typedef struct {
+	pthread_mutex_t lock;	// serializes the loads of all the processes
+	uint64_t read;		// file bytes read
+	uint64_t loaded;	// contents bytes available
+	int complete;		// 1 once the whole file is loaded
+	int failed;		// 1 if the file could not be read
+} CacheFill;
+
+/**
+ * A cached file.
+ */
+typedef struct {
+	char *path;		// file path
+	uint32_t hash;		// hash of path and encoding
+	int netascii;		// 1 if the contents are netascii encoded
+	int fd;			// descriptor the contents are loaded from
+	dev_t dev;		// device of the cached file
+	ino_t ino;		// inode of the cached file
+	off_t size;		// size of the cached file
+	struct timespec mtime;	// modification time of the cached file
+	CacheFill *fill;	// shared mapping: loading state and contents
+	char *data;		// file contents in their transfer encoding
+	uint64_t reserved;	// contents bytes charged to the budget
+	int refs;		// transfers reading the contents
+	int referenced;		// 1 if used since the last CLOCK pass
+	int stale;		// 1 once invalidated, freed with the last
+				// reference
+} CachedFile;
+
+/**
+ * Cache statistics.
+ */
+typedef struct {
+	uint64_t hits;		// requests served from memory
+	uint64_t misses;	// requests adding the file
+	uint64_t evictions;	// files evicted to make room
+	uint64_t invalidations;	// cached files changed on disk
+	uint64_t bypasses;	// files not fitting the cache
+	uint64_t loaded;	// bytes loaded from disk by the process
+} CacheStats;
+
+/**
+ * File block cache.
+ */
+typedef struct {
+	CachedFile *entries[CACHE_ENTRIES];	// cached files, NULL if empty
+	int hand;				// CLOCK hand
+	uint64_t budget;			// maximum bytes held
+	uint64_t used;				// bytes held, invalidated
+						// files still in use included
+	int count;				// cached files
+	CacheStats stats;			// cache statistics
+} BlockCache;
+
+/**
+ * Block cache of the current process.
+ */
+extern BlockCache block_cache;
+
+/**
+ * Sets the memory budget of the cache of the current process.
+ *
+ * @param  budget  maximum bytes held by the cache.
+ */
+void cache_init(uint64_t budget);
+
+/**
+ * Returns the cached file of the given open file in the requested encoding,
+ * adding it to the cache if not cached yet or changed on disk. No contents are
+ * loaded here: the cached file keeps its own descriptor and is loaded by
+ * cache_fill(). The given descriptor is left open, the returned file stays
+ * valid until released.
+ *
+ * @param  fd        descriptor of the file;
+ * @param  path      full path of the file, the cache key;
+ * @param  netascii  1 for netascii encoded contents.
+ *
+ * @return  the cached file, or NULL if the file can not be cached or does not
+ *          fit the cache (errno is set).
+ */
+CachedFile *cache_acquire(int fd, const char *path, int netascii);
+
+/**
+ * Loads the contents of the given cached file up to the given length, unless
+ * already loaded by another transfer or process.
+ *
+ * @param  file  the cached file;
+ * @param  end   contents length needed;
+ * @param  len   available contents length to be set, at least end unless the
+ *               whole file is loaded, the contents length then.
+ *
+ * @return  0 on success, -1 if the file could not be read.
+ */
+int cache_fill(CachedFile *file, uint64_t end, uint64_t *len);
+
+/**
+ * Releases a file returned by cache_acquire().
+ *
+ * @param  file  the cached file.
+ */
+void cache_release(CachedFile *file);
+
+/**
+ * Prints the cache statistics using the given log function.
+ *
+ * @param  log  log function.
+ */
+void cache_print_stats(void (*log)(LogType, const char *));
+
+#endif
@@ -0,0 +1,150 @@
+/**
+ * File: block_source.h
+ *       File Block Source Header File.
+ *
+ *       A block source hands out whole blocks of the transferred file, placed
+ *       by the reader directly where the DATA packet payload goes, right after
+ *       the 4 bytes header. Two strategies are available: a pread() based
+ *       reader filling a whole window of packet buffers with a single preadv()
+ *       call, and a mmap() based reader handing out pointers into the file
+ *       mapping without copying the data at all.
+ *
+ *       A third strategy hands out pointers into the contents of the file
+ *       kept by the block cache, shared by all the transfers of the same file
+ *       and already in their transfer encoding, loading them up to the end of
+ *       each window, while files packed in a serving archive are read straight
+ *       from the archive mapping.
+ *
+ *       Text mode sources add a netascii encoding stage: the file is read in
+ *       chunks, through pread() or the archive mapping, and encoded into the
+ *       packet buffers. The expansion makes block boundaries independent from
+ *       file offsets, so the blocks are always copied.
+ *
+ *       A file truncated while mapped raises SIGBUS when the missing pages are
+ *       read in user space: the mmap() strategy is used in binary mode only,
+ *       where the pages are read by the kernel while sending, and the file size
+ *       is checked before each window is handed out. A truncated file cancels
+ *       the transfer with both strategies.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef BLOCK_SOURCE_H
+#define BLOCK_SOURCE_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "common.h"
+#include "netascii.h"
+#include "block_cache.h"
+
+/**
+ * Size of the chunks read by text mode sources using the pread() strategy.
+ */
+#define STAGE_SIZE 65536
+
+/**
+ * Available block source strategies.
+ */
+typedef enum {
+	SOURCE_PREAD,		// preadv() into the packet buffers
+	SOURCE_MMAP,		// pointers into a MADV_SEQUENTIAL file mapping
+	SOURCE_CACHE,		// pointers into the block cache contents
+	SOURCE_ARCHIVE		// pointers into the serving archive mapping
+} SourceType;
+
+/**
+ * An opened file block source.
+ */
+typedef struct {
+	SourceType type;	// block source strategy
+	int fd;			// source file descriptor
+	uint64_t size;		// file size when the source was opened
+	uint64_t offset;	// offset of the next block
+	int eof;		// 1 once the last block has been handed out
+	char *map;		// file mapping or cached contents
+	CachedFile *cached;	// cached file (SOURCE_CACHE only)
+	int netascii;		// 1 to encode the blocks as netascii
+	NetasciiEncoder encoder;	// netascii encoder state
+	char *stage;		// file bytes to be encoded
+	size_t stage_len;	// file bytes available in the stage
+	size_t stage_pos;	// file bytes already encoded
+	char *stage_buf;	// chunk buffer (SOURCE_PREAD only)
+} BlockSource;
+
+/**
+ * Opens the given file as a block source using the given strategy. If the file
+ * can not be mapped or cached, or is mapped in text mode, the pread() strategy
+ * is used.
+ *
+ * @param  path      path of the file to be opened;
+ * @param  type      block source strategy;
+ * @param  netascii  1 to encode the blocks as netascii.
+ *
+ * @return  the new block source or NULL in case of error (errno is set).
+ */
+BlockSource *block_source_open(const char *path, SourceType type,
+			       int netascii);
+
+/**
+ * Opens a block source reading the given open file using the given strategy,
+ * as block_source_open() does. The descriptor is owned by the block source,
+ * even in case of error: cached files are loaded from a descriptor of their
+ * own, the given one is then closed.
+ *
+ * @param  fd        descriptor of the file to be read;
+ * @param  path      full path of the file, the block cache key (SOURCE_CACHE
+ *                   only);
+ * @param  size      file size;
+ * @param  type      block source strategy, SOURCE_PREAD, SOURCE_MMAP or
+ *                   SOURCE_CACHE;
+ * @param  netascii  1 to encode the blocks as netascii.
+ *
+ * @return  the new block source or NULL in case of error (errno is set).
+ */
+BlockSource *block_source_fd(int fd, const char *path, uint64_t size,
+			     SourceType type, int netascii);
+
+/**
+ * Opens a block source reading the given file contents, already in memory
+ * and outliving the block source.
+ *
+ * @param  data      file contents;
+ * @param  size      file size;
+ * @param  netascii  1 to encode the blocks as netascii.
+ *
+ * @return  the new block source or NULL in case of error.
+ */
+BlockSource *block_source_memory(const char *data, uint64_t size,
+				 int netascii);
+
+/**
+ * Reads the next blocks of the file. On input the iov_base of each given
+ * block points to a buffer of blksize bytes; on return iov_base points to the
+ * block data, either still the given buffer or the file mapping, and iov_len
+ * holds the block length. A block shorter than blksize is the last block of
+ * the file: a zero length block is returned for files whose size is a
+ * multiple of the block size.
+ *
+ * @param  src      the block source;
+ * @param  blocks   blocks to be filled;
+ * @param  count    number of blocks to be filled;
+ * @param  blksize  block size.
+ *
+ * @return  the number of blocks filled, less than count once the last block
+ *          has been returned, or -1 in case of error.
+ */
+int block_source_read(BlockSource *src, struct iovec *blocks, int count,
+		      int blksize);
+
+/**
+ * Releases the file mapping or the cached file and closes the given block
+ * source.
+ *
+ * @param  src  the block source to be closed.
+ */
+void block_source_close(BlockSource *src);
+
+#endif
@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 /**
  * Set this to 1 to enable debugging log messages.
@@ -28,10 +29,44 @@
  */
 #define MAX 512
 
+/**
+ * Minimum and maximum block sizes negotiable with the blksize option (RFC
+ * 2348).
+ */
+#define MIN_BLKSIZE 8
+#define MAX_BLKSIZE 65464
+
 /**
  * Char array used for formatted log messages.
  */
-char log_message[1024];
+extern char log_message[1024];
+
+/**
+ * TFTP packet opcodes.
+ */
+typedef enum {
+	OP_RRQ = 1,	// read request
+	OP_WRQ = 2,	// write request
+	OP_DATA = 3,	// data packet
+	OP_ACK = 4,	// acknowledgment
+	OP_ERROR = 5,	// error packet
+	OP_OACK = 6	// option acknowledgment (RFC 2347)
+} Opcode;
+
+/**
+ * TFTP error codes.
+ */
+typedef enum {
+	ERR_UNDEFINED = 0,	// not defined, see error message
+	ERR_NOT_FOUND = 1,	// file not found
+	ERR_ACCESS = 2,		// access violation
+	ERR_DISK_FULL = 3,	// disk full or allocation exceeded
+	ERR_ILLEGAL_OP = 4,	// illegal TFTP operation
+	ERR_UNKNOWN_TID = 5,	// unknown transfer ID
+	ERR_FILE_EXISTS = 6,	// file already exists
+	ERR_NO_USER = 7,	// no such user
+	ERR_OPTION = 8		// options negotiation refused (RFC 2347)
+} ErrorCode;
 
 /**
  * Available types for log messages.
@@ -69,4 +104,45 @@ void child_log(LogType type, const char *message);
  */
 void check_errno(int ret, char *info);
 
+/**
+ * Returns the current value of the monotonic clock in milliseconds. Used to
+ * compute retransmission deadlines, it is not affected by system time changes.
+ *
+ * @return  monotonic time in milliseconds.
+ */
+uint64_t get_time_ms();
+
+/**
+ * Returns the current value of the monotonic clock in microseconds. Used to
+ * measure round trip times.
+ *
+ * @return  monotonic time in microseconds.
+ */
+uint64_t get_time_us();
+
+/**
+ * Returns the block number carried on the wire by the given block of a
+ * transfer: block numbers are 16 bits wide, after block 65535 they restart
+ * from the rollover value, 0 unless 1 was negotiated with the rollover option.
+ *
+ * @param  block     block index, starting from 1 for the first DATA packet;
+ * @param  rollover  block number following 65535 (0 or 1).
+ *
+ * @return  the wire block number.
+ */
+uint16_t wrap_block(uint64_t block, int rollover);
+
+/**
+ * Returns the number of blocks from the given wire block number to the
+ * following one, taking the rollover into account. Block 0 only precedes
+ * block 1 when the rollover value is 1.
+ *
+ * @param  from      wire block number;
+ * @param  to        following wire block number;
+ * @param  rollover  block number following 65535 (0 or 1).
+ *
+ * @return  the number of blocks, 65535 if to can not follow from.
+ */
+uint16_t block_distance(uint16_t from, uint16_t to, int rollover);
+
 #endif
@@ -0,0 +1,207 @@
+/**
+ * File: congestion.h
+ *       Congestion Control Header File.
+ *
+ *       Congestion window of a windowed download, bounded by the negotiated
+ *       window size: slow start up to the slow start threshold, then additive
+ *       increase of one block per window delivered, and multiplicative
+ *       decrease on loss (RFC 5681). Losses are reported by the client as an
+ *       ACK before the end of the window, the duplicate ACK of RFC 7440; a
+ *       timeout restarts from a single block, and is undone if the blocks it
+ *       sent again were not lost. Losses and timeouts with no queue building
+ *       up at the bottleneck are random and leave the window unchanged.
+ *
+ *       RFC 7440 clients only acknowledge whole windows, so the congestion
+ *       window can not bound the blocks in flight: it bounds the blocks sent
+ *       per round trip instead. A window bigger than the congestion window is
+ *       paced in rounds of one smoothed round trip time each, and a round not
+ *       reported lost by the end of the next one counts as delivered. The
+ *       blocks are paced at a few congestion windows per round trip, so that
+ *       a window does not fill a shallow bottleneck queue in a single burst.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef CONGESTION_H
+#define CONGESTION_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * Initial congestion window, in blocks (RFC 3390).
+ */
+#define CWND_INITIAL 4
+
+/**
+ * Smallest slow start threshold, in blocks.
+ */
+#define SSTHRESH_MIN 2
+
+/**
+ * Queueing delay marking a congested bottleneck, as a share of the minimum
+ * round trip time: 4 stands for a quarter.
+ */
+#define QUEUE_DELAY_SHARE 4
+
+/**
+ * Pacing rate, as a multiple of a congestion window per round trip time.
+ */
+#define PACING_GAIN 4
+
+/**
+ * Pacing granularity, the resolution of the session deadlines (us).
+ */
+#define PACING_TICK_US 1000
+
+/**
+ * Set to 0 to send whole windows regardless of losses.
+ */
+extern int cc_enabled;
+
+/**
+ * Set to 1 to log every congestion window change.
+ */
+extern int cc_trace;
+
+/**
+ * Congestion control state of a single download.
+ */
+typedef struct {
+	const char *name;	// name of the transfer, for the traces
+	int limit;		// negotiated window size (blocks)
+	int cwnd;		// blocks sent per round trip
+	int ssthresh;		// slow start threshold (blocks)
+	int growth;		// blocks delivered since the last additive
+				// increase
+	int max_cwnd;		// biggest congestion window
+	uint64_t recover;	// last block sent at the last loss: losses
+				// reported before it is acknowledged belong
+				// to the same event
+	uint64_t started;	// start of the transfer (us)
+	uint64_t round_start;	// start of the current round (us)
+	int round_sent;		// blocks sent in the current round
+	int round_lost;		// 1 once a loss was reported in the current
+				// round
+	uint64_t paced;		// time the next paced block is due (us)
+	int undo_cwnd;		// congestion window before the last timeout,
+				// 0 once its first ACK was received
+	int undo_ssthresh;	// slow start threshold before the last timeout
+	uint64_t timed_out;	// last acknowledged block at the last timeout
+	uint64_t rounds;	// rounds of blocks sent
+	uint64_t losses;	// loss events
+	uint64_t random;	// loss events not caused by congestion
+	uint64_t timeouts;	// retransmission timeouts
+	uint64_t random_timeouts;	// timeouts not caused by congestion
+	uint64_t spurious;	// timeouts undone
+} CongestionControl;
+
+/**
+ * Initializes the given congestion control state.
+ *
+ * @param  cc     the congestion control state;
+ * @param  limit  negotiated window size;
+ * @param  name   name of the transfer.
+ */
+void cc_init(CongestionControl *cc, int limit, const char *name);
+
+/**
+ * Returns the number of blocks that can be sent in the current round.
+ *
+ * @param  cc    the congestion control state;
+ * @param  now   current time (us);
+ * @param  srtt  smoothed round trip time (us), 0 if unknown;
+ * @param  rto   retransmission timeout (us), the round length before the
+ *               first sample.
+ *
+ * @return  the number of blocks.
+ */
+int cc_budget(const CongestionControl *cc, uint64_t now, uint32_t srtt,
+	      uint32_t rto);
+
+/**
+ * Accounts the given blocks sent, starting a new round if the current one is
+ * over: the congestion window opens for the blocks of the last round.
+ *
+ * @param  cc      the congestion control state;
+ * @param  blocks  blocks sent;
+ * @param  sent    index of the last block sent;
+ * @param  now     current time (us);
+ * @param  srtt    smoothed round trip time (us), 0 if unknown;
+ * @param  rto     retransmission timeout (us).
+ */
+void cc_sent(CongestionControl *cc, int blocks, uint64_t sent, uint64_t now,
+	     uint32_t srtt, uint32_t rto);
+
+/**
+ * Returns the time the next block can be sent: the next timer tick of the
+ * current round, or the start of the next round.
+ *
+ * @param  cc    the congestion control state;
+ * @param  srtt  smoothed round trip time (us), 0 if unknown;
+ * @param  rto   retransmission timeout (us).
+ *
+ * @return  the time the next block can be sent (us).
+ */
+uint64_t cc_next_send(const CongestionControl *cc, uint32_t srtt,
+		      uint32_t rto);
+
+/**
+ * Halves the congestion window on a loss reported by the client, once per
+ * window of blocks sent. Random losses leave the window unchanged: the client
+ * reported the gap within two round trips of the missing block, so the blocks
+ * following it were delivered, and the round trip time is within a quarter of
+ * its minimum, so no queue builds up at the bottleneck (as TCP Veno).
+ *
+ * @param  cc       the congestion control state;
+ * @param  acked    index of the last acknowledged block;
+ * @param  sent     index of the last block sent;
+ * @param  age      time since the first missing block was sent (us);
+ * @param  srtt     smoothed round trip time (us), 0 if unknown;
+ * @param  min_rtt  smallest round trip time (us).
+ *
+ * @return  1 for a new loss event, 0 if already accounted or disabled.
+ */
+int cc_loss(CongestionControl *cc, uint64_t acked, uint64_t sent,
+	    uint32_t age, uint32_t srtt, uint32_t min_rtt);
+
+/**
+ * Restarts from a single block after a retransmission timeout. The first
+ * timeout of a window with no queue at the bottleneck is random, the loss of
+ * the last blocks of the window, and sends the window again unchanged.
+ *
+ * @param  cc       the congestion control state;
+ * @param  acked    index of the last acknowledged block;
+ * @param  sent     index of the last block sent;
+ * @param  srtt     smoothed round trip time (us), 0 if unknown;
+ * @param  min_rtt  smallest round trip time (us).
+ */
+void cc_timeout(CongestionControl *cc, uint64_t acked, uint64_t sent,
+		uint32_t srtt, uint32_t min_rtt);
+
+/**
+ * Restores the congestion window of a spurious retransmission timeout: the
+ * first ACK following the timeout acknowledges all the blocks sent before it,
+ * not only the ones sent again, so they were delayed rather than lost (RFC
+ * 5682).
+ *
+ * @param  cc      the congestion control state;
+ * @param  acked   index of the last acknowledged block;
+ * @param  resent  index of the last block sent again since the timeout.
+ *
+ * @return  1 if the timeout was undone, 0 otherwise.
+ */
+int cc_ack(CongestionControl *cc, uint64_t acked, uint64_t resent);
+
+/**
+ * Prints the congestion control statistics using the given log function.
+ *
+ * @param  cc   the congestion control state;
+ * @param  log  log function.
+ */
+void cc_print_stats(const CongestionControl *cc,
+		    void (*log)(LogType, const char *));
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * File: latency.h
+ *       Request Latency Histogram Header File.
+ *
+ *       Measures the time from the reception of a RRQ by the listener to the
+ *       first response of its transfer (DATA or OACK), the startup cost of a
+ *       transfer in each serving model. The histogram lives in a shared
+ *       anonymous mapping created by the listener, so that the transfers
+ *       served by child processes are counted as well: counters are updated
+ *       with atomic operations.
+ *
+ *       Buckets are log-linear: each power of two is split in four buckets,
+ *       so that percentiles are reported within 25% of the exact value.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * Number of histogram buckets: latencies up to 2^33 us.
+ */
+#define LATENCY_BUCKETS 128
+
+/**
+ * Request latency histogram.
+ */
+typedef struct {
+	uint64_t counts[LATENCY_BUCKETS];	// samples per bucket
+	uint64_t samples;			// samples recorded
+	uint64_t total;				// sum of the samples (us)
+	uint64_t max;				// largest sample (us)
+} LatencyHistogram;
+
+/**
+ * Creates the shared histogram of the current process and of its children.
+ * Latencies are not recorded if the mapping can not be created.
+ */
+void latency_init();
+
+/**
+ * Records a request latency.
+ *
+ * @param  us  the latency (us).
+ */
+void latency_record(uint64_t us);
+
+/**
+ * Prints the latency percentiles using the given log function.
+ *
+ * @param  log  log function.
+ */
+void latency_print_stats(void (*log)(LogType, const char *));
+
+#endif
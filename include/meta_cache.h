@@ -0,0 +1,188 @@
+/**
+ * File: meta_cache.h
+ *       File Metadata Cache Header File.
+ *
+ *       Requested file names are resolved relative to a descriptor of the
+ *       base directory held for the whole process lifetime, with openat(),
+ *       and the most requested files are kept open together with their size:
+ *       a cache hit costs a dup() of the open descriptor, read with pread()
+ *       or mmap() by the transfer, without any path resolution and without
+ *       any stat() call.
+ *
+ *       Cached entries are invalidated through inotify: the directories
+ *       holding cached files and all of their parents up to the base
+ *       directory are watched, and the pending events are drained
+ *       before every lookup. Events are queued by the system call changing
+ *       the file, so a file changed before a request is never served from a
+ *       stale entry. The whole cache is flushed if the event queue overflows
+ *       or a watched directory is moved or deleted. Watches are counted by
+ *       the entries and the subdirectories depending on them, and removed
+ *       once unused: the base directory only is watched by an empty cache.
+ *
+ *       Names found missing are remembered as well, in a fixed size table
+ *       allocated with the cache: the deepest existing directory of a missing
+ *       name is watched, and the table is cleared as soon as a file or a
+ *       directory is created or moved in any watched directory. Requests for
+ *       missing files are then rejected without any allocation nor system
+ *       call.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef META_CACHE_H
+#define META_CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "common.h"
+
+/**
+ * Maximum number of files kept open.
+ */
+#define META_ENTRIES 256
+
+/**
+ * Number of missing names remembered, must be a power of two.
+ */
+#define META_MISSING 1024
+
+/**
+ * Maximum length of a missing name, the same as the requested file names.
+ */
+#define META_NAME_LEN 512
+
+/**
+ * Maximum number of watched subdirectories of the base directory.
+ */
+#define META_WATCHES 2048
+
+/**
+ * A file kept open, empty if no name is set.
+ */
+typedef struct {
+	char *name;		// file name relative to the base directory
+	uint32_t hash;		// hash of the file name
+	int fd;			// open file descriptor
+	int wd;			// watch of the directory holding the file
+	const char *base;	// file name within its directory
+	dev_t dev;		// device holding the file
+	ino_t ino;		// inode number of the file
+	off_t size;		// file size
+	struct timespec mtime;	// last modification time
+	int referenced;		// 1 if used since the last CLOCK pass
+} MetaEntry;
+
+/**
+ * A missing name, empty if the name is empty.
+ */
+typedef struct {
+	uint32_t hash;			// hash of the name
+	int wd;				// watch of its deepest directory
+	char name[META_NAME_LEN];	// name relative to the base directory
+} MissingEntry;
+
+/**
+ * A watched subdirectory of the base directory.
+ */
+typedef struct {
+	int wd;			// watch descriptor
+	int parent;		// watch of the parent directory
+	int refs;		// entries, missing names and subdirectories
+				// depending on the watch
+} MetaWatch;
+
+/**
+ * Metadata cache statistics.
+ */
+typedef struct {
+	uint64_t hits;		// lookups served by an open file
+	uint64_t misses;	// lookups opening the file
+	uint64_t evictions;	// files closed to make room
+	uint64_t invalidations;	// files closed by inotify events
+	uint64_t flushes;	// whole cache flushes
+	uint64_t rejects;	// lookups of names known to be missing
+	uint64_t forgets;	// missing names tables cleared
+} MetaStats;
+
+/**
+ * File metadata cache.
+ */
+typedef struct {
+	int dir_fd;				// base directory descriptor
+	int inotify_fd;				// inotify instance, -1 if not
+						// available
+	int base_wd;				// watch of the base directory
+	MetaEntry entries[META_ENTRIES];	// open files
+	int hand;				// CLOCK hand
+	int count;				// open files
+	MissingEntry missing[META_MISSING];	// missing names, by hash
+	int missing_count;			// missing names
+	MetaWatch watches[META_WATCHES];	// watched subdirectories
+	int watch_count;			// watched subdirectories
+	MetaStats stats;			// cache statistics
+} MetaCache;
+
+/**
+ * Metadata cache of the current process.
+ */
+extern MetaCache meta_cache;
+
+/**
+ * Opens the base directory and the inotify instance of the current process.
+ * Without inotify, files are opened on every lookup.
+ *
+ * @param  base_dir  base directory path.
+ *
+ * @return  0 on success, -1 if the base directory can not be opened.
+ */
+int meta_init(const char *base_dir);
+
+/**
+ * Drops the inotify instance shared with the parent process after a fork():
+ * the child only serves the lookups validated by its parent.
+ */
+void meta_detach();
+
+/**
+ * Closes all the cached files and forgets the missing names: used by long
+ * lived child processes, which can not notice changes after meta_detach().
+ */
+void meta_flush();
+
+/**
+ * Checks if the given file is known to be missing: no memory is allocated and
+ * no file is opened, so that requests for missing files can be rejected by
+ * the listener itself.
+ *
+ * @param  name  file name relative to the base directory.
+ *
+ * @return  1 if the file is known to be missing, 0 otherwise.
+ */
+int meta_missing(const char *name);
+
+/**
+ * Opens the given file, relative to the base directory. Absolute names and
+ * names holding a ".." component are refused, names which can not be found
+ * are remembered as missing. The file metadata are those of the cached entry
+ * on a hit: the type, device, inode, size and modification time are set, the
+ * other fields are cleared.
+ *
+ * @param  name  file name relative to the base directory;
+ * @param  st    file metadata to be set.
+ *
+ * @return  a new descriptor of the file, to be closed by the caller, or -1 in
+ *          case of error (errno is set).
+ */
+int meta_open(const char *name, struct stat *st);
+
+/**
+ * Prints the metadata cache statistics using the given log function.
+ *
+ * @param  log  log function.
+ */
+void meta_print_stats(void (*log)(LogType, const char *));
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * File: netascii.h
+ *       Netascii Conversion Header File.
+ *
+ *       Text mode transfers use the netascii format (RFC 764): every LF is
+ *       sent as CR LF and every bare CR as CR NUL. Encoder and decoder work
+ *       on streams, carrying across calls an expansion split between two
+ *       blocks. The bytes to be converted are found with a SIMD scan (AVX2 or
+ *       SSE2, selected at run time) and the runs in between are copied with
+ *       memcpy().
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef NETASCII_H
+#define NETASCII_H
+
+#include <stddef.h>
+
+/**
+ * Available byte scanners.
+ */
+typedef enum {
+	SCAN_AUTO,		// fastest scanner supported by the CPU
+	SCAN_SCALAR,		// one byte at a time
+	SCAN_SSE2,		// 16 bytes at a time
+	SCAN_AVX2		// 32 bytes at a time
+} NetasciiScanner;
+
+/**
+ * Netascii encoder state.
+ */
+typedef struct {
+	int pending;		// 1 if an expansion was split by the output end
+	char next;		// second byte of the split expansion
+} NetasciiEncoder;
+
+/**
+ * Netascii decoder state.
+ */
+typedef struct {
+	int cr;			// 1 if the previous input ended with a CR
+} NetasciiDecoder;
+
+/**
+ * Returns the index of the first byte equal to one of the given characters.
+ *
+ * @param  buf  buffer to be scanned;
+ * @param  len  buffer length;
+ * @param  a    first character looked for;
+ * @param  b    second character looked for.
+ *
+ * @return  the index of the first matching byte, len if none matches.
+ */
+size_t netascii_scan(const char *buf, size_t len, char a, char b);
+
+/**
+ * Selects the scanner used by netascii_scan(), by default the fastest one
+ * supported by the running CPU. Meant for tests and benchmarks comparing the
+ * scanners.
+ *
+ * @param  scanner  the scanner to be used.
+ *
+ * @return  0 on success, -1 if the running CPU does not support the scanner.
+ */
+int netascii_select_scanner(NetasciiScanner scanner);
+
+/**
+ * Initializes the given encoder for a new stream.
+ *
+ * @param  enc  the encoder.
+ */
+void netascii_encoder_init(NetasciiEncoder *enc);
+
+/**
+ * Encodes the given input until the output buffer is full or the input is
+ * consumed. The second byte of an expansion not fitting the output is kept
+ * and written first by the next call, which can be given an empty input to
+ * flush it.
+ *
+ * @param  enc       the encoder;
+ * @param  in        input bytes;
+ * @param  in_len    input length;
+ * @param  consumed  number of input bytes consumed to be set;
+ * @param  out       output buffer;
+ * @param  out_len   output buffer length.
+ *
+ * @return  the number of bytes written to the output buffer.
+ */
+size_t netascii_encode(NetasciiEncoder *enc, const char *in, size_t in_len,
+		       size_t *consumed, char *out, size_t out_len);
+
+/**
+ * Initializes the given decoder for a new stream.
+ *
+ * @param  dec  the decoder.
+ */
+void netascii_decoder_init(NetasciiDecoder *dec);
+
+/**
+ * Decodes the given input: CR LF becomes LF and CR NUL becomes CR. A CR ending
+ * the input is kept and decoded together with the first byte of the next call.
+ * A CR followed by any other byte is kept as is.
+ *
+ * @param  dec  the decoder;
+ * @param  in   input bytes;
+ * @param  len  input length;
+ * @param  out  output buffer, at least len + 1 bytes long.
+ *
+ * @return  the number of bytes written to the output buffer.
+ */
+size_t netascii_decode(NetasciiDecoder *dec, const char *in, size_t len,
+		       char *out);
+
+/**
+ * Terminates the stream, writing the CR kept by the last call if any.
+ *
+ * @param  dec  the decoder;
+ * @param  out  output buffer, at least 1 byte long.
+ *
+ * @return  the number of bytes written to the output buffer.
+ */
+size_t netascii_decode_end(NetasciiDecoder *dec, char *out);
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * File: rtt.h
+ *       Round Trip Time Estimator Header File.
+ *
+ *       Retransmission timeout computed from the smoothed round trip time and
+ *       its variation (RFC 6298), shared by the server sessions and the
+ *       client. Samples are only taken from packets sent once (Karn's
+ *       algorithm) and every expired timeout doubles the retransmission
+ *       timeout until a new sample is taken. A transfer is cancelled once it
+ *       made no progress for a whole retry budget, whatever the number of
+ *       timeouts expired meanwhile.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef RTT_H
+#define RTT_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * Retransmission timeout used before the first sample, in microseconds.
+ */
+#define RTO_INITIAL_US 1000000
+
+/**
+ * Retransmission timeout bounds, in microseconds: the lower bound, the one used
+ * by TCP on Linux, keeps delayed ACKs and scheduling hiccups from firing
+ * spurious retransmissions on low latency links.
+ */
+#define RTO_MIN_US 200000
+#define RTO_MAX_US 8000000
+
+/**
+ * Time spent retransmitting without any progress before the transfer is
+ * cancelled, in milliseconds.
+ */
+#define RETRY_BUDGET_MS 15000
+
+/**
+ * Round trip time estimator of a single transfer.
+ */
+typedef struct {
+	uint32_t srtt;		// smoothed round trip time (us), 0 if no sample
+	uint32_t rttvar;	// round trip time variation (us)
+	uint32_t rto;		// retransmission timeout (us)
+	uint32_t min_rtt;	// smallest sample (us)
+	uint32_t max_rtt;	// biggest sample (us)
+	uint64_t samples;	// samples taken
+	uint64_t timeouts;	// retransmission timeouts expired
+	uint64_t stalled;	// first timeout since the last progress (ms)
+} RttEstimator;
+
+/**
+ * Initializes the given estimator with the initial retransmission timeout.
+ *
+ * @param  rtt  the estimator.
+ */
+void rtt_init(RttEstimator *rtt);
+
+/**
+ * Updates the estimator with a new round trip time sample, taken from a packet
+ * sent only once, and recomputes the retransmission timeout.
+ *
+ * @param  rtt     the estimator;
+ * @param  sample  round trip time sample in microseconds.
+ */
+void rtt_sample(RttEstimator *rtt, uint32_t sample);
+
+/**
+ * Doubles the retransmission timeout after a timeout expired, unless the
+ * transfer made no progress for RETRY_BUDGET_MS since the first of the
+ * consecutive timeouts.
+ *
+ * @param  rtt  the estimator.
+ *
+ * @return  0 if the packets can be sent again, -1 once the retry budget is
+ *          spent.
+ */
+int rtt_backoff(RttEstimator *rtt);
+
+/**
+ * Records the progress of the transfer: the following timeout starts a new
+ * retry budget.
+ *
+ * @param  rtt  the estimator.
+ */
+void rtt_progress(RttEstimator *rtt);
+
+/**
+ * Returns the retransmission timeout rounded up to milliseconds.
+ *
+ * @param  rtt  the estimator.
+ *
+ * @return  the retransmission timeout in milliseconds.
+ */
+uint32_t rtt_timeout_ms(const RttEstimator *rtt);
+
+/**
+ * Prints the estimator statistics using the given log function.
+ *
+ * @param  rtt   the estimator;
+ * @param  name  name of the transfer;
+ * @param  log   log function.
+ */
+void rtt_print_stats(const RttEstimator *rtt, const char *name,
+		     void (*log)(LogType, const char *));
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * File: session_table.h
+ *       Session Table Header File.
+ *
+ *       Live transfers indexed by client endpoint (IP address and port) and
+ *       requested file name, so that an RRQ retransmitted by a client whose
+ *       first DATA packet was slow is recognized and absorbed instead of
+ *       starting a second transfer to the same address. Open addressing with
+ *       linear probing: the compact entries keep the hash and the endpoint
+ *       inline, the file name is only compared on a full match. Deletions
+ *       shift the following entries back, so no tombstones are left behind.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "common.h"
+
+/**
+ * Initial number of table entries (power of 2).
+ */
+#define TABLE_INITIAL_SIZE 256
+
+/**
+ * A table entry, empty if no file name is set.
+ */
+typedef struct {
+	uint32_t hash;		// hash of the key
+	uint32_t ip;		// client IP address (network order)
+	uint16_t port;		// client port (network order)
+	char *file_name;	// requested file name, NULL if empty
+	void *value;		// the transfer (session or child process)
+} TableEntry;
+
+/**
+ * Session table statistics.
+ */
+typedef struct {
+	uint64_t lookups;	// lookups, insertions and removals
+	uint64_t probes;	// entries examined by all the lookups
+	uint64_t collisions;	// entries examined holding other keys
+	uint64_t duplicates;	// retransmitted requests absorbed
+	uint64_t resizes;	// table size doublings
+	uint32_t peak;		// highest number of entries
+} TableStats;
+
+/**
+ * Session table.
+ */
+typedef struct {
+	TableEntry *entries;	// entries array
+	uint32_t size;		// number of entries (power of 2)
+	uint32_t count;		// entries in use
+	TableStats stats;	// table statistics
+} SessionTable;
+
+/**
+ * Allocates the given empty table.
+ *
+ * @param  table  the table.
+ *
+ * @return  0 on success, -1 if the allocation fails.
+ */
+int table_init(SessionTable *table);
+
+/**
+ * Finds the transfer of the given client for the given file. A caller dropping
+ * the request as a retransmission counts it with table_count_duplicate().
+ *
+ * @param  table      the table;
+ * @param  addr       client address;
+ * @param  file_name  requested file name.
+ *
+ * @return  the transfer or NULL if there is no such transfer.
+ */
+void *table_lookup(SessionTable *table, const struct sockaddr_in *addr,
+		   const char *file_name);
+
+/**
+ * Counts a retransmitted request absorbed by the caller in the statistics.
+ *
+ * @param  table  the table.
+ */
+void table_count_duplicate(SessionTable *table);
+
+/**
+ * Adds the given transfer to the table. If the key is already in the table,
+ * its transfer is replaced.
+ *
+ * @param  table      the table;
+ * @param  addr       client address;
+ * @param  file_name  requested file name;
+ * @param  value      the transfer.
+ *
+ * @return  0 on success, -1 if the allocation fails.
+ */
+int table_insert(SessionTable *table, const struct sockaddr_in *addr,
+		 const char *file_name, void *value);
+
+/**
+ * Removes the given transfer of the given client for the given file. Nothing is
+ * removed if the key now belongs to another transfer, which replaced the given
+ * one.
+ *
+ * @param  table      the table;
+ * @param  addr       client address;
+ * @param  file_name  requested file name;
+ * @param  value      the transfer.
+ */
+void table_remove(SessionTable *table, const struct sockaddr_in *addr,
+		  const char *file_name, void *value);
+
+/**
+ * Prints the table occupancy and collision statistics using the given log
+ * function.
+ *
+ * @param  table  the table;
+ * @param  log    log function.
+ */
+void table_print_stats(const SessionTable *table,
+		       void (*log)(LogType, const char *));
+
+#endif
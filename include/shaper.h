@@ -0,0 +1,195 @@
+/**
+ * File: shaper.h
+ *       Bandwidth Shaper Header File.
+ *
+ *       Rate limits the DATA packets sent by the event loop with token
+ *       buckets: a global one, one per client subnet and one per client
+ *       address, each one refilled at its configured rate up to its burst
+ *       size. Downloads do not send new blocks on their own: each one is a
+ *       flow, queued once it has free window slots, and a deficit round robin
+ *       scheduler decides which flow sends next. Every round each queued flow
+ *       earns a quantum of bytes and sends as many packets as its deficit and
+ *       its buckets allow, so that small transfers complete within a few
+ *       rounds while bulk transfers share the remaining capacity.
+ *
+ *       Retransmissions are sent right away and charged to the buckets, so
+ *       that losses never stall a transfer behind the scheduler.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef SHAPER_H
+#define SHAPER_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "common.h"
+
+/**
+ * Maximum number of client and subnet buckets.
+ */
+#define SHAPER_BUCKETS 1024
+
+/**
+ * Default burst size of the buckets (bytes).
+ */
+#define SHAPER_BURST (256 * 1024)
+
+/**
+ * Default deficit round robin quantum (bytes).
+ */
+#define SHAPER_QUANTUM (16 * 1024)
+
+/**
+ * Default subnet prefix length.
+ */
+#define SHAPER_PREFIX 24
+
+/**
+ * A token bucket, unlimited if its rate is 0.
+ */
+typedef struct {
+	uint64_t rate;		// refill rate (bytes per second)
+	int64_t tokens;		// available bytes, negative after debts
+	uint64_t updated;	// last refill time (us)
+} TokenBucket;
+
+/**
+ * A client or subnet bucket, shared by the flows of the same key.
+ */
+typedef struct {
+	uint32_t key;		// client address or subnet (network order)
+	int refs;		// flows using the bucket, 0 if free
+	TokenBucket bucket;	// the bucket
+} SharedBucket;
+
+/**
+ * A shaped flow: the new DATA packets of a download.
+ */
+typedef struct Flow {
+	int64_t deficit;		// bytes the flow may still send
+	int packet_size;		// size of a full DATA packet
+	SharedBucket *client;		// client bucket, NULL if unlimited
+	SharedBucket *subnet;		// subnet bucket, NULL if unlimited
+	int queued;			// 1 while waiting for the scheduler
+	struct Flow *prev;		// previous queued flow
+	struct Flow *next;		// next queued flow
+	void *data;			// owner of the flow
+} Flow;
+
+/**
+ * Sends up to the given number of new packets for the given flow.
+ *
+ * @param  flow     the flow;
+ * @param  packets  maximum number of packets to be sent.
+ *
+ * @return  the number of packets sent.
+ */
+typedef int (*FlowSend)(Flow *flow, int packets);
+
+/**
+ * Bandwidth shaper statistics.
+ */
+typedef struct {
+	uint64_t rounds;	// scheduler rounds
+	uint64_t packets;	// new packets scheduled
+	uint64_t bytes;		// bytes charged, retransmissions included
+	uint64_t throttled;	// flows held back by a bucket
+} ShaperStats;
+
+/**
+ * Bandwidth shaper configuration and state.
+ */
+typedef struct {
+	uint64_t rate;			// global rate (bytes/s), 0 unlimited
+	uint64_t client_rate;		// per client rate, 0 unlimited
+	uint64_t subnet_rate;		// per subnet rate, 0 unlimited
+	int prefix;			// subnet prefix length
+	uint64_t burst;			// burst size of all the buckets
+	int quantum;			// deficit round robin quantum
+	TokenBucket global;		// global bucket
+	SharedBucket clients[SHAPER_BUCKETS];	// client buckets
+	SharedBucket subnets[SHAPER_BUCKETS];	// subnet buckets
+	Flow *head;			// first queued flow
+	Flow *tail;			// last queued flow
+	int queued;			// queued flows
+	uint64_t wake_at;		// next run of the scheduler (us), 0
+					// to run it right away
+	ShaperStats stats;		// shaper statistics
+} Shaper;
+
+/**
+ * Bandwidth shaper of the current process.
+ */
+extern Shaper shaper;
+
+/**
+ * Checks if any rate limit was configured.
+ *
+ * @return  1 if the DATA packets are shaped, 0 otherwise.
+ */
+int shaper_enabled();
+
+/**
+ * Fills the buckets, to be called before the first flow is added.
+ */
+void shaper_init();
+
+/**
+ * Adds a new flow to the given client.
+ *
+ * @param  flow         the flow;
+ * @param  addr         client address;
+ * @param  packet_size  size of a full DATA packet;
+ * @param  data         owner of the flow.
+ */
+void shaper_add(Flow *flow, const struct sockaddr_in *addr, int packet_size,
+		void *data);
+
+/**
+ * Removes the given flow, dequeuing it.
+ *
+ * @param  flow  the flow.
+ */
+void shaper_remove(Flow *flow);
+
+/**
+ * Queues the given flow, which has new packets to send.
+ *
+ * @param  flow  the flow.
+ */
+void shaper_wake(Flow *flow);
+
+/**
+ * Charges the given bytes, sent outside of the scheduler, to the buckets of
+ * the given flow.
+ *
+ * @param  flow   the flow;
+ * @param  bytes  bytes sent.
+ */
+void shaper_charge(Flow *flow, uint64_t bytes);
+
+/**
+ * Runs a deficit round robin round over the queued flows.
+ *
+ * @param  send  function sending the packets of a flow.
+ */
+void shaper_run(FlowSend send);
+
+/**
+ * Returns the time left before the next scheduler round.
+ *
+ * @return  the timeout (ms), -1 if no flow is queued.
+ */
+int shaper_next_timeout();
+
+/**
+ * Prints the bandwidth shaper statistics using the given log function.
+ *
+ * @param  log  log function.
+ */
+void shaper_print_stats(void (*log)(LogType, const char *));
+
+#endif
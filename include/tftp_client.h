@@ -21,6 +21,10 @@
 #include <netinet/in.h>
 
 #include "common.h"
+#include "netascii.h"
+#include "async_writer.h"
+#include "block_source.h"
+#include "rtt.h"
 
 /**
  * TFTP Server IP Address.
@@ -37,11 +41,36 @@ int server_port;
  */
 char transfer_mode[10];
 
+/**
+ * Block size requested with the blksize option, 0 to use the default 512 bytes
+ * block size without negotiating options.
+ */
+int blksize;
+
+/**
+ * Window size requested with the windowsize option, 0 to acknowledge every
+ * block without negotiating the option.
+ */
+int windowsize;
+
 /**
  * TFTP Server Address Struct.
  */
 struct sockaddr_in serv_addr;
 
+/**
+ * Last packet sent to the TFTP Server, sent again when a timeout expires.
+ */
+char last_packet[BUFSIZE];
+int last_packet_len;
+
+/**
+ * Time the last packet was sent (us), 0 once its round trip time was sampled,
+ * and 1 if it was sent more than once.
+ */
+uint64_t last_packet_sent_us;
+int last_packet_resent;
+
 /**
  * Implements the execution main loop.
  */
@@ -62,6 +91,43 @@ void print_prompt();
  */
 void set_transfer_mode();
 
+/**
+ * Sets the block size to be requested based on the given input command.
+ */
+void set_blksize();
+
+/**
+ * Sets the window size to be requested based on the given input command.
+ */
+void set_windowsize();
+
+/**
+ * Tells if the tsize option (RFC 2349) is appended to the RRQ or WRQ: the file
+ * size is asked for or announced whenever other options are negotiated in
+ * binary mode.
+ *
+ * @return  1 if the tsize option is requested, 0 otherwise.
+ */
+int tsize_requested();
+
+/**
+ * Parses the OACK packet received from the TFTP Server and retrieves the block
+ * and window sizes accepted by the server, the size of the requested file and
+ * the block number following 65535.
+ *
+ * @param  buffer       received OACK packet;
+ * @param  len          received OACK packet length;
+ * @param  blk_size     negotiated block size to be set;
+ * @param  window_size  negotiated window size to be set;
+ * @param  file_size    requested file size to be set;
+ * @param  rollover     negotiated rollover value to be set.
+ *
+ * @return  0 on success, -1 if the server acknowledged an option that was not
+ *          requested.
+ */
+int parse_OACK(const char *buffer, int len, int *blk_size, int *window_size,
+	       uint64_t *file_size, int *rollover);
+
 /**
  * Retrieves parameters for the !get command and transfers the file from the
  * TFTP Server to the Client.
@@ -69,13 +135,80 @@ void set_transfer_mode();
 void get_file();
 
 /**
- * Sends the RRQ for the given file name using the provided socket. The
- * transfer mode is the one globally set using the !mode command.
+ * Retrieves parameters for the !put command and transfers the file from the
+ * Client to the TFTP Server.
+ */
+void put_file();
+
+/**
+ * Sends the whole file to the TFTP Server, a window of DATA packets at a time
+ * with a single system call. The window slides on every ACK: an ACK before the
+ * end of the window reports a gap at the server and the blocks following the
+ * acknowledged one are sent again, while duplicate and late ACKs are ignored.
+ * The blocks in flight are sent again when the retransmission timeout
+ * expires.
  *
- * @param  sockfd      client socket file descriptor;
- * @param  cli_socket  the socket to be used to send the packet.
+ * @param  cli_socket   the socket used for the transfer;
+ * @param  source       source file blocks;
+ * @param  rtt          round trip time estimator of the transfer;
+ * @param  blk_size     negotiated block size;
+ * @param  window_size  negotiated window size;
+ * @param  rollover     block number following 65535.
+ *
+ * @return  0 on success, -1 if the transfer was cancelled.
  */
-void send_RRQ(int cli_socket, char *file_name);
+int send_file(int cli_socket, BlockSource *source, RttEstimator *rtt,
+	      int blk_size, int window_size, int rollover);
+
+/**
+ * Receives the whole file from the TFTP Server starting from the first data
+ * packet already stored in the given buffer. Blocks are acknowledged only at
+ * window boundaries, on the last block and when a gap is detected; blocks
+ * received ahead of a gap are kept until the missing ones are received, while
+ * blocks already received are dropped.
+ *
+ * @param  cli_socket   the socket used for the transfer;
+ * @param  writer       destination file writer;
+ * @param  rtt          round trip time estimator of the transfer;
+ * @param  buffer       transfer buffer holding the first data packet;
+ * @param  recv_len     first data packet length;
+ * @param  blk_size     negotiated block size;
+ * @param  window_size  negotiated window size;
+ * @param  rollover     block number following 65535.
+ *
+ * @return  0 on success, -1 if the transfer was cancelled.
+ */
+int receive_file(int cli_socket, AsyncWriter *writer, RttEstimator *rtt,
+		 char *buffer, int recv_len, int blk_size, int window_size,
+		 int rollover);
+
+/**
+ * Queues the given data packet payload to be written to the destination file,
+ * converting it from netascii in text mode.
+ *
+ * @param  writer  destination file writer;
+ * @param  dec     netascii decoder, NULL in binary mode;
+ * @param  data    data packet payload;
+ * @param  len     payload length.
+ *
+ * @return  0 on success, -1 if the destination file can not be written.
+ */
+int write_block(AsyncWriter *writer, NetasciiDecoder *dec, const char *data,
+		int len);
+
+/**
+ * Sends the RRQ or WRQ for the given file name using the provided socket. The
+ * transfer mode is the one globally set using the !mode command, the blksize
+ * option is appended when set using the !blksize command. The tsize option
+ * carries the given file size, 0 to ask for the size of a downloaded file.
+ *
+ * @param  cli_socket  the socket to be used to send the packet;
+ * @param  code        request opcode (OP_RRQ or OP_WRQ);
+ * @param  file_name   requested file name;
+ * @param  file_size   size of the uploaded file, 0 for downloads.
+ */
+void send_request(int cli_socket, uint16_t code, char *file_name,
+		  uint64_t file_size);
 
 /**
  * Sends the ACK packet for the given block number.
@@ -85,4 +218,55 @@ void send_RRQ(int cli_socket, char *file_name);
  */
 void send_ACK(int cli_socket, uint16_t block_number);
 
+/**
+ * Sends an ERROR packet having the given error code and text to the given
+ * address: to the server TID it cancels the transfer.
+ *
+ * @param  cli_socket  the socket to be used to send the packet;
+ * @param  addr        recipient address;
+ * @param  code        error code;
+ * @param  message     error message text.
+ */
+void send_ERROR(int cli_socket, const struct sockaddr_in *addr, uint16_t code,
+		const char *message);
+
+/**
+ * Prints the text of the given ERROR packet. The text is not trusted to be
+ * terminated: it is bounded by the packet length and the log buffer.
+ *
+ * @param  buffer  the ERROR packet;
+ * @param  len     packet length.
+ */
+void print_ERROR(const char *buffer, int len);
+
+/**
+ * Retains the given packet as the last packet sent, to be sent again if its
+ * response does not arrive within the retransmission timeout.
+ *
+ * @param  buffer  the packet sent;
+ * @param  len     packet length.
+ */
+void keep_last_packet(const char *buffer, int len);
+
+/**
+ * Updates the given estimator with the round trip time of the last packet
+ * sent, once its response was received. Nothing is done if the packet was sent
+ * more than once or was already sampled.
+ *
+ * @param  rtt  round trip time estimator.
+ */
+void sample_last_packet(RttEstimator *rtt);
+
+/**
+ * Waits for a packet to be received on the given socket. Every time the
+ * retransmission timeout expires, the timeout is doubled and the last packet
+ * sent is sent again.
+ *
+ * @param  cli_socket  the socket used for the transfer;
+ * @param  rtt         round trip time estimator of the transfer.
+ *
+ * @return  0 once a packet is ready, -1 once the retry budget is spent.
+ */
+int wait_packet(int cli_socket, RttEstimator *rtt);
+
 #endif
@@ -0,0 +1,31 @@
+/**
+ * File: tftp_event.h
+ *       TFTP Server Event Loop Header File.
+ *
+ *       Single process event-driven server core: every transfer is kept as a
+ *       session state machine and all the transfer sockets, together with the
+ *       listener, are multiplexed using epoll.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef TFTP_EVENT_H
+#define TFTP_EVENT_H
+
+#include "tftp_session.h"
+
+/**
+ * Maximum number of events retrieved by a single epoll_wait() call.
+ */
+#define MAX_EVENTS 256
+
+/**
+ * Implements the main loop of the event-driven server: new RRQs and WRQs are
+ * read from the listener socket and each accepted request becomes a new
+ * session driven by the readiness of its socket and by its retransmission
+ * deadline.
+ */
+void event_loop();
+
+#endif
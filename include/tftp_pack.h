@@ -0,0 +1,66 @@
+/**
+ * File: tftp_pack.h
+ *       TFTP Serving Archive Packer Header File.
+ *
+ *       Offline tool walking a base directory and packing all its regular
+ *       files in a serving archive, to be mapped by the server with the
+ *       --archive option. Hidden files, temporary uploads included, are not
+ *       packed.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef TFTP_PACK_H
+#define TFTP_PACK_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "archive.h"
+
+/**
+ * A file to be packed.
+ */
+typedef struct {
+	char *name;		// file name relative to the base directory
+	char *path;		// file path
+	uint64_t size;		// file size
+	uint64_t offset;	// offset of the contents in the archive
+} PackedFile;
+
+/**
+ * Files found in the base directory.
+ */
+typedef struct {
+	PackedFile *files;	// files array
+	uint64_t count;		// files found
+	uint64_t capacity;	// files array capacity
+} FileList;
+
+/**
+ * Adds all the regular files found in the given directory and in its
+ * subdirectories to the given list. Symbolic links are skipped.
+ *
+ * @param  list    the file list;
+ * @param  dir     directory path;
+ * @param  prefix  file names prefix, the directory path relative to the base
+ *                 directory ("" for the base directory).
+ *
+ * @return  0 on success, -1 in case of error.
+ */
+int walk_directory(FileList *list, const char *dir, const char *prefix);
+
+/**
+ * Writes the archive of the given files: the archive is written to a
+ * temporary file, renamed to the given path once complete.
+ *
+ * @param  list  the files to be packed;
+ * @param  path  archive file path.
+ *
+ * @return  0 on success, -1 in case of error.
+ */
+int write_archive(FileList *list, const char *path);
+
+#endif
@@ -0,0 +1,105 @@
+/**
+ * File: tftp_pool.h
+ *       TFTP Server Transfer Pool Header File.
+ *
+ *       Process-per-transfer model without fork() on the critical path of the
+ *       requests: the listener spawns a pool of transfer processes at startup,
+ *       each one connected to it by a SOCK_SEQPACKET socket pair. Admitted
+ *       requests are handed to an idle process as a job message holding the
+ *       request and the client address, together with the descriptor of the
+ *       requested file already opened by the listener, passed with SCM_RIGHTS.
+ *       Once the transfer is over the process reports back to the listener and
+ *       waits for its next job. A process terminating for any reason is
+ *       spawned again.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef TFTP_POOL_H
+#define TFTP_POOL_H
+
+#include <poll.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "tftp_session.h"
+
+/**
+ * Maximum number of transfer processes.
+ */
+#define POOL_MAX 256
+
+/**
+ * A transfer handed to a pool process.
+ */
+typedef struct {
+	Request req;			// the admitted request
+	struct sockaddr_in cli_addr;	// client address
+	uint64_t size;			// size of the passed file, if any
+} PoolJob;
+
+/**
+ * A pool process, as seen by the listener.
+ */
+typedef struct {
+	pid_t pid;	// process id
+	int sock;	// listener end of the socket pair
+	int busy;	// 1 while serving a transfer
+	PoolJob job;	// transfer served, its session table key
+} PoolProcess;
+
+/**
+ * Number of transfer processes, 0 to fork a child for each transfer.
+ */
+extern int pool_size;
+
+/**
+ * Spawns the transfer processes of the pool.
+ */
+void pool_start();
+
+/**
+ * Hands the given admitted request to an idle transfer process.
+ *
+ * @param  req       the admitted request;
+ * @param  cli_addr  client address;
+ * @param  fd        descriptor of the requested file, -1 to have the file
+ *                   opened by the transfer process; closed in any case;
+ * @param  size      size of the requested file.
+ *
+ * @return  0 on success, -1 if no process could take the transfer.
+ */
+int pool_dispatch(const Request *req, const struct sockaddr_in *cli_addr,
+		  int fd, uint64_t size);
+
+/**
+ * Fills the given poll descriptors with the sockets of the pool processes.
+ *
+ * @param  fds  the poll descriptors, room for POOL_MAX entries.
+ *
+ * @return  the number of descriptors filled.
+ */
+int pool_poll_fds(struct pollfd *fds);
+
+/**
+ * Handles the completions reported by the pool processes: their transfers
+ * are removed from the session table and their slots released.
+ *
+ * @param  fds    the poll descriptors filled by pool_poll_fds();
+ * @param  count  the number of descriptors.
+ */
+void pool_collect(const struct pollfd *fds, int count);
+
+/**
+ * Handles the termination of the given child process: if it belongs to the
+ * pool, its transfer is dropped and the process spawned again.
+ *
+ * @param  pid  the terminated process id.
+ *
+ * @return  1 if the process belonged to the pool, 0 otherwise.
+ */
+int pool_reaped(pid_t pid);
+
+#endif
@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <errno.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -21,16 +22,56 @@
 #include <netinet/in.h>
 
 #include "common.h"
+#include "tftp_session.h"
+#include "session_table.h"
+#include "archive.h"
+#include "meta_cache.h"
+#include "admission.h"
+#include "latency.h"
 
 /**
  * TFTP Server Base Directory.
  */
-char *base_dir;
+extern char *base_dir;
 
 /**
  * Listener UDP Server.
  */
-int listener;
+extern int listener;
+
+/**
+ * Strategy used to read the transferred files blocks.
+ */
+extern SourceType source_type;
+
+/**
+ * Serving archive mapped with the --archive option: files are served from the
+ * archive instead of the base directory, which is not written either. The
+ * mapping is NULL when no archive is served.
+ */
+extern Archive archive;
+
+/**
+ * Set to 1 to serve each RRQ from a forked child process instead of the
+ * event-driven single process core.
+ */
+extern int fork_mode;
+
+/**
+ * Live transfers of the current process, used to absorb retransmitted RRQs.
+ */
+extern SessionTable session_table;
+
+/**
+ * Set by SIGUSR1 to have the running main loop dump the server statistics.
+ */
+extern volatile sig_atomic_t stats_requested;
+
+/**
+ * Prints the statistics collected by the current process and clears the
+ * pending SIGUSR1 request.
+ */
+void print_stats();
 
 /**
  * Creates a listener socket having domain AF_INET and type SOCK_DGRAM on the
@@ -44,40 +85,55 @@ int createUDPSocket(int port);
 
 /**
  * Implements the main loop with the UDP listener server waiting for incoming
- * packets.
+ * packets. Used by the fork-per-request model: a new child process is created
+ * for each valid RRQ or WRQ.
  */
 void listen_for_packets();
 
 /**
- * Called when a valid RRQ message is received to handle the file transfer.
+ * Checks if the file requested by the given RRQ is known to be missing, without
+ * allocating memory nor opening any file: such requests are rejected by the
+ * listener with a prebuilt error message.
  *
- * @param  mode       transfer mode specified in the RRQ;
- * @param  cli_addr   address of the client requesting the file transfer;
- * @param  file_name  the name of the requested file.
+ * @param  req  the received request.
+ *
+ * @return  1 if the requested file is known to be missing, 0 otherwise.
  */
-void handle_transfer(char mode[10], struct sockaddr cli_addr, char file_name[512]);
+int request_missing(const Request *req);
 
 /**
- * Transfers the specified source file to the addressed client using the given
- * client in TEXT mode transfer.
+ * Drops in a child process the state of the listener: the SIGCHLD descriptor
+ * and the inotify instance.
+ */
+void detach_child();
+
+/**
+ * Drives the transfer of the given request until completion, in a child
+ * process.
+ *
+ * @param  req       the received request;
+ * @param  cli_addr  address of the client requesting the file transfer;
+ * @param  fd        descriptor of the requested file, -1 to open it;
+ * @param  size      size of the requested file.
  *
- * @param  src_file  source file to be transferred;
- * @param  socket    socket to be used to transfer the file to the recipient
- *                   client;
- * @param  cli_addr  address of the client requesting the file transfer.
+ * @return  1 if the transfer completed, 0 otherwise.
  */
-void text_mode_transfer(FILE *src_file, int socket, struct sockaddr cli_addr);
+int serve_transfer(const Request *req, const struct sockaddr_in *cli_addr,
+		   int fd, uint64_t size);
 
 /**
- * Transfers the specified source file to the addressed client using the given
- * client in BINARY mode transfer.
+ * Called in the child process when a valid RRQ or WRQ message is received to
+ * handle the file transfer. The transfer session is driven until completion
+ * and the child process is terminated.
  *
- * @param  src_file  source file to be transferred;
- * @param  socket    socket to be used to transfer the file to the recipient
- *                   client;
- * @param  cli_addr  address of the client requesting the file transfer.
+ * @param  req       the received request;
+ * @param  cli_addr  address of the client requesting the file transfer;
+ * @param  fd        descriptor of the requested file opened by the parent,
+ *                   -1 for uploads and archived files;
+ * @param  size      size of the requested file.
  */
-void binary_mode_transfer(FILE *src_file, int socket, struct sockaddr cli_addr);
+void handle_transfer(const Request *req, struct sockaddr cli_addr, int fd,
+		     uint64_t size);
 
 /**
  * Handles invalid opcodes received from the TFTP Client. An error message
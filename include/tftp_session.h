@@ -0,0 +1,341 @@
+/**
+ * File: tftp_session.h
+ *       TFTP Transfer Session Header File.
+ *
+ *       A session holds the whole state of a single file transfer (current
+ *       block, source or destination file, last packet sent and
+ *       retransmission deadline) so that the transfer can be driven either by
+ *       a blocking loop inside a forked child process or by the event loop
+ *       serving many transfers from a single process.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef TFTP_SESSION_H
+#define TFTP_SESSION_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "common.h"
+#include "block_source.h"
+#include "rtt.h"
+#include "timer_wheel.h"
+#include "netascii.h"
+#include "async_writer.h"
+#include "shaper.h"
+#include "congestion.h"
+
+/**
+ * Maximum window size accepted with the windowsize option (RFC 7440).
+ */
+#define MAX_WINDOWSIZE 64
+
+/**
+ * Maximum memory retained for the packets of a single window: the accepted
+ * window size is lowered for big block sizes.
+ */
+#define MAX_WINDOW_BYTES (1024 * 1024)
+
+/**
+ * Options accepted for a session, acknowledged in the OACK packet.
+ */
+#define OPT_BLKSIZE 0x01
+#define OPT_WINDOWSIZE 0x02
+#define OPT_TSIZE 0x04
+#define OPT_ROLLOVER 0x08
+
+/**
+ * Room for the longest OACK packet, stored in the first window slot which
+ * may be shorter with small block sizes.
+ */
+#define OACK_SIZE 128
+
+/**
+ * Default size of the largest upload accepted, in bytes.
+ */
+#define UPLOAD_MAX_DEFAULT (1024ULL * 1024 * 1024)
+
+/**
+ * Largest upload accepted, in bytes: a bigger announced size is refused before
+ * any space is allocated, and an upload growing past it is cancelled.
+ */
+extern uint64_t upload_max;
+
+/**
+ * Set to 1 to let uploads replace the existing files of the base directory.
+ */
+extern int upload_overwrite;
+
+/**
+ * A parsed RRQ or WRQ packet.
+ */
+typedef struct {
+	uint16_t opcode;	// request opcode
+	char file_name[512];	// requested file name
+	char mode[10];		// requested transfer mode
+	int blksize;		// requested block size, 0 if not requested
+	int windowsize;		// requested window size, 0 if not requested
+	int tsize;		// 1 if the file size was requested or announced
+	uint64_t size;		// file size announced by a WRQ, 0 if unknown
+	int rollover;		// requested rollover value, -1 if not requested
+	uint64_t received;	// reception time (us), 0 if unknown
+} Request;
+
+/**
+ * A packet retained in a window slot: the header is stored in the slot buffer
+ * and is followed by room for a whole block, while the payload points either
+ * to that room or to the block source file mapping.
+ */
+typedef struct {
+	char *header;		// packet header, followed by the block buffer
+	int header_len;		// header length
+	struct iovec data;	// packet payload
+	uint64_t sent_us;	// time the packet was last sent (us)
+	int resent;		// 1 if sent more than once
+} Packet;
+
+/**
+ * Available states for a transfer session.
+ */
+typedef enum {
+	SESSION_SENDING,	// waiting for the ACK of the DATA packets sent
+	SESSION_RECEIVING,	// waiting for the DATA packets of an upload
+	SESSION_DONE,		// last DATA packet acknowledged
+	SESSION_FAILED		// transfer cancelled
+} SessionState;
+
+/**
+ * Unexpected packets received by a session, by kind: none of them affects the
+ * transfer.
+ */
+typedef struct {
+	uint64_t duplicate;	// ACKs of the last acknowledged block, or
+				// DATA packets already received
+	uint64_t stale;		// ACKs of blocks outside the window
+	uint64_t gaps;		// ACKs before the end of the window, or
+				// DATA packets ahead of a missing one
+	uint64_t foreign;	// packets coming from another TID
+	uint64_t unexpected;	// packets other than ACK and ERROR
+} AckStats;
+
+/**
+ * A single file transfer.
+ */
+typedef struct Session {
+	SessionState state;		// current transfer state
+	int sock;			// transfer socket (server TID)
+	struct sockaddr_in cli_addr;	// client address (client TID)
+	char file_name[512];		// transferred file name
+	int text_mode;			// 1 for netascii, 0 for octet
+	int upload;			// 1 for a WRQ, 0 for a RRQ
+	BlockSource *source;		// source file blocks
+	AsyncWriter *writer;		// upload temporary file writer
+	NetasciiDecoder decoder;	// upload netascii decoder
+	char *temp_path;		// upload temporary file path
+	char *path;			// upload destination file path
+	uint64_t size;			// upload size announced, 0 if unknown
+	uint64_t received;		// request reception time (us), 0 if
+					// unknown
+	int blksize;			// negotiated block size
+	int windowsize;			// negotiated window size
+	int options;			// accepted options (OPT_* flags)
+	int oack;			// 1 until the OACK is acknowledged
+	int rollover;			// block number following 65535
+	uint64_t acked;			// last acknowledged block index
+	uint64_t client_window;		// block index the client window
+					// started from: its ACK at the end of
+					// a window or of a gap
+	uint64_t sent;			// block index of the last DATA sent
+	uint64_t bytes;			// payload bytes acknowledged
+	uint64_t packets;		// packets sent, retransmissions included
+	int in_flight;			// blocks sent and not acknowledged yet
+	int cursor;			// blocks in flight sent since the last
+					// go back to the acknowledged block
+	uint64_t resent_us;		// last time blocks were sent again (us)
+	uint64_t deferred_gap;		// block index acknowledged by a gap ACK
+					// received within a round trip of the
+					// last go back, 0 if none
+	int head;			// window slot of block acked + 1
+	int eof;			// 1 once the last block has been read,
+					// or written for an upload
+	int gap_acked;			// 1 once the upload gap was reported
+	int dup_acked;			// 1 once an upload duplicate was ACKed
+	char *buffers;			// window slots (blksize + 4 bytes each)
+	Packet *window;			// packets retained in the window slots
+	uint64_t deadline;		// retransmission deadline or next
+					// paced round, the earliest (ms)
+	uint64_t retransmit;		// retransmission deadline (ms)
+	uint64_t pace;			// next paced round (ms), 0 if none
+	Timer timer;			// deadline timer in the event loop
+	RttEstimator rtt;		// round trip time estimator
+	CongestionControl cc;		// download congestion window
+	AckStats anomalies;		// unexpected packets received
+	int quota;			// new DATA packets allowed by the
+					// shaper, -1 if not shaped
+	Flow flow;			// shaped flow in the event loop
+	struct Session *prev;		// previous session in the event loop
+	struct Session *next;		// next session in the event loop
+} Session;
+
+/**
+ * Parses the given RRQ/WRQ packet together with the options appended to it
+ * (RFC 2347). Unknown options and invalid option values are ignored.
+ *
+ * @param  buffer  received packet;
+ * @param  len     received packet length;
+ * @param  req     parsed request to be filled.
+ *
+ * @return  0 on success, -1 if the packet is malformed.
+ */
+int parse_request(const char *buffer, int len, Request *req);
+
+/**
+ * Sends an error message (opcode = 5) having the given error code and text to
+ * the given address.
+ *
+ * @param  socket    the socket to be used to send the error message;
+ * @param  addr      recipient address;
+ * @param  code      error code;
+ * @param  message   error message text.
+ */
+void send_error(int socket, const struct sockaddr_in *addr, uint16_t code,
+		const char *message);
+
+/**
+ * Sends the prebuilt error message having the given error code to the given
+ * address, without building it: used by the listeners to reject requests for
+ * missing files (ERR_NOT_FOUND), invalid requests (ERR_ILLEGAL_OP) and requests
+ * received while the server is saturated (ERR_UNDEFINED, "Server busy").
+ *
+ * @param  socket  the socket to be used to send the error message;
+ * @param  addr    recipient address;
+ * @param  code    error code.
+ */
+void send_reject(int socket, const struct sockaddr_in *addr, uint16_t code);
+
+/**
+ * Creates a new transfer session for the given request: a new socket is
+ * created for the transfer and the requested file is opened. If the file can
+ * not be opened a File not found error message is sent to the client. Uploads
+ * are written to a temporary file in the base directory, renamed to the
+ * requested file name once complete so that readers never see a partial
+ * file.
+ *
+ * @param  req       the received request;
+ * @param  cli_addr  address of the client requesting the file transfer.
+ *
+ * @return  the new session or NULL in case of error.
+ */
+Session *session_create(const Request *req, const struct sockaddr_in *cli_addr);
+
+/**
+ * Creates a new transfer session for the given request, reading the requested
+ * file from the given descriptor already opened by the caller instead of
+ * opening it. Only RRQs read from the base directory can be given a
+ * descriptor.
+ *
+ * @param  req       the received request;
+ * @param  cli_addr  address of the client requesting the file transfer;
+ * @param  fd        descriptor of the requested file, owned by the session,
+ *                   or -1 to have the file opened as in session_create();
+ * @param  size      size of the requested file.
+ *
+ * @return  the new session or NULL in case of error.
+ */
+Session *session_create_fd(const Request *req,
+			   const struct sockaddr_in *cli_addr, int fd,
+			   uint64_t size);
+
+/**
+ * Starts the transfer sending the OACK packet if any option was accepted, the
+ * first window of DATA packets otherwise, or the ACK of block 0 for uploads.
+ *
+ * @param  session  the session to be started.
+ */
+void session_start(Session *session);
+
+/**
+ * Processes all the packets waiting on the session socket. Must be called
+ * when the session socket becomes readable.
+ *
+ * @param  session  the session the packets were received for.
+ */
+void session_receive(Session *session);
+
+/**
+ * Handles the expiration of the session deadline. When the next round of a
+ * paced window is due, the blocks allowed by the congestion window are sent.
+ * Otherwise the retransmission timeout is doubled and the window is sent again
+ * starting from the last acknowledged block, or the last ACK is sent again for
+ * uploads. The transfer is cancelled once the retry budget is spent. Completed
+ * uploads end here, after waiting for a retransmission of the last block in
+ * case the final ACK was lost.
+ *
+ * @param  session  the timed out session.
+ */
+void session_timeout(Session *session);
+
+/**
+ * Sends up to the given number of new DATA packets, on behalf of the
+ * bandwidth shaper.
+ *
+ * @param  session  the shaped session;
+ * @param  packets  maximum number of packets to be sent.
+ *
+ * @return  the number of packets sent.
+ */
+int session_send(Session *session, int packets);
+
+/**
+ * Tells if the given shaped session has free window slots to be filled by
+ * the bandwidth shaper.
+ *
+ * @param  session  the session.
+ *
+ * @return  1 if new DATA packets can be sent, 0 otherwise.
+ */
+int session_throttled(const Session *session);
+
+/**
+ * Tells if the given session is still transferring.
+ *
+ * @param  session  the session.
+ *
+ * @return  1 until the transfer is completed or cancelled, 0 afterwards.
+ */
+int session_active(const Session *session);
+
+/**
+ * Drives the given session until the transfer is completed or cancelled,
+ * blocking on the session socket. Used by the fork-per-request model.
+ *
+ * @param  session  the session to be run.
+ */
+void session_run(Session *session);
+
+/**
+ * Prints the round trip time statistics of the given session and the
+ * unexpected packets it received using the given log function.
+ *
+ * @param  session  the session;
+ * @param  log      log function.
+ */
+void session_print_stats(const Session *session,
+			 void (*log)(LogType, const char *));
+
+/**
+ * Closes the session socket and source file and frees the session.
+ *
+ * @param  session  the session to be destroyed.
+ */
+void session_destroy(Session *session);
+
+#endif
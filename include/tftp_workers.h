@@ -0,0 +1,39 @@
+/**
+ * File: tftp_workers.h
+ *       TFTP Server Sharded Workers Header File.
+ *
+ *       Multi-core mode: the server forks one worker process per shard, each
+ *       one pinned to a core and owning its own SO_REUSEPORT listener, session
+ *       table and file cache. Incoming requests are spread among the listeners
+ *       by a hash of the client source address, so that retransmitted RRQs of
+ *       the same client always land on the same worker.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef TFTP_WORKERS_H
+#define TFTP_WORKERS_H
+
+/**
+ * Maximum number of worker processes.
+ */
+#define MAX_WORKERS 256
+
+/**
+ * Number of worker processes, 1 to serve everything from the main process.
+ */
+extern int workers;
+
+/**
+ * Creates one SO_REUSEPORT listener per worker on the given port, attaches the
+ * source address hash steering program to the listeners group and forks the
+ * workers. The calling process becomes the supervisor of the workers: a worker
+ * terminating for any reason is spawned again on the same listener. This
+ * function never returns.
+ *
+ * @param  port  server socket port.
+ */
+void start_workers(int port);
+
+#endif
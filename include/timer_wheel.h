@@ -0,0 +1,111 @@
+/**
+ * File: timer_wheel.h
+ *       Hierarchical Timer Wheel Header File.
+ *
+ *       Retransmission deadlines of all the sessions served by the event loop
+ *       are kept in a 4 levels wheel of 64 slots each, ticking every
+ *       millisecond: level l slots span 64^l milliseconds, so that the wheel
+ *       covers more than 4 hours. Arming, re-arming and cancelling a timer
+ *       are O(1) list operations; timers of the upper levels are moved down
+ *       (cascaded) when the lower level wraps around. A bitmap of the non
+ *       empty slots of each level gives the time of the next event without
+ *       walking the timers.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/**
+ * Number of levels of the wheel.
+ */
+#define WHEEL_LEVELS 4
+
+/**
+ * Number of slots of each level, and bits of the slot index.
+ */
+#define WHEEL_SLOTS 64
+#define WHEEL_BITS 6
+
+/**
+ * A timer, embedded in the structure it belongs to.
+ */
+typedef struct Timer {
+	uint64_t expires;	// expiration time (ms)
+	int armed;		// 1 while linked in a wheel slot
+	void *data;		// owner of the timer
+	struct Timer *prev;	// previous timer in the slot
+	struct Timer *next;	// next timer in the slot
+} Timer;
+
+/**
+ * A hierarchical timer wheel.
+ */
+typedef struct {
+	uint64_t now;					// last tick processed (ms)
+	uint64_t count;					// armed timers
+	uint64_t bitmap[WHEEL_LEVELS];			// non empty slots
+	Timer *slots[WHEEL_LEVELS][WHEEL_SLOTS];	// timers lists
+} TimerWheel;
+
+/**
+ * Initializes an empty wheel starting at the given time.
+ *
+ * @param  wheel  the wheel;
+ * @param  now    current time in milliseconds.
+ */
+void wheel_init(TimerWheel *wheel, uint64_t now);
+
+/**
+ * Initializes the given timer, not armed, for the given owner.
+ *
+ * @param  timer  the timer;
+ * @param  data   owner of the timer.
+ */
+void timer_init(Timer *timer, void *data);
+
+/**
+ * Arms the given timer to expire at the given time, moving it if already
+ * armed. Times already passed expire on the next tick.
+ *
+ * @param  wheel    the wheel;
+ * @param  timer    the timer;
+ * @param  expires  expiration time in milliseconds.
+ */
+void timer_arm(TimerWheel *wheel, Timer *timer, uint64_t expires);
+
+/**
+ * Cancels the given timer if armed.
+ *
+ * @param  wheel  the wheel;
+ * @param  timer  the timer.
+ */
+void timer_cancel(TimerWheel *wheel, Timer *timer);
+
+/**
+ * Advances the wheel up to the given time, calling the given function for
+ * every expired timer. The timer is no longer armed when the function is
+ * called, which may arm it again.
+ *
+ * @param  wheel   the wheel;
+ * @param  now     current time in milliseconds;
+ * @param  expire  function called for every expired timer.
+ */
+void wheel_advance(TimerWheel *wheel, uint64_t now, void (*expire)(Timer *));
+
+/**
+ * Computes the time left before the wheel must be advanced again, either for
+ * a timer expiring or for the upper level timers to be cascaded.
+ *
+ * @param  wheel  the wheel;
+ * @param  now    current time in milliseconds.
+ *
+ * @return  the time left in milliseconds, -1 if no timer is armed.
+ */
+int wheel_next_timeout(TimerWheel *wheel, uint64_t now);
+
+#endif
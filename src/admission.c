@@ -0,0 +1,242 @@
+/**
+ * File: admission.c
+ *       Transfer Admission Control Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <fnmatch.h>
+
+#include "../include/admission.h"
+
+Admission admission = {
+	.max_transfers = ADMISSION_MAX_TRANSFERS,
+	.queue_len = ADMISSION_QUEUE_LEN
+};
+
+/**
+ * Returns the priority class of the given file.
+ *
+ * @param  file_name  requested file name.
+ *
+ * @return  the priority class.
+ */
+static Priority file_priority(const char *file_name);
+
+/**
+ * Returns the number of queued requests of all the priority classes.
+ *
+ * @return  the pending queue depth.
+ */
+static int queue_depth();
+
+/**
+ * Checks if the given request is already queued.
+ *
+ * @param  req       the received request;
+ * @param  cli_addr  client address.
+ *
+ * @return  1 if the request is queued, 0 otherwise.
+ */
+static int is_queued(const Request *req, const struct sockaddr_in *cli_addr);
+
+int admission_add_pattern(const char *pattern)
+{
+	if (admission.patterns_count == ADMISSION_PATTERNS)
+	{
+		return -1;
+	}
+
+	admission.patterns[admission.patterns_count++] = pattern;
+	return 0;
+}
+
+AdmissionResult admission_request(int socket, const Request *req,
+				  const struct sockaddr_in *cli_addr)
+{
+	// a free transfer slot, nobody waiting before
+	if (admission.active < admission.max_transfers && queue_depth() == 0)
+	{
+		admission.active++;
+		admission.stats.started++;
+		return ADMIT_START;
+	}
+
+	// the client retransmitted a request still waiting
+	if (is_queued(req, cli_addr))
+	{
+		admission.stats.duplicates++;
+		return ADMIT_DUPLICATE;
+	}
+
+	// uploads are never high priority
+	Priority priority = PRIORITY_NORMAL;
+	if (req->opcode == OP_RRQ)
+	{
+		priority = file_priority(req->file_name);
+	}
+
+	// queue full: a high priority request takes the place of the last
+	// queued normal request, otherwise it is refused
+	if (queue_depth() >= admission.queue_len)
+	{
+		PendingQueue *normal = &admission.queues[PRIORITY_NORMAL];
+		if (priority != PRIORITY_HIGH || normal->count == 0)
+		{
+			admission.stats.busy++;
+			send_reject(socket, cli_addr, ERR_UNDEFINED);
+			return ADMIT_BUSY;
+		}
+
+		normal->count--;
+		const PendingRequest *last = &normal->entries[(normal->head +
+				normal->count) % ADMISSION_QUEUE_MAX];
+		admission.stats.displaced++;
+		admission.stats.busy++;
+		send_reject(socket, &last->cli_addr, ERR_UNDEFINED);
+	}
+
+	// append the request to its priority class
+	PendingQueue *queue = &admission.queues[priority];
+	PendingRequest *entry = &queue->entries[(queue->head + queue->count) %
+						ADMISSION_QUEUE_MAX];
+	entry->req = *req;
+	entry->cli_addr = *cli_addr;
+	entry->queued_at = get_time_ms();
+	queue->count++;
+
+	admission.stats.queued++;
+	if (queue_depth() > admission.stats.max_depth)
+	{
+		admission.stats.max_depth = queue_depth();
+	}
+
+	return ADMIT_QUEUED;
+}
+
+void admission_done()
+{
+	if (admission.active > 0)
+	{
+		admission.active--;
+	}
+}
+
+int admission_next(Request *req, struct sockaddr_in *cli_addr)
+{
+	uint64_t now = get_time_ms();
+
+	// high priority requests first
+	int priority = 0;
+	while (admission.active < admission.max_transfers &&
+	       priority < PRIORITIES)
+	{
+		PendingQueue *queue = &admission.queues[priority];
+		if (queue->count == 0)
+		{
+			priority++;
+			continue;
+		}
+
+		// pop the oldest request
+		const PendingRequest *entry = &queue->entries[queue->head];
+		queue->head = (queue->head + 1) % ADMISSION_QUEUE_MAX;
+		queue->count--;
+
+		// the client already gave up
+		uint64_t wait = now - entry->queued_at;
+		if (wait > ADMISSION_MAX_WAIT)
+		{
+			admission.stats.expired++;
+			continue;
+		}
+
+		admission.stats.dequeued++;
+		admission.stats.wait_total += wait;
+		if (wait > admission.stats.wait_max)
+		{
+			admission.stats.wait_max = wait;
+		}
+
+		*req = entry->req;
+		*cli_addr = entry->cli_addr;
+		admission.active++;
+		return 1;
+	}
+
+	return 0;
+}
+
+void admission_print_stats(void (*log)(LogType, const char *))
+{
+	const AdmissionStats *stats = &admission.stats;
+
+	sprintf(log_message, "Admission: %d/%d active transfers, %d high and "
+		"%d normal requests queued (deepest %d/%d).", admission.active,
+		admission.max_transfers,
+		admission.queues[PRIORITY_HIGH].count,
+		admission.queues[PRIORITY_NORMAL].count, stats->max_depth,
+		admission.queue_len);
+	log(INFO, log_message);
+
+	sprintf(log_message, "Admission: %llu started, %llu queued, %llu "
+		"dequeued (wait avg %.1f ms, max %llu ms), %llu duplicates, "
+		"%llu busy errors, %llu displaced, %llu expired.",
+		(unsigned long long)stats->started,
+		(unsigned long long)stats->queued,
+		(unsigned long long)stats->dequeued,
+		stats->dequeued > 0 ?
+		(double)stats->wait_total / stats->dequeued : 0.0,
+		(unsigned long long)stats->wait_max,
+		(unsigned long long)stats->duplicates,
+		(unsigned long long)stats->busy,
+		(unsigned long long)stats->displaced,
+		(unsigned long long)stats->expired);
+	log(INFO, log_message);
+}
+
+static Priority file_priority(const char *file_name)
+{
+	int i;
+	for (i = 0; i < admission.patterns_count; i++)
+	{
+		if (fnmatch(admission.patterns[i], file_name, 0) == 0)
+		{
+			return PRIORITY_HIGH;
+		}
+	}
+
+	return PRIORITY_NORMAL;
+}
+
+static int queue_depth()
+{
+	return admission.queues[PRIORITY_HIGH].count +
+	       admission.queues[PRIORITY_NORMAL].count;
+}
+
+static int is_queued(const Request *req, const struct sockaddr_in *cli_addr)
+{
+	int priority;
+	for (priority = 0; priority < PRIORITIES; priority++)
+	{
+		const PendingQueue *queue = &admission.queues[priority];
+
+		int i;
+		for (i = 0; i < queue->count; i++)
+		{
+			const PendingRequest *entry = &queue->entries[
+				(queue->head + i) % ADMISSION_QUEUE_MAX];
+			if (entry->cli_addr.sin_addr.s_addr ==
+			    cli_addr->sin_addr.s_addr &&
+			    entry->cli_addr.sin_port == cli_addr->sin_port &&
+			    strcmp(entry->req.file_name, req->file_name) == 0)
+			{
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * File: archive.c
+ *       Serving Archive Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/archive.h"
+
+/**
+ * Checks that the header and all the index entries of the given archive point
+ * inside the mapping, so that lookups never need to.
+ *
+ * @param  archive  the archive.
+ *
+ * @return  0 if the archive is valid, -1 otherwise.
+ */
+static int check_archive(Archive *archive);
+
+uint32_t archive_hash(const char *name, uint32_t len)
+{
+	uint32_t hash = 2166136261u;
+
+	uint32_t i;
+	for (i = 0; i < len; i++)
+	{
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+int archive_open(Archive *archive, const char *path)
+{
+	memset(archive, 0, sizeof(Archive));
+
+	// open the archive file and retrieve its size
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(ArchiveHeader))
+	{
+		close(fd);
+		return -1;
+	}
+
+	// map the whole archive, the mapping outlives the descriptor
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		return -1;
+	}
+	archive->map = map;
+	archive->size = st.st_size;
+	archive->header = map;
+
+	// reject anything but a complete archive
+	if (check_archive(archive) < 0)
+	{
+		archive_close(archive);
+		return -1;
+	}
+	archive->index = (const ArchiveEntry *)(archive->map +
+						archive->header->index_offset);
+
+	return 0;
+}
+
+const ArchiveEntry *archive_lookup(const Archive *archive, const char *name)
+{
+	uint32_t len = strlen(name);
+	uint32_t hash = archive_hash(name, len);
+	uint64_t mask = archive->header->index_size - 1;
+
+	// probe from the home slot up to the first empty one
+	uint64_t i;
+	for (i = hash & mask; archive->index[i].name_len > 0; i = (i + 1) & mask)
+	{
+		const ArchiveEntry *entry = &archive->index[i];
+		if (entry->hash == hash && entry->name_len == len &&
+		    memcmp(archive->map + entry->name_offset, name, len) == 0)
+		{
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+void archive_close(Archive *archive)
+{
+	if (archive->map != NULL)
+	{
+		munmap(archive->map, archive->size);
+	}
+	memset(archive, 0, sizeof(Archive));
+}
+
+static int check_archive(Archive *archive)
+{
+	const ArchiveHeader *header = archive->header;
+
+	// format and size written by tftp_pack
+	if (header->magic != ARCHIVE_MAGIC ||
+	    header->version != ARCHIVE_VERSION || header->size != archive->size)
+	{
+		return -1;
+	}
+
+	// the index must hold an empty slot to end every probe sequence
+	uint64_t slots = header->index_size;
+	if (slots == 0 || (slots & (slots - 1)) != 0 || header->count >= slots ||
+	    header->index_offset > archive->size ||
+	    slots > (archive->size - header->index_offset) /
+		    sizeof(ArchiveEntry) ||
+	    header->index_offset % sizeof(uint64_t) != 0)
+	{
+		return -1;
+	}
+
+	// every name and contents inside the archive
+	const ArchiveEntry *index = (const ArchiveEntry *)(archive->map +
+							   header->index_offset);
+	uint64_t i;
+	for (i = 0; i < slots; i++)
+	{
+		const ArchiveEntry *entry = &index[i];
+		if (entry->name_len == 0)
+		{
+			continue;
+		}
+		if (entry->name_offset > archive->size ||
+		    entry->name_len > archive->size - entry->name_offset ||
+		    entry->offset > archive->size ||
+		    entry->size > archive->size - entry->offset)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,294 @@
+/**
+ * File: async_writer.c
+ *       Asynchronous File Writer Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "../include/async_writer.h"
+
+/**
+ * Writer thread body: writes the queued buffers until the writer is closed.
+ *
+ * @param  arg  the writer.
+ *
+ * @return  always NULL.
+ */
+static void *writer_thread(void *arg);
+
+/**
+ * Writes the given buffers at the given file offset, retrying short writes.
+ *
+ * @param  fd      destination file descriptor;
+ * @param  iov     buffers to be written;
+ * @param  count   number of buffers;
+ * @param  offset  file offset.
+ *
+ * @return  the number of bytes written or -1 in case of error.
+ */
+static ssize_t write_all(int fd, struct iovec *iov, int count, uint64_t offset);
+
+AsyncWriter *writer_open(const char *path, uint64_t size)
+{
+	// allocate and clear the new writer
+	AsyncWriter *writer = calloc(1, sizeof(AsyncWriter));
+	if (writer == NULL)
+	{
+		return NULL;
+	}
+
+	// allocate the ring buffers
+	writer->buffers = malloc(WRITER_SLOTS * WRITER_SLOT_SIZE);
+	if (writer->buffers == NULL)
+	{
+		free(writer);
+		return NULL;
+	}
+
+	// create or truncate the destination file
+	writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (writer->fd < 0)
+	{
+		free(writer->buffers);
+		free(writer);
+		return NULL;
+	}
+
+	// allocate the file space at once: just a hint, not supported by all
+	// file systems
+	if (size > 0)
+	{
+		fallocate(writer->fd, 0, 0, size);
+	}
+
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->not_empty, NULL);
+	pthread_cond_init(&writer->not_full, NULL);
+
+	// start the writer thread
+	int ret = pthread_create(&writer->thread, NULL, writer_thread, writer);
+	if (ret != 0)
+	{
+		close(writer->fd);
+		free(writer->buffers);
+		free(writer);
+		errno = ret;
+		return NULL;
+	}
+
+	return writer;
+}
+
+int writer_write(AsyncWriter *writer, const char *data, size_t len)
+{
+	pthread_mutex_lock(&writer->lock);
+
+	while (len > 0 && writer->error == 0)
+	{
+		// all the buffers are waiting for the disk
+		if (writer->count == WRITER_SLOTS)
+		{
+			writer->stalls++;
+			while (writer->count == WRITER_SLOTS &&
+			       writer->error == 0)
+			{
+				pthread_cond_wait(&writer->not_full,
+						  &writer->lock);
+			}
+			continue;
+		}
+
+		// the buffer being filled follows the waiting ones
+		int slot = (writer->head + writer->count) % WRITER_SLOTS;
+		char *buffer = writer->buffers + slot * WRITER_SLOT_SIZE;
+
+		// copy as much data as the buffer can hold
+		size_t room = WRITER_SLOT_SIZE - writer->fill_len;
+		size_t n = len < room ? len : room;
+		memcpy(buffer + writer->fill_len, data, n);
+		writer->fill_len += n;
+		data += n;
+		len -= n;
+
+		// buffer full: hand it to the writer thread
+		if (writer->fill_len == WRITER_SLOT_SIZE)
+		{
+			writer->count++;
+			writer->fill_len = 0;
+			pthread_cond_signal(&writer->not_empty);
+		}
+	}
+
+	// report the first failed write
+	int error = writer->error;
+	pthread_mutex_unlock(&writer->lock);
+
+	if (error != 0)
+	{
+		errno = error;
+		return -1;
+	}
+
+	return 0;
+}
+
+int writer_close(AsyncWriter *writer)
+{
+	pthread_mutex_lock(&writer->lock);
+
+	// hand the last partially filled buffer to the writer thread
+	if (writer->fill_len > 0 && writer->count < WRITER_SLOTS)
+	{
+		writer->count++;
+	}
+
+	// let the writer thread terminate once the ring is empty
+	writer->closing = 1;
+	pthread_cond_signal(&writer->not_empty);
+	pthread_mutex_unlock(&writer->lock);
+
+	pthread_join(writer->thread, NULL);
+
+	// drop the space allocated in advance and not written
+	if (writer->error == 0 && ftruncate(writer->fd, writer->offset) < 0)
+	{
+		writer->error = errno;
+	}
+
+	// print writer statistics
+	sprintf(log_message, "Written %llu bytes with %llu pwritev() calls, "
+		"%.1f KB per call. Receiver stalled by the disk %llu times.",
+		(unsigned long long)writer->bytes,
+		(unsigned long long)writer->writes,
+		writer->writes > 0 ? writer->bytes / 1024.0 / writer->writes :
+		0.0, (unsigned long long)writer->stalls);
+	print_log(INFO, log_message);
+
+	int error = writer->error;
+
+	close(writer->fd);
+	pthread_mutex_destroy(&writer->lock);
+	pthread_cond_destroy(&writer->not_empty);
+	pthread_cond_destroy(&writer->not_full);
+	free(writer->buffers);
+	free(writer);
+
+	if (error != 0)
+	{
+		errno = error;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void *writer_thread(void *arg)
+{
+	AsyncWriter *writer = arg;
+
+	pthread_mutex_lock(&writer->lock);
+
+	while (1)
+	{
+		// wait for buffers to be written
+		while (writer->count == 0 && !writer->closing)
+		{
+			pthread_cond_wait(&writer->not_empty, &writer->lock);
+		}
+
+		// nothing left and no more data will be queued
+		if (writer->count == 0)
+		{
+			break;
+		}
+
+		// write all the waiting buffers with a single call: the last
+		// one is partially filled only when closing
+		int count = writer->count;
+		struct iovec iov[WRITER_SLOTS];
+		int i;
+		for (i = 0; i < count; i++)
+		{
+			int slot = (writer->head + i) % WRITER_SLOTS;
+			iov[i].iov_base = writer->buffers +
+					  slot * WRITER_SLOT_SIZE;
+			iov[i].iov_len = WRITER_SLOT_SIZE;
+		}
+		if (writer->closing && writer->fill_len > 0)
+		{
+			iov[count - 1].iov_len = writer->fill_len;
+		}
+		uint64_t offset = writer->offset;
+
+		// the receiver keeps filling the other buffers meanwhile
+		pthread_mutex_unlock(&writer->lock);
+		ssize_t written = write_all(writer->fd, iov, count, offset);
+		int error = errno;
+		pthread_mutex_lock(&writer->lock);
+
+		// stop at the first failed write
+		if (written < 0)
+		{
+			writer->error = error;
+			pthread_cond_signal(&writer->not_full);
+			break;
+		}
+
+		// release the written buffers
+		writer->head = (writer->head + count) % WRITER_SLOTS;
+		writer->count -= count;
+		writer->offset += written;
+		writer->bytes += written;
+		writer->writes++;
+		pthread_cond_signal(&writer->not_full);
+	}
+
+	pthread_mutex_unlock(&writer->lock);
+
+	return NULL;
+}
+
+static ssize_t write_all(int fd, struct iovec *iov, int count, uint64_t offset)
+{
+	// bytes written so far
+	ssize_t done = 0;
+
+	while (count > 0)
+	{
+		ssize_t ret = pwritev(fd, iov, count, offset + done);
+		if (ret < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return -1;
+		}
+		done += ret;
+
+		// skip the buffers completely written
+		while (count > 0 && (size_t)ret >= iov->iov_len)
+		{
+			ret -= iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		// the first buffer may be partially written
+		if (count > 0)
+		{
+			iov->iov_base = (char *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return done;
+}
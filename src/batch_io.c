@@ -0,0 +1,394 @@
+/**
+ * File: batch_io.c
+ *       Batched Socket I/O Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <netinet/udp.h>
+
+#include "../include/batch_io.h"
+
+BatchStats batch_stats;
+
+int gso_enabled = 1;
+
+/**
+ * Smallest segment size refused by the kernel, bigger than the path MTU of some
+ * client: longer packets are never sent as GSO segments again.
+ */
+static size_t gso_refused = MAX_GSO_BYTES;
+
+/**
+ * Returns the number of packets, starting from the given one, that can be sent
+ * as a single UDP GSO buffer: all of them have the length of the first one,
+ * but the last one which may be shorter, and go to the same address.
+ *
+ * @param  batch  the batch;
+ * @param  first  index of the first packet.
+ *
+ * @return  the number of packets of the run, at least 1.
+ */
+static int gso_run(SendBatch *batch, int first);
+
+/**
+ * Control message carrying the UDP GSO segment size, aligned as a cmsghdr.
+ */
+typedef union {
+	char buf[CMSG_SPACE(sizeof(uint16_t))];
+	struct cmsghdr align;
+} GsoControl;
+
+/**
+ * Fills the given message header to send the given run of packets as a single
+ * UDP GSO buffer.
+ *
+ * @param  batch    the batch;
+ * @param  first    index of the first packet;
+ * @param  count    number of packets of the run;
+ * @param  msg      message header to be filled;
+ * @param  control  control message buffer of the message.
+ */
+static void gso_message(SendBatch *batch, int first, int count,
+			struct msghdr *msg, GsoControl *control);
+
+/**
+ * Updates the given batch sizes histogram.
+ *
+ * @param  hist   the histogram;
+ * @param  count  packets moved by a single call.
+ */
+static void account(uint64_t *hist, int count)
+{
+	// bucket i holds the sizes between 2^i and 2^(i+1) - 1
+	int bucket = 0;
+	while (count > 1 && bucket < BATCH_BUCKETS - 1)
+	{
+		count >>= 1;
+		bucket++;
+	}
+
+	hist[bucket]++;
+}
+
+void batch_init(SendBatch *batch, int sock)
+{
+	batch->sock = sock;
+	batch->count = 0;
+}
+
+void batch_add(SendBatch *batch, const struct sockaddr_in *addr, char *header,
+	       int header_len, const struct iovec *data)
+{
+	// no room left, send the packets collected so far
+	if (batch->count == MAX_BATCH)
+	{
+		batch_flush(batch);
+	}
+
+	// gather header and payload
+	struct iovec *iov = batch->iov[batch->count];
+	iov[0].iov_base = header;
+	iov[0].iov_len = header_len;
+	iov[1] = *data;
+
+	// fill the message header
+	struct msghdr *msg = &batch->msgs[batch->count].msg_hdr;
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_name = (void *)addr;
+	msg->msg_namelen = sizeof(*addr);
+	msg->msg_iov = iov;
+	msg->msg_iovlen = 2;
+
+	batch->count++;
+}
+
+int batch_flush(SendBatch *batch)
+{
+	// number of packets sent
+	int sent = 0;
+
+	// messages of a single sendmmsg() call: GSO runs are gathered into a
+	// single message, the other packets go out as they are
+	struct mmsghdr msgs[MAX_BATCH];
+	GsoControl control[MAX_BATCH];
+	int packets[MAX_BATCH];
+
+	// a partial send leaves the rest of the batch to be sent again
+	while (sent < batch->count)
+	{
+		int count = 0;
+		int next = sent;
+		while (next < batch->count)
+		{
+			int run = gso_enabled ? gso_run(batch, next) : 1;
+			if (run > 1)
+			{
+				gso_message(batch, next, run,
+					    &msgs[count].msg_hdr,
+					    &control[count]);
+			}
+			else
+			{
+				msgs[count].msg_hdr = batch->msgs[next].msg_hdr;
+			}
+
+			packets[count++] = run;
+			next += run;
+		}
+
+		int ret = sendmmsg(batch->sock, msgs, count, MSG_CONFIRM);
+		if (ret <= 0)
+		{
+			// the failed message was a plain packet
+			if (ret == 0 || packets[0] == 1)
+			{
+				break;
+			}
+
+			// segments longer than the path MTU: the buffer was
+			// dropped, send its packets one by one
+			struct iovec *iov = batch->iov[sent];
+			if (errno == EINVAL || errno == EMSGSIZE)
+			{
+				batch_stats.gso_fallbacks++;
+				gso_refused = iov[0].iov_len + iov[1].iov_len;
+				continue;
+			}
+
+			// GSO not supported by the kernel or the device
+			if (errno == EIO || errno == ENOPROTOOPT ||
+			    errno == EOPNOTSUPP)
+			{
+				sprintf(log_message, "UDP GSO not available "
+					"(errno = %d), using sendmmsg().", errno);
+				print_log(ERROR, log_message);
+
+				batch_stats.gso_fallbacks++;
+				gso_enabled = 0;
+				continue;
+			}
+
+			break;
+		}
+
+		// packets carried by the messages sent
+		int moved = 0;
+		int i;
+		for (i = 0; i < ret; i++)
+		{
+			moved += packets[i];
+
+			// update GSO counters
+			if (packets[i] > 1)
+			{
+				batch_stats.gso_calls++;
+				batch_stats.gso_segments += packets[i];
+			}
+		}
+
+		// update batching counters
+		batch_stats.send_calls++;
+		batch_stats.send_packets += moved;
+		account(batch_stats.send_hist, moved);
+
+		sent += moved;
+	}
+
+	// the batch is empty again, unsent packets are recovered by the
+	// retransmission timeout
+	int count = batch->count;
+	batch->count = 0;
+
+	return sent == count ? sent : -1;
+}
+
+static int gso_run(SendBatch *batch, int first)
+{
+	// segment size: the length of the first packet
+	struct msghdr *msg = &batch->msgs[first].msg_hdr;
+	size_t seg = msg->msg_iov[0].iov_len + msg->msg_iov[1].iov_len;
+
+	// total buffer length and number of packets of the run
+	size_t total = seg;
+	int count = 1;
+
+	// segments this long were already refused
+	if (seg >= gso_refused)
+	{
+		return 1;
+	}
+
+	while (first + count < batch->count && count < MAX_GSO_SEGMENTS)
+	{
+		struct msghdr *next = &batch->msgs[first + count].msg_hdr;
+		size_t len = next->msg_iov[0].iov_len + next->msg_iov[1].iov_len;
+
+		// same recipient, no longer than the segment size and within
+		// the largest UDP payload
+		if (memcmp(next->msg_name, msg->msg_name, msg->msg_namelen) != 0
+		    || len > seg || total + len > MAX_GSO_BYTES)
+		{
+			break;
+		}
+
+		total += len;
+		count++;
+
+		// only the last segment may be shorter
+		if (len < seg)
+		{
+			break;
+		}
+	}
+
+	return count;
+}
+
+static void gso_message(SendBatch *batch, int first, int count,
+			struct msghdr *msg, GsoControl *control)
+{
+	// the header and payload iovecs of consecutive packets are contiguous:
+	// the whole run is gathered into a single buffer
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_name = batch->msgs[first].msg_hdr.msg_name;
+	msg->msg_namelen = batch->msgs[first].msg_hdr.msg_namelen;
+	msg->msg_iov = batch->iov[first];
+	msg->msg_iovlen = 2 * count;
+
+	// segment size: the length of the first packet
+	uint16_t seg = batch->iov[first][0].iov_len +
+		       batch->iov[first][1].iov_len;
+
+	// ask the kernel to split the buffer every segment size bytes
+	memset(control, 0, sizeof(*control));
+	msg->msg_control = control->buf;
+	msg->msg_controllen = sizeof(control->buf);
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	memcpy(CMSG_DATA(cmsg), &seg, sizeof(seg));
+}
+
+int batch_recv_alloc(RecvBatch *batch, int count, int size)
+{
+	// never exceed the batch capacity
+	if (count > MAX_BATCH)
+	{
+		count = MAX_BATCH;
+	}
+
+	// allocate all the buffers at once
+	batch->buffers = malloc(count * size);
+	if (batch->buffers == NULL)
+	{
+		return -1;
+	}
+	batch->size = size;
+	batch->capacity = count;
+
+	// point each message to its own buffer
+	int i;
+	for (i = 0; i < count; i++)
+	{
+		batch->iov[i].iov_base = batch->buffers + i * size;
+		batch->iov[i].iov_len = size;
+	}
+
+	return 0;
+}
+
+void batch_recv_free(RecvBatch *batch)
+{
+	free(batch->buffers);
+	batch->buffers = NULL;
+}
+
+int batch_recv(int sock, RecvBatch *batch, int flags)
+{
+	// reset the message headers, the kernel overwrites their lengths
+	int i;
+	for (i = 0; i < batch->capacity; i++)
+	{
+		struct msghdr *msg = &batch->msgs[i].msg_hdr;
+		memset(msg, 0, sizeof(*msg));
+		msg->msg_name = &batch->addrs[i];
+		msg->msg_namelen = sizeof(batch->addrs[i]);
+		msg->msg_iov = &batch->iov[i];
+		msg->msg_iovlen = 1;
+	}
+
+	// receive the packets waiting on the socket
+	int ret = recvmmsg(sock, batch->msgs, batch->capacity, flags, NULL);
+
+	// update batching counters
+	if (ret > 0)
+	{
+		batch_stats.recv_calls++;
+		batch_stats.recv_packets += ret;
+		account(batch_stats.recv_hist, ret);
+	}
+
+	return ret;
+}
+
+char *batch_packet(RecvBatch *batch, int i, int *len)
+{
+	*len = batch->msgs[i].msg_len;
+	return batch->iov[i].iov_base;
+}
+
+void batch_print_stats(void (*log)(LogType, const char *))
+{
+	// average packets per call
+	double send_avg = batch_stats.send_calls > 0 ?
+			  (double)batch_stats.send_packets /
+			  batch_stats.send_calls : 0.0;
+	double recv_avg = batch_stats.recv_calls > 0 ?
+			  (double)batch_stats.recv_packets /
+			  batch_stats.recv_calls : 0.0;
+
+	sprintf(log_message, "sendmmsg: %llu calls, %llu packets, %.1f "
+		"packets per call; histogram 1/2/4/8/16/32/64: %llu/%llu/%llu/"
+		"%llu/%llu/%llu/%llu.",
+		(unsigned long long)batch_stats.send_calls,
+		(unsigned long long)batch_stats.send_packets, send_avg,
+		(unsigned long long)batch_stats.send_hist[0],
+		(unsigned long long)batch_stats.send_hist[1],
+		(unsigned long long)batch_stats.send_hist[2],
+		(unsigned long long)batch_stats.send_hist[3],
+		(unsigned long long)batch_stats.send_hist[4],
+		(unsigned long long)batch_stats.send_hist[5],
+		(unsigned long long)batch_stats.send_hist[6]);
+	log(INFO, log_message);
+
+	sprintf(log_message, "recvmmsg: %llu calls, %llu packets, %.1f "
+		"packets per call; histogram 1/2/4/8/16/32/64: %llu/%llu/%llu/"
+		"%llu/%llu/%llu/%llu.",
+		(unsigned long long)batch_stats.recv_calls,
+		(unsigned long long)batch_stats.recv_packets, recv_avg,
+		(unsigned long long)batch_stats.recv_hist[0],
+		(unsigned long long)batch_stats.recv_hist[1],
+		(unsigned long long)batch_stats.recv_hist[2],
+		(unsigned long long)batch_stats.recv_hist[3],
+		(unsigned long long)batch_stats.recv_hist[4],
+		(unsigned long long)batch_stats.recv_hist[5],
+		(unsigned long long)batch_stats.recv_hist[6]);
+	log(INFO, log_message);
+
+	sprintf(log_message, "UDP GSO: %s, %llu buffers, %llu segments, %.1f "
+		"segments per buffer, %llu fallbacks.",
+		gso_enabled ? "enabled" : "disabled",
+		(unsigned long long)batch_stats.gso_calls,
+		(unsigned long long)batch_stats.gso_segments,
+		batch_stats.gso_calls > 0 ? (double)batch_stats.gso_segments /
+		batch_stats.gso_calls : 0.0,
+		(unsigned long long)batch_stats.gso_fallbacks);
+	log(INFO, log_message);
+}
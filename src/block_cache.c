@@ -0,0 +1,424 @@
+/**
+ * File: block_cache.c
+ *       File Block Cache Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/block_cache.h"
+#include "../include/netascii.h"
+
+BlockCache block_cache = { .budget = CACHE_BUDGET };
+
+/**
+ * Room taken by the loading state at the start of each shared mapping, keeping
+ * the contents cache line aligned.
+ */
+#define FILL_SIZE ((sizeof(CacheFill) + 63) & ~(size_t)63)
+
+/**
+ * Computes the hash of the given cache key (FNV-1a).
+ *
+ * @param  path      file path;
+ * @param  netascii  1 for netascii encoded contents.
+ *
+ * @return  the hash.
+ */
+static uint32_t hash_key(const char *path, int netascii);
+
+/**
+ * Tells if the given cached file still matches the file on disk.
+ *
+ * @param  file  the cached file;
+ * @param  st    current status of the file on disk.
+ *
+ * @return  1 if the file did not change, 0 otherwise.
+ */
+static int file_matches(const CachedFile *file, const struct stat *st);
+
+/**
+ * Removes the given entry from the cache. The file is freed right away if no
+ * transfer is reading it, by its last transfer otherwise.
+ *
+ * @param  index  index of the entry to be removed.
+ */
+static void remove_entry(int index);
+
+/**
+ * Evicts unused files with the CLOCK algorithm until the given number of bytes
+ * and an entry are available.
+ *
+ * @param  len  number of bytes needed.
+ *
+ * @return  0 on success, -1 if too many bytes are held by running transfers.
+ */
+static int make_room(uint64_t len);
+
+/**
+ * Creates the shared mapping holding the loading state and the contents of the
+ * given cached file.
+ *
+ * @param  file  the cached file, its reserved length set.
+ *
+ * @return  0 on success, -1 in case of error.
+ */
+static int map_contents(CachedFile *file);
+
+/**
+ * Locks the loading state of a cached file. The state left by a process which
+ * died while loading is consistent: only complete chunks are published.
+ *
+ * @param  fill  the loading state.
+ */
+static void lock_fill(CacheFill *fill);
+
+/**
+ * Loads the next chunk of the given cached file, encoding it as netascii if
+ * requested. Called with the loading state locked.
+ *
+ * @param  file  the cached file.
+ *
+ * @return  0 on success, -1 if the file could not be read.
+ */
+static int load_chunk(CachedFile *file);
+
+/**
+ * Frees the given cached file.
+ *
+ * @param  file  the file to be freed.
+ */
+static void free_file(CachedFile *file);
+
+void cache_init(uint64_t budget)
+{
+	block_cache.budget = budget;
+}
+
+CachedFile *cache_acquire(int fd, const char *path, int netascii)
+{
+	// only regular files are cached
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+	{
+		return NULL;
+	}
+	if (!S_ISREG(st.st_mode))
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	// look for the file in the requested encoding
+	uint32_t hash = hash_key(path, netascii);
+	int i;
+	for (i = 0; i < CACHE_ENTRIES; i++)
+	{
+		CachedFile *file = block_cache.entries[i];
+		if (file == NULL || file->hash != hash ||
+		    file->netascii != netascii || strcmp(file->path, path) != 0)
+		{
+			continue;
+		}
+
+		// a transfer could not read the file
+		lock_fill(file->fill);
+		int failed = file->fill->failed;
+		pthread_mutex_unlock(&file->fill->lock);
+
+		// HIT: the file did not change since it was added
+		if (!failed && file_matches(file, &st))
+		{
+			block_cache.stats.hits++;
+			file->referenced = 1;
+			file->refs++;
+			return file;
+		}
+
+		// the file was replaced, modified or unreadable: add it again
+		block_cache.stats.invalidations++;
+		remove_entry(i);
+		break;
+	}
+
+	// MISS: the netascii encoding at most doubles the file size
+	block_cache.stats.misses++;
+	uint64_t max_len = st.st_size * (netascii ? 2 : 1);
+	if (max_len > block_cache.budget || make_room(max_len) < 0)
+	{
+		block_cache.stats.bypasses++;
+		errno = EFBIG;
+		return NULL;
+	}
+
+	// allocate and clear the new cached file, loaded from its own
+	// descriptor
+	CachedFile *file = calloc(1, sizeof(CachedFile));
+	if (file == NULL)
+	{
+		return NULL;
+	}
+	file->path = strdup(path);
+	file->hash = hash;
+	file->netascii = netascii;
+	file->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	file->dev = st.st_dev;
+	file->ino = st.st_ino;
+	file->size = st.st_size;
+	file->mtime = st.st_mtim;
+	file->reserved = max_len;
+
+	// the descriptor or the mapping could not be created
+	if (file->path == NULL || file->fd < 0 || map_contents(file) < 0)
+	{
+		free_file(file);
+		return NULL;
+	}
+
+	// store the file in the first free entry, made available above
+	for (i = 0; block_cache.entries[i] != NULL; i++)
+	{
+	}
+	block_cache.entries[i] = file;
+	block_cache.count++;
+	block_cache.used += file->reserved;
+
+	file->refs = 1;
+	return file;
+}
+
+int cache_fill(CachedFile *file, uint64_t end, uint64_t *len)
+{
+	CacheFill *fill = file->fill;
+	lock_fill(fill);
+
+	// load the following chunks until the requested length is available
+	while (!fill->complete && !fill->failed && fill->loaded < end)
+	{
+		if (load_chunk(file) < 0)
+		{
+			fill->failed = 1;
+		}
+	}
+
+	int ret = fill->failed ? -1 : 0;
+	*len = fill->loaded;
+	pthread_mutex_unlock(&fill->lock);
+
+	return ret;
+}
+
+void cache_release(CachedFile *file)
+{
+	// invalidated files are freed by their last transfer
+	file->refs--;
+	if (file->stale && file->refs == 0)
+	{
+		block_cache.used -= file->reserved;
+		free_file(file);
+	}
+}
+
+void cache_print_stats(void (*log)(LogType, const char *))
+{
+	const CacheStats *stats = &block_cache.stats;
+	uint64_t requests = stats->hits + stats->misses;
+
+	sprintf(log_message, "Block cache: %d files, %.1f/%.1f MB used, %llu "
+		"hits, %llu misses (%.1f%% hit rate), %llu evictions, %llu "
+		"invalidations, %llu files too large, %.1f MB loaded.",
+		block_cache.count, block_cache.used / 1048576.0,
+		block_cache.budget / 1048576.0,
+		(unsigned long long)stats->hits,
+		(unsigned long long)stats->misses,
+		requests > 0 ? 100.0 * stats->hits / requests : 0.0,
+		(unsigned long long)stats->evictions,
+		(unsigned long long)stats->invalidations,
+		(unsigned long long)stats->bypasses, stats->loaded / 1048576.0);
+	log(INFO, log_message);
+}
+
+static uint32_t hash_key(const char *path, int netascii)
+{
+	uint32_t hash = 2166136261u;
+
+	// mix in the encoding first
+	hash ^= (uint32_t)netascii;
+	hash *= 16777619u;
+
+	// then the path bytes
+	const unsigned char *p;
+	for (p = (const unsigned char *)path; *p != '\0'; p++)
+	{
+		hash ^= *p;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static int file_matches(const CachedFile *file, const struct stat *st)
+{
+	return file->dev == st->st_dev && file->ino == st->st_ino &&
+	       file->size == st->st_size &&
+	       file->mtime.tv_sec == st->st_mtim.tv_sec &&
+	       file->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void remove_entry(int index)
+{
+	CachedFile *file = block_cache.entries[index];
+	block_cache.entries[index] = NULL;
+	block_cache.count--;
+
+	// still read by running transfers
+	if (file->refs > 0)
+	{
+		file->stale = 1;
+		return;
+	}
+
+	block_cache.used -= file->reserved;
+	free_file(file);
+}
+
+static int make_room(uint64_t len)
+{
+	// two full sweeps: the first one may only clear the referenced bits
+	int steps;
+	for (steps = 0; steps < 2 * CACHE_ENTRIES; steps++)
+	{
+		// enough room and a free entry
+		if (block_cache.used + len <= block_cache.budget &&
+		    block_cache.count < CACHE_ENTRIES)
+		{
+			return 0;
+		}
+
+		// files read by running transfers are never evicted
+		CachedFile *file = block_cache.entries[block_cache.hand];
+		if (file != NULL && file->refs == 0)
+		{
+			// second chance for the files used since the last pass
+			if (file->referenced)
+			{
+				file->referenced = 0;
+			}
+			else
+			{
+				block_cache.stats.evictions++;
+				remove_entry(block_cache.hand);
+			}
+		}
+
+		// advance the hand
+		block_cache.hand = (block_cache.hand + 1) % CACHE_ENTRIES;
+	}
+
+	return block_cache.used + len <= block_cache.budget &&
+	       block_cache.count < CACHE_ENTRIES ? 0 : -1;
+}
+
+static int map_contents(CachedFile *file)
+{
+	// anonymous shared memory: the children forked later share the pages
+	void *map = mmap(NULL, FILL_SIZE + file->reserved,
+			 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			 -1, 0);
+	if (map == MAP_FAILED)
+	{
+		return -1;
+	}
+	file->fill = map;
+	file->data = (char *)map + FILL_SIZE;
+
+	// the lock is shared by the processes and survives a dead owner
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&file->fill->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	// empty files have nothing to load
+	file->fill->complete = file->size == 0;
+
+	return 0;
+}
+
+static void lock_fill(CacheFill *fill)
+{
+	if (pthread_mutex_lock(&fill->lock) == EOWNERDEAD)
+	{
+		pthread_mutex_consistent(&fill->lock);
+	}
+}
+
+static int load_chunk(CachedFile *file)
+{
+	CacheFill *fill = file->fill;
+	uint64_t left = file->size - fill->read;
+	size_t want = left < CACHE_CHUNK ? left : CACHE_CHUNK;
+
+	// binary contents are read in place, text contents are encoded from a
+	// staging buffer
+	static char stage[CACHE_CHUNK];
+	char *buf = file->netascii ? stage : file->data + fill->loaded;
+	ssize_t ret = pread(file->fd, buf, want, fill->read);
+
+	// interrupted by a signal, just read again
+	if (ret < 0 && errno == EINTR)
+	{
+		return 0;
+	}
+
+	// the file was truncated while being loaded
+	if (ret <= 0)
+	{
+		return -1;
+	}
+	fill->read += ret;
+	block_cache.stats.loaded += ret;
+
+	// the reserved room holds the largest encoding: nothing is left
+	// pending in the encoder
+	if (file->netascii)
+	{
+		NetasciiEncoder encoder;
+		netascii_encoder_init(&encoder);
+		size_t consumed;
+		fill->loaded += netascii_encode(&encoder, stage, ret, &consumed,
+						file->data + fill->loaded,
+						file->reserved - fill->loaded);
+	}
+	else
+	{
+		fill->loaded += ret;
+	}
+
+	fill->complete = fill->read == (uint64_t)file->size;
+	return 0;
+}
+
+static void free_file(CachedFile *file)
+{
+	// the children still reading the contents keep their own mapping
+	if (file->fill != NULL)
+	{
+		munmap(file->fill, FILL_SIZE + file->reserved);
+	}
+	if (file->fd >= 0)
+	{
+		close(file->fd);
+	}
+	free(file->path);
+	free(file);
+}
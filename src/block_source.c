@@ -0,0 +1,370 @@
+/**
+ * File: block_source.c
+ *       File Block Source Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/block_source.h"
+
+/**
+ * Reads the next blocks of a text mode source, encoding the file bytes as
+ * netascii into the given buffers.
+ *
+ * @param  src      the block source;
+ * @param  blocks   blocks to be filled;
+ * @param  count    number of blocks to be filled;
+ * @param  blksize  block size.
+ *
+ * @return  the number of blocks filled or -1 in case of error.
+ */
+static int read_netascii(BlockSource *src, struct iovec *blocks, int count,
+			 int blksize);
+
+/**
+ * Makes the next file bytes available in the stage of a text mode source.
+ *
+ * @param  src  the block source.
+ *
+ * @return  0 on success, -1 in case of error.
+ */
+static int fill_stage(BlockSource *src);
+
+BlockSource *block_source_open(const char *path, SourceType type, int netascii)
+{
+	// open source file
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return NULL;
+	}
+
+	// retrieve file size
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	return block_source_fd(fd, path, st.st_size, type, netascii);
+}
+
+BlockSource *block_source_fd(int fd, const char *path, uint64_t size,
+			     SourceType type, int netascii)
+{
+	// serve the blocks from memory: the cached contents are already
+	// encoded and loaded through the descriptor of the cached file
+	if (type == SOURCE_CACHE)
+	{
+		CachedFile *cached = cache_acquire(fd, path, netascii);
+		if (cached != NULL)
+		{
+			close(fd);
+
+			BlockSource *src = calloc(1, sizeof(BlockSource));
+			if (src == NULL)
+			{
+				cache_release(cached);
+				return NULL;
+			}
+			src->type = SOURCE_CACHE;
+			src->fd = -1;
+			src->size = size;
+			src->map = cached->data;
+			src->cached = cached;
+			return src;
+		}
+	}
+
+	// allocate and clear the new block source
+	BlockSource *src = calloc(1, sizeof(BlockSource));
+	if (src == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	src->fd = fd;
+	src->size = size;
+	src->type = SOURCE_PREAD;
+
+	// map the whole file, empty files can not be mapped: text mode sources
+	// never map the file, since the encoder reads the file bytes in user
+	// space, where a page truncated away raises SIGBUS
+	if (type == SOURCE_MMAP && src->size > 0 && !netascii)
+	{
+		void *map = mmap(NULL, src->size, PROT_READ, MAP_SHARED, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			// the file is read once from start to end
+			madvise(map, src->size, MADV_SEQUENTIAL);
+
+			src->map = map;
+			src->type = SOURCE_MMAP;
+		}
+	}
+
+	// tell the kernel to read ahead aggressively
+	if (src->type == SOURCE_PREAD)
+	{
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+
+	// text mode: the file is encoded chunk by chunk
+	if (netascii)
+	{
+		src->netascii = 1;
+		netascii_encoder_init(&src->encoder);
+
+		// the pread() strategy needs its own chunk buffer
+		if (src->type == SOURCE_PREAD)
+		{
+			src->stage_buf = malloc(STAGE_SIZE);
+			if (src->stage_buf == NULL)
+			{
+				block_source_close(src);
+				return NULL;
+			}
+		}
+	}
+
+	return src;
+}
+
+BlockSource *block_source_memory(const char *data, uint64_t size,
+				 int netascii)
+{
+	// allocate and clear the new block source
+	BlockSource *src = calloc(1, sizeof(BlockSource));
+	if (src == NULL)
+	{
+		return NULL;
+	}
+	src->type = SOURCE_ARCHIVE;
+	src->fd = -1;
+	src->size = size;
+	src->map = (char *)data;
+
+	// text mode: the contents are encoded straight from memory
+	if (netascii)
+	{
+		src->netascii = 1;
+		netascii_encoder_init(&src->encoder);
+	}
+
+	return src;
+}
+
+int block_source_read(BlockSource *src, struct iovec *blocks, int count,
+		      int blksize)
+{
+	// text mode blocks are encoded
+	if (src->netascii)
+	{
+		return read_netascii(src, blocks, count, blksize);
+	}
+
+	// number of blocks to be returned
+	int n = 0;
+
+	// CACHE: the contents are loaded up to the end of the window, their
+	// length is known once the whole file is loaded
+	uint64_t size = src->size;
+	if (src->type == SOURCE_CACHE &&
+	    cache_fill(src->cached, src->offset + (uint64_t)count * blksize,
+		       &size) < 0)
+	{
+		return -1;
+	}
+
+	// compute the length of each block from the contents size
+	uint64_t offset = src->offset;
+	while (n < count && !src->eof)
+	{
+		uint64_t left = size - offset;
+		blocks[n].iov_len = left < (uint64_t)blksize ? left :
+				    (uint64_t)blksize;
+
+		// a block shorter than the block size is the last one
+		src->eof = blocks[n].iov_len < (size_t)blksize;
+
+		offset += blocks[n].iov_len;
+		n++;
+	}
+
+	// MMAP: the pages are only read by the kernel while sending, which
+	// fails with EFAULT instead of SIGBUS past the end of a truncated file:
+	// check that the file still holds the blocks before handing them out
+	if (src->type == SOURCE_MMAP && n > 0)
+	{
+		struct stat st;
+		if (fstat(src->fd, &st) < 0 || (uint64_t)st.st_size < offset)
+		{
+			return -1;
+		}
+	}
+
+	// MMAP, CACHE and ARCHIVE: point each block into the file contents
+	if (src->type != SOURCE_PREAD)
+	{
+		int i;
+		for (i = 0; i < n; i++)
+		{
+			blocks[i].iov_base = src->map + src->offset;
+			src->offset += blocks[i].iov_len;
+		}
+
+		return n;
+	}
+
+	// PREAD: fill all the packet buffers with a single system call
+	uint64_t total = offset - src->offset;
+	uint64_t done = 0;
+	while (done < total)
+	{
+		// skip the buffers already filled by a short read
+		int first = 0;
+		uint64_t skip = done;
+		while (first < n && skip >= blocks[first].iov_len)
+		{
+			skip -= blocks[first].iov_len;
+			first++;
+		}
+
+		// the first buffer may be partially filled
+		struct iovec *iov = blocks + first;
+		char *base = iov->iov_base;
+		size_t len = iov->iov_len;
+		iov->iov_base = base + skip;
+		iov->iov_len = len - skip;
+
+		ssize_t ret = preadv(src->fd, iov, n - first,
+				     src->offset + done);
+
+		// restore the partially filled buffer
+		iov->iov_base = base;
+		iov->iov_len = len;
+
+		// the file was truncated while being transferred
+		if (ret <= 0)
+		{
+			return -1;
+		}
+
+		done += ret;
+	}
+	src->offset = offset;
+
+	return n;
+}
+
+static int read_netascii(BlockSource *src, struct iovec *blocks, int count,
+			 int blksize)
+{
+	// number of blocks to be returned
+	int n = 0;
+
+	while (n < count && !src->eof)
+	{
+		// the block is encoded in the given buffer
+		char *out = blocks[n].iov_base;
+		size_t len = 0;
+
+		while (len < (size_t)blksize)
+		{
+			// all the file bytes encoded, only a split expansion
+			// may still be pending
+			if (src->stage_pos == src->stage_len)
+			{
+				if (src->offset == src->size &&
+				    !src->encoder.pending)
+				{
+					break;
+				}
+				if (src->offset < src->size && fill_stage(src) < 0)
+				{
+					return -1;
+				}
+			}
+
+			// encode as many bytes as the block can hold
+			size_t consumed;
+			len += netascii_encode(&src->encoder,
+					       src->stage + src->stage_pos,
+					       src->stage_len - src->stage_pos,
+					       &consumed, out + len,
+					       blksize - len);
+			src->stage_pos += consumed;
+		}
+
+		// a block shorter than the block size is the last one
+		blocks[n].iov_len = len;
+		src->eof = len < (size_t)blksize;
+		n++;
+	}
+
+	return n;
+}
+
+static int fill_stage(BlockSource *src)
+{
+	// ARCHIVE: the rest of the file is available in memory
+	if (src->type != SOURCE_PREAD)
+	{
+		src->stage = src->map + src->offset;
+		src->stage_len = src->size - src->offset;
+		src->stage_pos = 0;
+		src->offset = src->size;
+
+		return 0;
+	}
+
+	// PREAD: read the next chunk
+	uint64_t left = src->size - src->offset;
+	ssize_t ret = pread(src->fd, src->stage_buf,
+			    left < STAGE_SIZE ? left : STAGE_SIZE, src->offset);
+
+	// the file was truncated while being transferred
+	if (ret <= 0)
+	{
+		return -1;
+	}
+
+	src->stage = src->stage_buf;
+	src->stage_len = ret;
+	src->stage_pos = 0;
+	src->offset += ret;
+
+	return 0;
+}
+
+void block_source_close(BlockSource *src)
+{
+	// release the cached file, the archive stays mapped
+	if (src->type == SOURCE_CACHE || src->type == SOURCE_ARCHIVE)
+	{
+		if (src->cached != NULL)
+		{
+			cache_release(src->cached);
+		}
+		free(src);
+		return;
+	}
+
+	// release the file mapping
+	if (src->map != NULL)
+	{
+		munmap(src->map, src->size);
+	}
+
+	close(src->fd);
+	free(src->stage_buf);
+	free(src);
+}
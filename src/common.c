@@ -6,8 +6,12 @@
  *	   Created on 24/10/2019.
  */
 
+#include <time.h>
+
 #include "../include/common.h"
 
+char log_message[1024];
+
 /**
  * Info log messages are preceded by the starting character '>' while error log
  * messages are preceded by the starting character '!>'.
@@ -66,3 +70,56 @@ void check_errno(int ret, char *info)
 		exit(-1);
 	}
 }
+
+uint64_t get_time_ms()
+{
+	// monotonic clock value
+	struct timespec ts;
+
+	// retrieve current monotonic time
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	// convert to milliseconds
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t get_time_us()
+{
+	// monotonic clock value
+	struct timespec ts;
+
+	// retrieve current monotonic time
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	// convert to microseconds
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint16_t wrap_block(uint64_t block, int rollover)
+{
+	// no rollover yet
+	if (block <= 65535)
+	{
+		return block;
+	}
+
+	// block numbers cycle between the rollover value and 65535
+	return rollover + (block - 65536) % (65536 - rollover);
+}
+
+uint16_t block_distance(uint16_t from, uint16_t to, int rollover)
+{
+	// block 0 is out of the cycle with rollover 1: only the first ACK
+	// carries it
+	if (to < rollover)
+	{
+		return from == to ? 0 : 65535;
+	}
+	if (from < rollover)
+	{
+		return to - from;
+	}
+
+	// distance along the cycle
+	return (to - from + 65536 - rollover) % (65536 - rollover);
+}
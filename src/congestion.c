@@ -0,0 +1,370 @@
+/**
+ * File: congestion.c
+ *       Congestion Control Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <string.h>
+
+#include "../include/congestion.h"
+
+int cc_enabled = 1;
+
+int cc_trace = 0;
+
+/**
+ * Returns the length of a round.
+ *
+ * @param  srtt  smoothed round trip time (us), 0 if unknown;
+ * @param  rto   retransmission timeout (us).
+ *
+ * @return  the round length (us).
+ */
+static uint32_t round_length(uint32_t srtt, uint32_t rto);
+
+/**
+ * Returns the time between two paced blocks: the congestion window is sent
+ * over a fraction of the round trip time, so that a whole window is never sent
+ * at once to fill the bottleneck queue.
+ *
+ * @param  cc    the congestion control state;
+ * @param  srtt  smoothed round trip time (us), 0 if unknown.
+ *
+ * @return  the pacing interval (us), 0 if the blocks are not paced.
+ */
+static uint32_t pacing_interval(const CongestionControl *cc, uint32_t srtt);
+
+/**
+ * Returns the congestion window opened for the given blocks delivered.
+ *
+ * @param  cc      the congestion control state;
+ * @param  blocks  blocks delivered.
+ *
+ * @return  the opened congestion window.
+ */
+static int opened_window(const CongestionControl *cc, int blocks);
+
+/**
+ * Opens the congestion window for the given blocks delivered.
+ *
+ * @param  cc      the congestion control state;
+ * @param  blocks  blocks delivered;
+ * @param  sent    index of the last block sent.
+ */
+static void grow(CongestionControl *cc, int blocks, uint64_t sent);
+
+/**
+ * Logs a congestion window change if tracing is enabled.
+ *
+ * @param  cc     the congestion control state;
+ * @param  event  the event changing the window;
+ * @param  block  index of the last block sent.
+ */
+static void trace(const CongestionControl *cc, const char *event,
+		  uint64_t block);
+
+void cc_init(CongestionControl *cc, int limit, const char *name)
+{
+	memset(cc, 0, sizeof(CongestionControl));
+	cc->name = name;
+	cc->limit = limit;
+
+	// slow start up to the whole window
+	cc->cwnd = cc_enabled && CWND_INITIAL < limit ? CWND_INITIAL : limit;
+	cc->ssthresh = limit;
+	cc->max_cwnd = cc->cwnd;
+	cc->started = get_time_us();
+}
+
+int cc_budget(const CongestionControl *cc, uint64_t now, uint32_t srtt,
+	      uint32_t rto)
+{
+	// whole windows, bounded by the window size only
+	if (!cc_enabled)
+	{
+		return cc->limit;
+	}
+
+	// a new round starts with the next block sent, with the window opened
+	// for the blocks of the last round: slow start doubles it each round
+	int allowed = cc->limit;
+	if (cc->cwnd < cc->limit &&
+	    now >= cc->round_start + round_length(srtt, rto))
+	{
+		allowed = cc->round_lost ? cc->cwnd :
+			  opened_window(cc, cc->round_sent);
+	}
+	else if (cc->cwnd < cc->limit)
+	{
+		allowed = cc->round_sent < cc->cwnd ?
+			  cc->cwnd - cc->round_sent : 0;
+	}
+
+	// the blocks due by the next timer tick, without any credit for the
+	// time the session was idle
+	uint32_t interval = pacing_interval(cc, srtt);
+	if (interval == 0)
+	{
+		return allowed;
+	}
+	uint64_t from = cc->paced > now ? cc->paced : now;
+	if (from > now + PACING_TICK_US)
+	{
+		return 0;
+	}
+	uint64_t paced = (now + PACING_TICK_US - from) / interval + 1;
+
+	return paced < (uint64_t)allowed ? (int)paced : allowed;
+}
+
+void cc_sent(CongestionControl *cc, int blocks, uint64_t sent, uint64_t now,
+	     uint32_t srtt, uint32_t rto)
+{
+	if (blocks == 0)
+	{
+		return;
+	}
+
+	// the current round is over: the client reports a gap right away,
+	// the blocks of the last round were delivered unless a loss was
+	// reported in the meantime
+	if (now >= cc->round_start + round_length(srtt, rto))
+	{
+		if (!cc->round_lost)
+		{
+			grow(cc, cc->round_sent, sent);
+		}
+		cc->round_start = now;
+		cc->round_sent = 0;
+		cc->round_lost = 0;
+		cc->rounds++;
+	}
+
+	cc->round_sent += blocks;
+
+	// the next blocks are due after the pacing intervals of the sent ones
+	uint64_t from = cc->paced > now ? cc->paced : now;
+	cc->paced = from + (uint64_t)blocks * pacing_interval(cc, srtt);
+}
+
+uint64_t cc_next_send(const CongestionControl *cc, uint32_t srtt,
+		      uint32_t rto)
+{
+	// the next round, once the current one was sent
+	uint64_t next = 0;
+	if (cc->cwnd < cc->limit && cc->round_sent >= cc->cwnd)
+	{
+		next = cc->round_start + round_length(srtt, rto);
+	}
+
+	// the timer tick the next paced block is due by
+	if (pacing_interval(cc, srtt) > 0 &&
+	    cc->paced > next + PACING_TICK_US)
+	{
+		next = cc->paced - PACING_TICK_US;
+	}
+
+	return next;
+}
+
+int cc_loss(CongestionControl *cc, uint64_t acked, uint64_t sent,
+	    uint32_t age, uint32_t srtt, uint32_t min_rtt)
+{
+	// the blocks lost with the same window were already accounted
+	if (!cc_enabled || acked <= cc->recover)
+	{
+		return 0;
+	}
+	cc->recover = sent;
+	cc->losses++;
+
+	// the client reported the gap on the blocks following the missing
+	// one, and no queue builds up at the bottleneck: the block was not
+	// dropped by a congested link
+	if (srtt > 0 && age <= 2 * srtt &&
+	    srtt <= min_rtt + min_rtt / QUEUE_DELAY_SHARE)
+	{
+		cc->random++;
+		trace(cc, "random loss", sent);
+		return 1;
+	}
+
+	cc->ssthresh = cc->cwnd / 2 > SSTHRESH_MIN ? cc->cwnd / 2 :
+		       SSTHRESH_MIN;
+	cc->cwnd = cc->ssthresh < cc->limit ? cc->ssthresh : cc->limit;
+	cc->growth = 0;
+	cc->round_lost = 1;
+	trace(cc, "loss", sent);
+
+	return 1;
+}
+
+void cc_timeout(CongestionControl *cc, uint64_t acked, uint64_t sent,
+		uint32_t srtt, uint32_t min_rtt)
+{
+	if (!cc_enabled)
+	{
+		return;
+	}
+	cc->timeouts++;
+
+	// the first timeout of a window with no queue at the bottleneck lost
+	// its last blocks at random: the window is sent again as it was
+	int repeated = acked == cc->timed_out;
+	cc->timed_out = acked;
+	if (!repeated && srtt > 0 &&
+	    srtt <= min_rtt + min_rtt / QUEUE_DELAY_SHARE)
+	{
+		cc->recover = sent;
+		cc->random_timeouts++;
+		cc->round_start = 0;
+		cc->round_sent = 0;
+		cc->round_lost = 1;
+		trace(cc, "random timeout", sent);
+		return;
+	}
+
+	// consecutive timeouts of the same window halve the threshold once,
+	// the window before the first one is restored if it was spurious
+	if (acked >= cc->recover)
+	{
+		cc->undo_cwnd = cc->cwnd;
+		cc->undo_ssthresh = cc->ssthresh;
+		cc->ssthresh = cc->cwnd / 2 > SSTHRESH_MIN ? cc->cwnd / 2 :
+			       SSTHRESH_MIN;
+		cc->recover = sent;
+	}
+	cc->cwnd = 1;
+	cc->growth = 0;
+
+	// the window is sent again from its first block right away
+	cc->round_start = 0;
+	cc->round_sent = 0;
+	cc->round_lost = 1;
+	trace(cc, "timeout", sent);
+}
+
+int cc_ack(CongestionControl *cc, uint64_t acked, uint64_t resent)
+{
+	// only the first ACK following a timeout tells
+	if (cc->undo_cwnd == 0)
+	{
+		return 0;
+	}
+	int undo = cc->undo_cwnd;
+	cc->undo_cwnd = 0;
+
+	// the blocks sent before the timeout were all delivered, not only the
+	// ones sent again: they were late, not lost
+	if (acked < cc->recover || acked <= resent)
+	{
+		return 0;
+	}
+	cc->cwnd = undo;
+	cc->ssthresh = cc->undo_ssthresh;
+	cc->spurious++;
+	trace(cc, "spurious timeout", acked);
+
+	return 1;
+}
+
+void cc_print_stats(const CongestionControl *cc,
+		    void (*log)(LogType, const char *))
+{
+	sprintf(log_message, "Congestion window of %s: cwnd %d, ssthresh %d, "
+		"max %d of %d blocks, %llu rounds, %llu losses (%llu random), "
+		"%llu timeouts (%llu random, %llu spurious).", cc->name, cc->cwnd,
+		cc->ssthresh, cc->max_cwnd, cc->limit,
+		(unsigned long long)cc->rounds, (unsigned long long)cc->losses,
+		(unsigned long long)cc->random,
+		(unsigned long long)cc->timeouts,
+		(unsigned long long)cc->random_timeouts,
+		(unsigned long long)cc->spurious);
+	log(INFO, log_message);
+}
+
+static uint32_t round_length(uint32_t srtt, uint32_t rto)
+{
+	return srtt > 0 ? srtt : rto;
+}
+
+static uint32_t pacing_interval(const CongestionControl *cc, uint32_t srtt)
+{
+	if (!cc_enabled)
+	{
+		return 0;
+	}
+
+	return srtt / (PACING_GAIN * cc->cwnd);
+}
+
+static int opened_window(const CongestionControl *cc, int blocks)
+{
+	int cwnd = cc->cwnd;
+	if (cwnd < cc->ssthresh)
+	{
+		// slow start: one more block for each block delivered, at most
+		// doubling each round (RFC 3465)
+		cwnd += blocks < cwnd ? blocks : cwnd;
+		if (cwnd > cc->ssthresh)
+		{
+			cwnd = cc->ssthresh;
+		}
+	}
+	else if (cc->growth + blocks >= cwnd)
+	{
+		// congestion avoidance: one more block for each window
+		// delivered
+		cwnd++;
+	}
+
+	return cwnd < cc->limit ? cwnd : cc->limit;
+}
+
+static void grow(CongestionControl *cc, int blocks, uint64_t sent)
+{
+	if (!cc_enabled || cc->cwnd >= cc->limit)
+	{
+		return;
+	}
+
+	if (cc->cwnd < cc->ssthresh)
+	{
+		cc->cwnd = opened_window(cc, blocks);
+		trace(cc, "slow start", sent);
+	}
+	else
+	{
+		int cwnd = opened_window(cc, blocks);
+		cc->growth += blocks;
+		if (cwnd == cc->cwnd)
+		{
+			return;
+		}
+		cc->growth -= cc->cwnd;
+		cc->cwnd = cwnd;
+		trace(cc, "congestion avoidance", sent);
+	}
+
+	if (cc->cwnd > cc->max_cwnd)
+	{
+		cc->max_cwnd = cc->cwnd;
+	}
+}
+
+static void trace(const CongestionControl *cc, const char *event,
+		  uint64_t block)
+{
+	if (!cc_trace)
+	{
+		return;
+	}
+
+	sprintf(log_message, "cwnd of %s: %s at %.3f ms, block %llu, cwnd %d, "
+		"ssthresh %d.", cc->name, event,
+		(get_time_us() - cc->started) / 1000.0,
+		(unsigned long long)block, cc->cwnd, cc->ssthresh);
+	print_log(INFO, log_message);
+}
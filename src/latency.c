@@ -0,0 +1,171 @@
+/**
+ * File: latency.c
+ *       Request Latency Histogram Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <sys/mman.h>
+
+#include "../include/latency.h"
+
+/**
+ * Histogram shared with the child processes, NULL if not created.
+ */
+static LatencyHistogram *histogram = NULL;
+
+/**
+ * Returns the bucket of the given latency.
+ *
+ * @param  us  the latency (us).
+ *
+ * @return  the bucket index.
+ */
+static int bucket_of(uint64_t us);
+
+/**
+ * Returns the largest latency falling in the given bucket.
+ *
+ * @param  bucket  the bucket index.
+ *
+ * @return  the bucket upper bound (us).
+ */
+static uint64_t bucket_limit(int bucket);
+
+/**
+ * Returns the given percentile of the recorded latencies.
+ *
+ * @param  percent  the percentile (0-100).
+ *
+ * @return  the upper bound of the bucket holding the percentile (us).
+ */
+static uint64_t percentile(double percent);
+
+void latency_init()
+{
+	// a new histogram for each listener process
+	if (histogram != NULL)
+	{
+		munmap(histogram, sizeof(LatencyHistogram));
+		histogram = NULL;
+	}
+
+	void *map = mmap(NULL, sizeof(LatencyHistogram), PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+	{
+		print_log(ERROR, "Unable to map the latency histogram.");
+		return;
+	}
+	histogram = map;
+}
+
+void latency_record(uint64_t us)
+{
+	if (histogram == NULL)
+	{
+		return;
+	}
+
+	__atomic_fetch_add(&histogram->counts[bucket_of(us)], 1,
+			   __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->samples, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->total, us, __ATOMIC_RELAXED);
+
+	// raise the maximum unless another process raised it further
+	uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+	while (us > max &&
+	       !__atomic_compare_exchange_n(&histogram->max, &max, us, 0,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+	}
+}
+
+void latency_print_stats(void (*log)(LogType, const char *))
+{
+	if (histogram == NULL)
+	{
+		return;
+	}
+
+	uint64_t samples = __atomic_load_n(&histogram->samples,
+					   __ATOMIC_RELAXED);
+	uint64_t total = __atomic_load_n(&histogram->total, __ATOMIC_RELAXED);
+
+	sprintf(log_message, "RRQ to first response latency: %llu samples, "
+		"avg %.1f us, p50 %llu us, p90 %llu us, p99 %llu us, max %llu "
+		"us.", (unsigned long long)samples,
+		samples > 0 ? (double)total / samples : 0.0,
+		(unsigned long long)percentile(50),
+		(unsigned long long)percentile(90),
+		(unsigned long long)percentile(99),
+		(unsigned long long)__atomic_load_n(&histogram->max,
+						    __ATOMIC_RELAXED));
+	log(INFO, log_message);
+}
+
+static int bucket_of(uint64_t us)
+{
+	// one bucket per value below 4 us
+	if (us < 4)
+	{
+		return us;
+	}
+
+	// power of two and its quarter
+	int exp = 63 - __builtin_clzll(us);
+	int quarter = (us >> (exp - 2)) & 3;
+	int bucket = 4 * (exp - 1) + quarter;
+
+	return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+static uint64_t bucket_limit(int bucket)
+{
+	if (bucket < 4)
+	{
+		return bucket;
+	}
+
+	int exp = bucket / 4 + 1;
+	int quarter = bucket % 4;
+
+	return ((uint64_t)(5 + quarter) << (exp - 2)) - 1;
+}
+
+static uint64_t percentile(double percent)
+{
+	// snapshot of the counters, still updated by the transfers
+	uint64_t counts[LATENCY_BUCKETS];
+	uint64_t samples = 0;
+	int i;
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		counts[i] = __atomic_load_n(&histogram->counts[i],
+					    __ATOMIC_RELAXED);
+		samples += counts[i];
+	}
+	if (samples == 0)
+	{
+		return 0;
+	}
+
+	// first bucket reaching the rank of the percentile
+	uint64_t rank = (uint64_t)(percent / 100.0 * samples + 0.5);
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			return bucket_limit(i);
+		}
+	}
+
+	return bucket_limit(LATENCY_BUCKETS - 1);
+}
@@ -0,0 +1,631 @@
+/**
+ * File: meta_cache.c
+ *       File Metadata Cache Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "../include/meta_cache.h"
+
+MetaCache meta_cache = { .dir_fd = -1, .inotify_fd = -1, .base_wd = -1 };
+
+/**
+ * Events invalidating a cached file or its directory.
+ */
+#define META_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | \
+		     IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_DELETE_SELF | \
+		     IN_MOVE_SELF)
+
+/**
+ * Base directory path, used to watch its subdirectories.
+ */
+static const char *base_path;
+
+/**
+ * Computes the hash of the given file name (FNV-1a).
+ *
+ * @param  name  file name.
+ *
+ * @return  the hash.
+ */
+static uint32_t hash_name(const char *name);
+
+/**
+ * Checks that the given name can not resolve outside of the base directory:
+ * absolute names and ".." components are refused.
+ *
+ * @param  name  file name relative to the base directory.
+ *
+ * @return  1 if the name is valid, 0 otherwise.
+ */
+static int valid_name(const char *name);
+
+/**
+ * Drains the pending inotify events, closing the files they refer to.
+ */
+static void sync_events();
+
+/**
+ * Watches the directory holding the given file or, if it does not exist, its
+ * deepest existing parent directory, and all of its parent directories up to
+ * the base directory: renaming any of them changes what the name resolves to.
+ * The returned watch is referenced once, to be released with release_watch().
+ *
+ * @param  name  file name relative to the base directory.
+ *
+ * @return  the watch descriptor of the deepest directory or -1 in case of
+ *          error.
+ */
+static int watch_directory(const char *name);
+
+/**
+ * Finds the given watched subdirectory.
+ *
+ * @param  wd  watch descriptor.
+ *
+ * @return  the watched subdirectory, NULL if the watch is not counted.
+ */
+static MetaWatch *find_watch(int wd);
+
+/**
+ * Drops a reference to the given watch, removing the watches left unused up
+ * to the base directory.
+ *
+ * @param  wd  watch descriptor, the base directory watch is never removed.
+ */
+static void release_watch(int wd);
+
+/**
+ * Closes the file of the given entry and empties it.
+ *
+ * @param  entry  the entry.
+ */
+static void close_entry(MetaEntry *entry);
+
+/**
+ * Closes all the cached files.
+ */
+static void flush_entries();
+
+/**
+ * Finds a free entry, closing an unused file with the CLOCK algorithm if all
+ * the entries are in use.
+ *
+ * @return  the free entry.
+ */
+static MetaEntry *free_entry();
+
+/**
+ * Remembers the given name as missing, replacing the name having the same
+ * slot. The name takes over the given watch reference.
+ *
+ * @param  name  file name relative to the base directory;
+ * @param  hash  hash of the file name;
+ * @param  wd    watch of the deepest existing directory of the name.
+ */
+static void remember_missing(const char *name, uint32_t hash, int wd);
+
+/**
+ * Forgets all the missing names, some of them may now exist.
+ */
+static void forget_missing();
+
+int meta_init(const char *base_dir)
+{
+	// the base directory is held open for the whole process lifetime
+	base_path = base_dir;
+	meta_cache.dir_fd = open(base_dir, O_RDONLY | O_DIRECTORY);
+	if (meta_cache.dir_fd < 0)
+	{
+		return -1;
+	}
+
+	// without inotify, files are opened on every lookup
+	meta_cache.inotify_fd = inotify_init1(IN_NONBLOCK);
+	if (meta_cache.inotify_fd >= 0)
+	{
+		meta_cache.base_wd = inotify_add_watch(meta_cache.inotify_fd,
+						       base_dir, META_EVENTS);
+	}
+	if (meta_cache.inotify_fd >= 0 && meta_cache.base_wd < 0)
+	{
+		close(meta_cache.inotify_fd);
+		meta_cache.inotify_fd = -1;
+	}
+	if (meta_cache.inotify_fd < 0)
+	{
+		print_log(ERROR, "Unable to watch the base directory, the "
+			  "metadata cache is disabled.");
+	}
+
+	return 0;
+}
+
+void meta_detach()
+{
+	// the events belong to the parent process
+	if (meta_cache.inotify_fd >= 0)
+	{
+		close(meta_cache.inotify_fd);
+		meta_cache.inotify_fd = -1;
+	}
+}
+
+void meta_flush()
+{
+	flush_entries();
+}
+
+int meta_missing(const char *name)
+{
+	// without inotify missing names could appear unnoticed
+	if (meta_cache.inotify_fd < 0)
+	{
+		return 0;
+	}
+
+	// apply the changes made so far
+	sync_events();
+
+	// a single slot to check
+	if (meta_cache.missing_count == 0)
+	{
+		return 0;
+	}
+	uint32_t hash = hash_name(name);
+	const MissingEntry *entry = &meta_cache.missing[hash &
+							(META_MISSING - 1)];
+	if (entry->hash == hash && strcmp(entry->name, name) == 0)
+	{
+		meta_cache.stats.rejects++;
+		return 1;
+	}
+
+	return 0;
+}
+
+int meta_open(const char *name, struct stat *st)
+{
+	// the name must resolve within the base directory
+	if (!valid_name(name))
+	{
+		errno = EACCES;
+		return -1;
+	}
+
+	// names known to be missing, changes made so far applied
+	if (meta_missing(name))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	// HIT: hand out a new descriptor of the open file
+	uint32_t hash = hash_name(name);
+	int i;
+	for (i = 0; i < META_ENTRIES; i++)
+	{
+		MetaEntry *entry = &meta_cache.entries[i];
+		if (entry->name != NULL && entry->hash == hash &&
+		    strcmp(entry->name, name) == 0)
+		{
+			meta_cache.stats.hits++;
+			entry->referenced = 1;
+			memset(st, 0, sizeof(struct stat));
+			st->st_mode = S_IFREG;
+			st->st_dev = entry->dev;
+			st->st_ino = entry->ino;
+			st->st_size = entry->size;
+			st->st_mtim = entry->mtime;
+			return dup(entry->fd);
+		}
+	}
+	meta_cache.stats.misses++;
+
+	// watch the directory before opening the file, so that no change
+	// is missed, nor the creation of a missing file
+	int wd = -1;
+	if (meta_cache.inotify_fd >= 0)
+	{
+		wd = watch_directory(name);
+	}
+
+	// resolve the name relative to the base directory
+	int fd = openat(meta_cache.dir_fd, name, O_RDONLY);
+	if (fd < 0)
+	{
+		if ((errno == ENOENT || errno == ENOTDIR) && wd >= 0)
+		{
+			remember_missing(name, hash, wd);
+			errno = ENOENT;
+			return -1;
+		}
+		int error = errno;
+		release_watch(wd);
+		errno = error;
+		return -1;
+	}
+	if (fstat(fd, st) < 0)
+	{
+		int error = errno;
+		close(fd);
+		release_watch(wd);
+		errno = error;
+		return -1;
+	}
+	if (!S_ISREG(st->st_mode))
+	{
+		close(fd);
+		release_watch(wd);
+		errno = EISDIR;
+		return -1;
+	}
+
+	// keep the file open while its directory is watched
+	if (wd < 0)
+	{
+		return fd;
+	}
+	MetaEntry *entry = free_entry();
+	entry->name = strdup(name);
+	if (entry->name == NULL)
+	{
+		release_watch(wd);
+		return fd;
+	}
+	const char *slash = strrchr(entry->name, '/');
+	entry->base = slash != NULL ? slash + 1 : entry->name;
+	entry->hash = hash;
+	entry->fd = fd;
+	entry->wd = wd;
+	entry->dev = st->st_dev;
+	entry->ino = st->st_ino;
+	entry->size = st->st_size;
+	entry->mtime = st->st_mtim;
+	entry->referenced = 1;
+	meta_cache.count++;
+
+	return dup(fd);
+}
+
+void meta_print_stats(void (*log)(LogType, const char *))
+{
+	const MetaStats *stats = &meta_cache.stats;
+	uint64_t lookups = stats->hits + stats->misses;
+
+	sprintf(log_message, "Metadata cache: %d open files, %d watched "
+		"subdirectories, %llu hits, %llu misses (%.1f%% hit rate), "
+		"%llu evictions, %llu invalidations, %llu flushes.",
+		meta_cache.count, meta_cache.watch_count,
+		(unsigned long long)stats->hits,
+		(unsigned long long)stats->misses,
+		lookups > 0 ? 100.0 * stats->hits / lookups : 0.0,
+		(unsigned long long)stats->evictions,
+		(unsigned long long)stats->invalidations,
+		(unsigned long long)stats->flushes);
+	log(INFO, log_message);
+
+	sprintf(log_message, "Missing names: %d remembered, %llu requests "
+		"rejected, %llu tables cleared.", meta_cache.missing_count,
+		(unsigned long long)stats->rejects,
+		(unsigned long long)stats->forgets);
+	log(INFO, log_message);
+}
+
+static uint32_t hash_name(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	const unsigned char *p;
+	for (p = (const unsigned char *)name; *p != '\0'; p++)
+	{
+		hash ^= *p;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static int valid_name(const char *name)
+{
+	if (name[0] == '\0' || name[0] == '/')
+	{
+		return 0;
+	}
+
+	// look for a ".." component
+	const char *p = name;
+	while (p != NULL)
+	{
+		if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0'))
+		{
+			return 0;
+		}
+		p = strchr(p, '/');
+		if (p != NULL)
+		{
+			p++;
+		}
+	}
+
+	return 1;
+}
+
+static void sync_events()
+{
+	// events buffer, aligned as the events it holds
+	char buffer[4096]
+	    __attribute__((aligned(__alignof__(struct inotify_event))));
+
+	while (1)
+	{
+		ssize_t len = read(meta_cache.inotify_fd, buffer,
+				   sizeof(buffer));
+
+		// no more pending events
+		if (len <= 0)
+		{
+			return;
+		}
+
+		char *p;
+		for (p = buffer; p < buffer + len;
+		     p += sizeof(struct inotify_event) +
+			  ((struct inotify_event *)p)->len)
+		{
+			const struct inotify_event *ev =
+				(const struct inotify_event *)p;
+
+			// watches removed once unused are ignored
+			if ((ev->mask & IN_IGNORED) &&
+			    ev->wd != meta_cache.base_wd &&
+			    find_watch(ev->wd) == NULL)
+			{
+				continue;
+			}
+
+			// events were lost, or file names may now resolve to
+			// other files: nothing can be trusted anymore
+			if (ev->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_ISDIR |
+					IN_DELETE_SELF | IN_MOVE_SELF))
+			{
+				flush_entries();
+				continue;
+			}
+
+			// a missing name may have been created
+			if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+			{
+				forget_missing();
+			}
+
+			// close the file the event refers to
+			if (ev->len == 0)
+			{
+				continue;
+			}
+			int i;
+			for (i = 0; i < META_ENTRIES; i++)
+			{
+				MetaEntry *entry = &meta_cache.entries[i];
+				if (entry->name != NULL &&
+				    entry->wd == ev->wd &&
+				    strcmp(entry->base, ev->name) == 0)
+				{
+					meta_cache.stats.invalidations++;
+					close_entry(entry);
+				}
+			}
+		}
+	}
+}
+
+static int watch_directory(const char *name)
+{
+	// full path of the file
+	char path[4096];
+	size_t base_len = strlen(base_path);
+	if (snprintf(path, sizeof(path), "%s/%s", base_path, name) >=
+	    (int)sizeof(path))
+	{
+		return -1;
+	}
+
+	// strip the last path component until an existing directory is found,
+	// then watch its parents as well until a counted watch is found: each
+	// new watch references its parent, the deepest one is referenced by
+	// the caller
+	int deepest = -1;
+	MetaWatch *child = NULL;
+	char *slash;
+	while ((slash = strrchr(path + base_len, '/')) != NULL)
+	{
+		*slash = '\0';
+		int wd = inotify_add_watch(meta_cache.inotify_fd, path,
+					   META_EVENTS | IN_ONLYDIR);
+		if (wd < 0 && (errno == ENOENT || errno == ENOTDIR))
+		{
+			continue;
+		}
+		if (wd < 0)
+		{
+			release_watch(deepest);
+			return -1;
+		}
+		if (deepest < 0)
+		{
+			deepest = wd;
+		}
+		if (child != NULL)
+		{
+			child->parent = wd;
+		}
+
+		// the base directory is watched for the whole process lifetime
+		if (wd == meta_cache.base_wd)
+		{
+			return deepest;
+		}
+
+		// an already watched directory holds its parents
+		MetaWatch *watch = find_watch(wd);
+		if (watch != NULL)
+		{
+			watch->refs++;
+			return deepest;
+		}
+
+		// count the new watch, unless too many directories are watched
+		if (meta_cache.watch_count == META_WATCHES)
+		{
+			inotify_rm_watch(meta_cache.inotify_fd, wd);
+			release_watch(deepest);
+			return -1;
+		}
+		child = &meta_cache.watches[meta_cache.watch_count++];
+		child->wd = wd;
+		child->parent = -1;
+		child->refs = 1;
+	}
+
+	return deepest;
+}
+
+static MetaWatch *find_watch(int wd)
+{
+	int i;
+	for (i = 0; i < meta_cache.watch_count; i++)
+	{
+		if (meta_cache.watches[i].wd == wd)
+		{
+			return &meta_cache.watches[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void release_watch(int wd)
+{
+	while (wd >= 0 && wd != meta_cache.base_wd)
+	{
+		MetaWatch *watch = find_watch(wd);
+		if (watch == NULL || --watch->refs > 0)
+		{
+			return;
+		}
+
+		// the watch is no longer needed: its parent loses a reference
+		int parent = watch->parent;
+		*watch = meta_cache.watches[--meta_cache.watch_count];
+		if (meta_cache.inotify_fd >= 0)
+		{
+			inotify_rm_watch(meta_cache.inotify_fd, wd);
+		}
+		wd = parent;
+	}
+}
+
+static void close_entry(MetaEntry *entry)
+{
+	close(entry->fd);
+	release_watch(entry->wd);
+	free(entry->name);
+	memset(entry, 0, sizeof(MetaEntry));
+	meta_cache.count--;
+}
+
+static void flush_entries()
+{
+	meta_cache.stats.flushes++;
+	forget_missing();
+
+	int i;
+	for (i = 0; i < META_ENTRIES; i++)
+	{
+		if (meta_cache.entries[i].name != NULL)
+		{
+			close_entry(&meta_cache.entries[i]);
+		}
+	}
+}
+
+static MetaEntry *free_entry()
+{
+	while (1)
+	{
+		MetaEntry *entry = &meta_cache.entries[meta_cache.hand];
+		meta_cache.hand = (meta_cache.hand + 1) % META_ENTRIES;
+
+		// empty entry
+		if (entry->name == NULL)
+		{
+			return entry;
+		}
+
+		// second chance for the files used since the last pass
+		if (entry->referenced)
+		{
+			entry->referenced = 0;
+			continue;
+		}
+
+		meta_cache.stats.evictions++;
+		close_entry(entry);
+		return entry;
+	}
+}
+
+static void remember_missing(const char *name, uint32_t hash, int wd)
+{
+	// empty names mark empty entries, longer names can not be requested
+	if (name[0] == '\0' || strlen(name) >= META_NAME_LEN)
+	{
+		release_watch(wd);
+		return;
+	}
+
+	MissingEntry *entry = &meta_cache.missing[hash & (META_MISSING - 1)];
+	if (entry->name[0] == '\0')
+	{
+		meta_cache.missing_count++;
+	}
+	else
+	{
+		release_watch(entry->wd);
+	}
+	entry->hash = hash;
+	entry->wd = wd;
+	strcpy(entry->name, name);
+}
+
+static void forget_missing()
+{
+	// nothing to clear
+	if (meta_cache.missing_count == 0)
+	{
+		return;
+	}
+
+	meta_cache.stats.forgets++;
+
+	int i;
+	for (i = 0; i < META_MISSING; i++)
+	{
+		if (meta_cache.missing[i].name[0] != '\0')
+		{
+			release_watch(meta_cache.missing[i].wd);
+			meta_cache.missing[i].name[0] = '\0';
+		}
+	}
+	meta_cache.missing_count = 0;
+}
@@ -0,0 +1,332 @@
+/**
+ * File: netascii.c
+ *       Netascii Conversion Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "../include/netascii.h"
+
+/**
+ * Scans the given buffer one byte at a time.
+ *
+ * @param  buf  buffer to be scanned;
+ * @param  len  buffer length;
+ * @param  a    first character looked for;
+ * @param  b    second character looked for.
+ *
+ * @return  the index of the first matching byte, len if none matches.
+ */
+static size_t scan_scalar(const char *buf, size_t len, char a, char b)
+{
+	size_t i;
+	for (i = 0; i < len; i++)
+	{
+		if (buf[i] == a || buf[i] == b)
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * Scans the given buffer 16 bytes at a time using SSE2.
+ *
+ * @param  buf  buffer to be scanned;
+ * @param  len  buffer length;
+ * @param  a    first character looked for;
+ * @param  b    second character looked for.
+ *
+ * @return  the index of the first matching byte, len if none matches.
+ */
+__attribute__((target("sse2")))
+static size_t scan_sse2(const char *buf, size_t len, char a, char b)
+{
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		// compare 16 bytes against both characters at once
+		__m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+		__m128i eq = _mm_or_si128(_mm_cmpeq_epi8(v, va),
+					  _mm_cmpeq_epi8(v, vb));
+
+		// one bit per matching byte
+		int mask = _mm_movemask_epi8(eq);
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	// scan the tail shorter than a vector
+	return i + scan_scalar(buf + i, len - i, a, b);
+}
+
+/**
+ * Scans the given buffer 32 bytes at a time using AVX2.
+ *
+ * @param  buf  buffer to be scanned;
+ * @param  len  buffer length;
+ * @param  a    first character looked for;
+ * @param  b    second character looked for.
+ *
+ * @return  the index of the first matching byte, len if none matches.
+ */
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char *buf, size_t len, char a, char b)
+{
+	const __m256i va = _mm256_set1_epi8(a);
+	const __m256i vb = _mm256_set1_epi8(b);
+
+	size_t i = 0;
+	for (; i + 32 <= len; i += 32)
+	{
+		// compare 32 bytes against both characters at once
+		__m256i v = _mm256_loadu_si256((const __m256i *)(buf + i));
+		__m256i eq = _mm256_or_si256(_mm256_cmpeq_epi8(v, va),
+					     _mm256_cmpeq_epi8(v, vb));
+
+		// one bit per matching byte
+		unsigned int mask = _mm256_movemask_epi8(eq);
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	// scan the tail shorter than a vector
+	return i + scan_sse2(buf + i, len - i, a, b);
+}
+
+#endif
+
+/**
+ * Scanner used by netascii_scan(), selected on first use.
+ */
+static size_t (*scan)(const char *, size_t, char, char) = NULL;
+
+int netascii_select_scanner(NetasciiScanner scanner)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	int avx2 = __builtin_cpu_supports("avx2");
+	int sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+	switch (scanner) {
+	case SCAN_SCALAR:
+		{
+			scan = scan_scalar;
+			return 0;
+		}
+
+#if defined(__x86_64__) || defined(__i386__)
+	case SCAN_SSE2:
+		{
+			if (!sse2)
+			{
+				return -1;
+			}
+			scan = scan_sse2;
+			return 0;
+		}
+
+	case SCAN_AVX2:
+		{
+			if (!avx2)
+			{
+				return -1;
+			}
+			scan = scan_avx2;
+			return 0;
+		}
+
+	case SCAN_AUTO:
+		{
+			scan = avx2 ? scan_avx2 : sse2 ? scan_sse2 :
+			       scan_scalar;
+			return 0;
+		}
+#else
+	case SCAN_AUTO:
+		{
+			scan = scan_scalar;
+			return 0;
+		}
+#endif
+
+	default:
+		{
+			return -1;
+		}
+	}
+}
+
+size_t netascii_scan(const char *buf, size_t len, char a, char b)
+{
+	// scanner selected for the running CPU
+	if (scan == NULL)
+	{
+		netascii_select_scanner(SCAN_AUTO);
+	}
+
+	return scan(buf, len, a, b);
+}
+
+void netascii_encoder_init(NetasciiEncoder *enc)
+{
+	enc->pending = 0;
+	enc->next = '\0';
+}
+
+size_t netascii_encode(NetasciiEncoder *enc, const char *in, size_t in_len,
+		       size_t *consumed, char *out, size_t out_len)
+{
+	// input and output positions
+	size_t i = 0;
+	size_t o = 0;
+
+	// complete the expansion split by the previous output end
+	if (enc->pending && o < out_len)
+	{
+		out[o++] = enc->next;
+		enc->pending = 0;
+	}
+
+	while (i < in_len && o < out_len)
+	{
+		// copy the run of bytes not to be expanded
+		size_t max = in_len - i < out_len - o ? in_len - i : out_len - o;
+		size_t run = netascii_scan(in + i, max, '\n', '\r');
+		memcpy(out + o, in + i, run);
+		i += run;
+		o += run;
+
+		// input consumed or output full
+		if (i == in_len || o == out_len)
+		{
+			break;
+		}
+
+		// LF becomes CR LF, CR becomes CR NUL
+		char next = in[i++] == '\n' ? '\n' : '\0';
+		out[o++] = '\r';
+
+		// the second byte is written by the next call if it does not fit
+		if (o < out_len)
+		{
+			out[o++] = next;
+		}
+		else
+		{
+			enc->pending = 1;
+			enc->next = next;
+		}
+	}
+
+	*consumed = i;
+
+	return o;
+}
+
+void netascii_decoder_init(NetasciiDecoder *dec)
+{
+	dec->cr = 0;
+}
+
+size_t netascii_decode(NetasciiDecoder *dec, const char *in, size_t len,
+		       char *out)
+{
+	// input and output positions
+	size_t i = 0;
+	size_t o = 0;
+
+	// complete the pair split by the previous input end
+	if (dec->cr && len > 0)
+	{
+		dec->cr = 0;
+		if (in[0] == '\n')
+		{
+			out[o++] = '\n';
+			i++;
+		}
+		else if (in[0] == '\0')
+		{
+			out[o++] = '\r';
+			i++;
+		}
+		else
+		{
+			out[o++] = '\r';
+		}
+	}
+
+	while (i < len)
+	{
+		// copy the run of bytes up to the next CR
+		size_t run = netascii_scan(in + i, len - i, '\r', '\r');
+		memcpy(out + o, in + i, run);
+		i += run;
+		o += run;
+
+		// input consumed
+		if (i == len)
+		{
+			break;
+		}
+
+		// the CR ends the input: decoded with the next call
+		if (i + 1 == len)
+		{
+			dec->cr = 1;
+			i++;
+			break;
+		}
+
+		// CR LF becomes LF, CR NUL becomes CR
+		if (in[i + 1] == '\n')
+		{
+			out[o++] = '\n';
+			i += 2;
+		}
+		else if (in[i + 1] == '\0')
+		{
+			out[o++] = '\r';
+			i += 2;
+		}
+		else
+		{
+			out[o++] = '\r';
+			i++;
+		}
+	}
+
+	return o;
+}
+
+size_t netascii_decode_end(NetasciiDecoder *dec, char *out)
+{
+	// a stray CR at the end of the stream is kept as is
+	if (dec->cr)
+	{
+		dec->cr = 0;
+		out[0] = '\r';
+		return 1;
+	}
+
+	return 0;
+}
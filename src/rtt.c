@@ -0,0 +1,116 @@
+/**
+ * File: rtt.c
+ *       Round Trip Time Estimator Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include "../include/rtt.h"
+
+/**
+ * Clock granularity (G) in microseconds: deadlines are checked in milliseconds.
+ */
+#define CLOCK_GRANULARITY_US 1000
+
+void rtt_init(RttEstimator *rtt)
+{
+	rtt->srtt = 0;
+	rtt->rttvar = 0;
+	rtt->rto = RTO_INITIAL_US;
+	rtt->min_rtt = 0;
+	rtt->max_rtt = 0;
+	rtt->samples = 0;
+	rtt->timeouts = 0;
+	rtt->stalled = 0;
+}
+
+void rtt_sample(RttEstimator *rtt, uint32_t sample)
+{
+	if (rtt->samples == 0)
+	{
+		// first sample: SRTT = R, RTTVAR = R / 2
+		rtt->srtt = sample;
+		rtt->rttvar = sample / 2;
+		rtt->min_rtt = sample;
+		rtt->max_rtt = sample;
+	}
+	else
+	{
+		// RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|
+		uint32_t delta = rtt->srtt > sample ? rtt->srtt - sample :
+				 sample - rtt->srtt;
+		rtt->rttvar = rtt->rttvar - rtt->rttvar / 4 + delta / 4;
+
+		// SRTT = 7/8 SRTT + 1/8 R
+		rtt->srtt = rtt->srtt - rtt->srtt / 8 + sample / 8;
+
+		if (sample < rtt->min_rtt)
+		{
+			rtt->min_rtt = sample;
+		}
+		if (sample > rtt->max_rtt)
+		{
+			rtt->max_rtt = sample;
+		}
+	}
+	rtt->samples++;
+
+	// RTO = SRTT + max(G, 4 RTTVAR), the backoff is cleared
+	uint32_t var = 4 * rtt->rttvar;
+	rtt->rto = rtt->srtt + (var > CLOCK_GRANULARITY_US ?
+				var : CLOCK_GRANULARITY_US);
+
+	// keep the timeout within its bounds
+	if (rtt->rto < RTO_MIN_US)
+	{
+		rtt->rto = RTO_MIN_US;
+	}
+	if (rtt->rto > RTO_MAX_US)
+	{
+		rtt->rto = RTO_MAX_US;
+	}
+}
+
+int rtt_backoff(RttEstimator *rtt)
+{
+	// the retry budget starts with the first timeout since the last progress
+	uint64_t now = get_time_ms();
+	if (rtt->stalled == 0)
+	{
+		rtt->stalled = now;
+	}
+	else if (now - rtt->stalled >= RETRY_BUDGET_MS)
+	{
+		return -1;
+	}
+
+	rtt->timeouts++;
+
+	// double the timeout up to the upper bound
+	rtt->rto = rtt->rto < RTO_MAX_US / 2 ? rtt->rto * 2 : RTO_MAX_US;
+
+	return 0;
+}
+
+void rtt_progress(RttEstimator *rtt)
+{
+	rtt->stalled = 0;
+}
+
+uint32_t rtt_timeout_ms(const RttEstimator *rtt)
+{
+	return (rtt->rto + 999) / 1000;
+}
+
+void rtt_print_stats(const RttEstimator *rtt, const char *name,
+		     void (*log)(LogType, const char *))
+{
+	sprintf(log_message, "RTT of %s: %llu samples, srtt %.2f ms, rttvar "
+		"%.2f ms, min %.2f ms, max %.2f ms, rto %.2f ms, %llu "
+		"timeouts.", name, (unsigned long long)rtt->samples,
+		rtt->srtt / 1000.0, rtt->rttvar / 1000.0, rtt->min_rtt / 1000.0,
+		rtt->max_rtt / 1000.0, rtt->rto / 1000.0,
+		(unsigned long long)rtt->timeouts);
+	log(INFO, log_message);
+}
@@ -0,0 +1,291 @@
+/**
+ * File: session_table.c
+ *       Session Table Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/session_table.h"
+
+/**
+ * Computes the hash of the given key (FNV-1a).
+ *
+ * @param  ip         client IP address;
+ * @param  port       client port;
+ * @param  file_name  requested file name.
+ *
+ * @return  the hash.
+ */
+static uint32_t hash_key(uint32_t ip, uint16_t port, const char *file_name);
+
+/**
+ * Finds the entry holding the given key, or the empty entry ending its probe
+ * sequence, updating the lookup statistics.
+ *
+ * @param  table      the table;
+ * @param  hash       hash of the key;
+ * @param  ip         client IP address;
+ * @param  port       client port;
+ * @param  file_name  requested file name.
+ *
+ * @return  the index of the entry found.
+ */
+static uint32_t find_entry(SessionTable *table, uint32_t hash, uint32_t ip,
+			   uint16_t port, const char *file_name);
+
+/**
+ * Removes the entry at the given index, moving back the following entries of
+ * the same probe sequences.
+ *
+ * @param  table  the table;
+ * @param  i      index of the entry.
+ */
+static void remove_entry(SessionTable *table, uint32_t i);
+
+/**
+ * Doubles the table size, moving all the entries.
+ *
+ * @param  table  the table.
+ *
+ * @return  0 on success, -1 if the allocation fails.
+ */
+static int grow(SessionTable *table);
+
+int table_init(SessionTable *table)
+{
+	memset(table, 0, sizeof(SessionTable));
+
+	table->entries = calloc(TABLE_INITIAL_SIZE, sizeof(TableEntry));
+	if (table->entries == NULL)
+	{
+		return -1;
+	}
+	table->size = TABLE_INITIAL_SIZE;
+
+	return 0;
+}
+
+void *table_lookup(SessionTable *table, const struct sockaddr_in *addr,
+		   const char *file_name)
+{
+	uint32_t ip = addr->sin_addr.s_addr;
+	uint16_t port = addr->sin_port;
+	uint32_t i = find_entry(table, hash_key(ip, port, file_name), ip, port,
+				file_name);
+
+	// the probe sequence ended on an empty entry
+	if (table->entries[i].file_name == NULL)
+	{
+		return NULL;
+	}
+
+	return table->entries[i].value;
+}
+
+void table_count_duplicate(SessionTable *table)
+{
+	table->stats.duplicates++;
+}
+
+int table_insert(SessionTable *table, const struct sockaddr_in *addr,
+		 const char *file_name, void *value)
+{
+	uint32_t ip = addr->sin_addr.s_addr;
+	uint16_t port = addr->sin_port;
+	uint32_t hash = hash_key(ip, port, file_name);
+	uint32_t i = find_entry(table, hash, ip, port, file_name);
+
+	// the key is already in the table: only its transfer is replaced
+	if (table->entries[i].file_name != NULL)
+	{
+		table->entries[i].value = value;
+		return 0;
+	}
+
+	// keep the load factor below 70% so that probe sequences stay short,
+	// growing the table moves the empty entry found
+	if ((uint64_t)(table->count + 1) * 10 > (uint64_t)table->size * 7)
+	{
+		if (grow(table) < 0)
+		{
+			return -1;
+		}
+		i = find_entry(table, hash, ip, port, file_name);
+	}
+
+	// the entry owns a copy of the file name
+	char *name = strdup(file_name);
+	if (name == NULL)
+	{
+		return -1;
+	}
+
+	TableEntry *entry = &table->entries[i];
+	entry->hash = hash;
+	entry->ip = ip;
+	entry->port = port;
+	entry->file_name = name;
+	entry->value = value;
+
+	table->count++;
+	if (table->count > table->stats.peak)
+	{
+		table->stats.peak = table->count;
+	}
+
+	return 0;
+}
+
+void table_remove(SessionTable *table, const struct sockaddr_in *addr,
+		  const char *file_name, void *value)
+{
+	uint32_t ip = addr->sin_addr.s_addr;
+	uint16_t port = addr->sin_port;
+	uint32_t i = find_entry(table, hash_key(ip, port, file_name), ip, port,
+				file_name);
+
+	// a retransmitted request may have replaced the transfer
+	if (table->entries[i].file_name != NULL &&
+	    table->entries[i].value == value)
+	{
+		remove_entry(table, i);
+	}
+}
+
+void table_print_stats(const SessionTable *table,
+		       void (*log)(LogType, const char *))
+{
+	const TableStats *stats = &table->stats;
+
+	sprintf(log_message, "Session table: %u/%u entries (%.1f%% occupancy, "
+		"peak %u), %llu lookups, %.2f probes per lookup, %llu "
+		"collisions, %llu duplicate requests, %llu resizes.",
+		table->count, table->size, 100.0 * table->count / table->size,
+		stats->peak, (unsigned long long)stats->lookups,
+		stats->lookups > 0 ? (double)stats->probes / stats->lookups :
+		0.0, (unsigned long long)stats->collisions,
+		(unsigned long long)stats->duplicates,
+		(unsigned long long)stats->resizes);
+	log(INFO, log_message);
+}
+
+static uint32_t hash_key(uint32_t ip, uint16_t port, const char *file_name)
+{
+	uint32_t hash = 2166136261u;
+	int i;
+
+	// client endpoint bytes
+	for (i = 0; i < 4; i++)
+	{
+		hash = (hash ^ ((ip >> (8 * i)) & 0xff)) * 16777619u;
+	}
+	hash = (hash ^ (port & 0xff)) * 16777619u;
+	hash = (hash ^ (port >> 8)) * 16777619u;
+
+	// file name bytes
+	while (*file_name != '\0')
+	{
+		hash = (hash ^ (unsigned char)*file_name++) * 16777619u;
+	}
+
+	return hash;
+}
+
+static uint32_t find_entry(SessionTable *table, uint32_t hash, uint32_t ip,
+			   uint16_t port, const char *file_name)
+{
+	uint32_t mask = table->size - 1;
+	uint32_t i = hash & mask;
+
+	table->stats.lookups++;
+
+	while (1)
+	{
+		TableEntry *entry = &table->entries[i];
+		table->stats.probes++;
+
+		// end of the probe sequence
+		if (entry->file_name == NULL)
+		{
+			return i;
+		}
+
+		// the file name is only compared when everything else matches
+		if (entry->hash == hash && entry->ip == ip &&
+		    entry->port == port && strcmp(entry->file_name, file_name) == 0)
+		{
+			return i;
+		}
+
+		table->stats.collisions++;
+		i = (i + 1) & mask;
+	}
+}
+
+static void remove_entry(SessionTable *table, uint32_t i)
+{
+	uint32_t mask = table->size - 1;
+
+	free(table->entries[i].file_name);
+	table->entries[i].file_name = NULL;
+	table->count--;
+
+	// move back the entries which would no longer be reachable
+	uint32_t j = i;
+	while (1)
+	{
+		j = (j + 1) & mask;
+		if (table->entries[j].file_name == NULL)
+		{
+			break;
+		}
+
+		// an entry can fill the hole if its home index does not lie in
+		// the cyclic interval (i, j]
+		uint32_t home = table->entries[j].hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			table->entries[i] = table->entries[j];
+			table->entries[j].file_name = NULL;
+			i = j;
+		}
+	}
+}
+
+static int grow(SessionTable *table)
+{
+	uint32_t size = table->size * 2;
+	TableEntry *entries = calloc(size, sizeof(TableEntry));
+	if (entries == NULL)
+	{
+		return -1;
+	}
+
+	// move the entries to their new home
+	uint32_t i;
+	for (i = 0; i < table->size; i++)
+	{
+		if (table->entries[i].file_name == NULL)
+		{
+			continue;
+		}
+
+		uint32_t j = table->entries[i].hash & (size - 1);
+		while (entries[j].file_name != NULL)
+		{
+			j = (j + 1) & (size - 1);
+		}
+		entries[j] = table->entries[i];
+	}
+
+	free(table->entries);
+	table->entries = entries;
+	table->size = size;
+	table->stats.resizes++;
+
+	return 0;
+}
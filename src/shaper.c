@@ -0,0 +1,439 @@
+/**
+ * File: shaper.c
+ *       Bandwidth Shaper Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "../include/shaper.h"
+
+Shaper shaper = {
+	.prefix = SHAPER_PREFIX,
+	.burst = SHAPER_BURST,
+	.quantum = SHAPER_QUANTUM
+};
+
+/**
+ * Adds the tokens earned since the last refill to the given bucket.
+ *
+ * @param  bucket  the bucket;
+ * @param  now     current time (us).
+ */
+static void refill(TokenBucket *bucket, uint64_t now);
+
+/**
+ * Returns the time needed by the given bucket to hold the given bytes.
+ *
+ * @param  bucket  the bucket;
+ * @param  bytes   the bytes to be sent.
+ *
+ * @return  the time (us), 0 if the bytes can be sent right away.
+ */
+static uint64_t wait_time(const TokenBucket *bucket, int64_t bytes);
+
+/**
+ * Takes a reference to the bucket of the given key, reusing the least recently
+ * refilled unused bucket if the key has none.
+ *
+ * @param  buckets  the client or subnet buckets;
+ * @param  key      client address or subnet;
+ * @param  rate     rate of a new bucket.
+ *
+ * @return  the bucket, NULL if all the buckets are in use.
+ */
+static SharedBucket *acquire_bucket(SharedBucket *buckets, uint32_t key,
+				    uint64_t rate);
+
+/**
+ * Appends the given flow to the scheduler queue.
+ *
+ * @param  flow  the flow.
+ */
+static void enqueue(Flow *flow);
+
+/**
+ * Removes the given flow from the scheduler queue.
+ *
+ * @param  flow  the flow.
+ */
+static void dequeue(Flow *flow);
+
+int shaper_enabled()
+{
+	return shaper.rate > 0 || shaper.client_rate > 0 ||
+	       shaper.subnet_rate > 0;
+}
+
+void shaper_init()
+{
+	// the global bucket starts full
+	shaper.global.rate = shaper.rate;
+	shaper.global.tokens = shaper.burst;
+	shaper.global.updated = get_time_us();
+}
+
+void shaper_add(Flow *flow, const struct sockaddr_in *addr, int packet_size,
+		void *data)
+{
+	memset(flow, 0, sizeof(Flow));
+	flow->packet_size = packet_size;
+	flow->data = data;
+
+	// clients sharing a subnet share its rate as well
+	uint32_t host = addr->sin_addr.s_addr;
+	if (shaper.subnet_rate > 0)
+	{
+		uint32_t mask = shaper.prefix > 0 ?
+				htonl(~0U << (32 - shaper.prefix)) : 0;
+		flow->subnet = acquire_bucket(shaper.subnets, host & mask,
+					      shaper.subnet_rate);
+	}
+	if (shaper.client_rate > 0)
+	{
+		flow->client = acquire_bucket(shaper.clients, host,
+					      shaper.client_rate);
+	}
+}
+
+void shaper_remove(Flow *flow)
+{
+	// uploads are not shaped
+	if (flow->data == NULL)
+	{
+		return;
+	}
+
+	if (flow->queued)
+	{
+		dequeue(flow);
+	}
+
+	// buckets are kept with their tokens until reused: a client starting
+	// a new transfer does not earn a new burst
+	if (flow->subnet != NULL)
+	{
+		flow->subnet->refs--;
+	}
+	if (flow->client != NULL)
+	{
+		flow->client->refs--;
+	}
+	flow->data = NULL;
+}
+
+void shaper_wake(Flow *flow)
+{
+	if (flow->queued)
+	{
+		return;
+	}
+
+	enqueue(flow);
+
+	// give the new flow its quantum with the next round
+	shaper.wake_at = 0;
+}
+
+void shaper_charge(Flow *flow, uint64_t bytes)
+{
+	uint64_t now = get_time_us();
+	shaper.stats.bytes += bytes;
+
+	// buckets may go in debt, delaying the next new packets
+	if (shaper.global.rate > 0)
+	{
+		refill(&shaper.global, now);
+		shaper.global.tokens -= bytes;
+	}
+	if (flow->subnet != NULL)
+	{
+		refill(&flow->subnet->bucket, now);
+		flow->subnet->bucket.tokens -= bytes;
+	}
+	if (flow->client != NULL)
+	{
+		refill(&flow->client->bucket, now);
+		flow->client->bucket.tokens -= bytes;
+	}
+}
+
+void shaper_run(FlowSend send)
+{
+	if (shaper.queued == 0)
+	{
+		return;
+	}
+
+	uint64_t now = get_time_us();
+
+	// too early: the buckets of the queued flows are still empty
+	if (shaper.wake_at > now)
+	{
+		return;
+	}
+	shaper.stats.rounds++;
+	refill(&shaper.global, now);
+
+	// earliest time a throttled flow can send again
+	uint64_t wait = UINT64_MAX;
+
+	// 1 if a flow was held back by its deficit only
+	int ready = 0;
+
+	// visit each queued flow once: flows appended during the round wait
+	// for the next one
+	int flows = shaper.queued;
+	int i;
+	for (i = 0; i < flows && shaper.head != NULL; i++)
+	{
+		Flow *flow = shaper.head;
+		dequeue(flow);
+
+		// the flow earns its quantum, at least a full packet
+		int quantum = shaper.quantum > flow->packet_size ?
+			      shaper.quantum : flow->packet_size;
+		flow->deficit += quantum;
+
+		// bytes allowed by the deficit and by each bucket
+		int64_t allowed = flow->deficit;
+		uint64_t flow_wait = wait_time(&shaper.global,
+					       flow->packet_size);
+		if (shaper.global.rate > 0 && shaper.global.tokens < allowed)
+		{
+			allowed = shaper.global.tokens;
+		}
+		if (flow->subnet != NULL)
+		{
+			TokenBucket *bucket = &flow->subnet->bucket;
+			refill(bucket, now);
+			if (bucket->tokens < allowed)
+			{
+				allowed = bucket->tokens;
+			}
+			uint64_t subnet_wait = wait_time(bucket,
+							 flow->packet_size);
+			if (subnet_wait > flow_wait)
+			{
+				flow_wait = subnet_wait;
+			}
+		}
+		if (flow->client != NULL)
+		{
+			TokenBucket *bucket = &flow->client->bucket;
+			refill(bucket, now);
+			if (bucket->tokens < allowed)
+			{
+				allowed = bucket->tokens;
+			}
+			uint64_t client_wait = wait_time(bucket,
+							 flow->packet_size);
+			if (client_wait > flow_wait)
+			{
+				flow_wait = client_wait;
+			}
+		}
+
+		// held back by a bucket: the deficit is kept, bounded by a
+		// quantum so that the flow does not burst once unblocked
+		int packets = allowed > 0 ? allowed / flow->packet_size : 0;
+		if (packets == 0)
+		{
+			if (flow->deficit > quantum)
+			{
+				flow->deficit = quantum;
+			}
+			if (flow_wait < wait)
+			{
+				wait = flow_wait;
+			}
+			shaper.stats.throttled++;
+			enqueue(flow);
+			continue;
+		}
+
+		// send the allowed packets and charge them
+		int sent = send(flow, packets);
+		int64_t bytes = (int64_t)sent * flow->packet_size;
+		flow->deficit -= bytes;
+		shaper.stats.packets += sent;
+		shaper.stats.bytes += bytes;
+		if (shaper.global.rate > 0)
+		{
+			shaper.global.tokens -= bytes;
+		}
+		if (flow->subnet != NULL)
+		{
+			flow->subnet->bucket.tokens -= bytes;
+		}
+		if (flow->client != NULL)
+		{
+			flow->client->bucket.tokens -= bytes;
+		}
+
+		// the window is full or the file is over: an idle flow does
+		// not keep its deficit
+		if (sent < packets)
+		{
+			flow->deficit = 0;
+			continue;
+		}
+
+		// more to send with the next rounds
+		ready = 1;
+		enqueue(flow);
+	}
+
+	// flows held back by their deficit go on with the next round, the
+	// throttled ones sleep until the first of them can send
+	shaper.wake_at = ready || wait == UINT64_MAX ? 0 : now + wait;
+}
+
+int shaper_next_timeout()
+{
+	if (shaper.queued == 0)
+	{
+		return -1;
+	}
+
+	uint64_t now = get_time_us();
+	if (shaper.wake_at <= now)
+	{
+		return 0;
+	}
+
+	// rounded up, the buckets must hold a whole packet
+	return (shaper.wake_at - now + 999) / 1000;
+}
+
+void shaper_print_stats(void (*log)(LogType, const char *))
+{
+	const ShaperStats *stats = &shaper.stats;
+
+	sprintf(log_message, "Shaper: %.1f global, %.1f per subnet, %.1f per "
+		"client Mbit/s (0 unlimited), %d flows queued.",
+		shaper.rate / 125000.0, shaper.subnet_rate / 125000.0,
+		shaper.client_rate / 125000.0, shaper.queued);
+	log(INFO, log_message);
+
+	sprintf(log_message, "Shaper: %llu rounds, %llu packets scheduled, "
+		"%llu bytes charged, %llu throttled flows.",
+		(unsigned long long)stats->rounds,
+		(unsigned long long)stats->packets,
+		(unsigned long long)stats->bytes,
+		(unsigned long long)stats->throttled);
+	log(INFO, log_message);
+}
+
+static void refill(TokenBucket *bucket, uint64_t now)
+{
+	if (bucket->rate == 0 || now <= bucket->updated)
+	{
+		return;
+	}
+
+	// whole bytes only: the remainder is earned with the next refill
+	uint64_t earned = (now - bucket->updated) * bucket->rate / 1000000;
+	if (earned == 0)
+	{
+		return;
+	}
+	bucket->updated += earned * 1000000 / bucket->rate;
+
+	bucket->tokens += earned;
+	if (bucket->tokens > (int64_t)shaper.burst)
+	{
+		bucket->tokens = shaper.burst;
+		bucket->updated = now;
+	}
+}
+
+static uint64_t wait_time(const TokenBucket *bucket, int64_t bytes)
+{
+	if (bucket->rate == 0 || bucket->tokens >= bytes)
+	{
+		return 0;
+	}
+
+	return (bytes - bucket->tokens) * 1000000 / bucket->rate + 1;
+}
+
+static SharedBucket *acquire_bucket(SharedBucket *buckets, uint32_t key,
+				    uint64_t rate)
+{
+	// the bucket of the key, or the unused bucket idle for longest
+	SharedBucket *oldest = NULL;
+	int i;
+	for (i = 0; i < SHAPER_BUCKETS; i++)
+	{
+		SharedBucket *entry = &buckets[i];
+		if (entry->bucket.updated != 0 && entry->key == key)
+		{
+			entry->refs++;
+			return entry;
+		}
+		if (entry->refs == 0 && (oldest == NULL ||
+		    entry->bucket.updated < oldest->bucket.updated))
+		{
+			oldest = entry;
+		}
+	}
+
+	if (oldest == NULL)
+	{
+		print_log(ERROR, "Too many shaped clients, transfer not rate "
+			  "limited.");
+		return NULL;
+	}
+
+	// a new key starts with a full bucket
+	oldest->key = key;
+	oldest->refs = 1;
+	oldest->bucket.rate = rate;
+	oldest->bucket.tokens = shaper.burst;
+	oldest->bucket.updated = get_time_us();
+
+	return oldest;
+}
+
+static void enqueue(Flow *flow)
+{
+	flow->queued = 1;
+	flow->next = NULL;
+	flow->prev = shaper.tail;
+	if (shaper.tail != NULL)
+	{
+		shaper.tail->next = flow;
+	}
+	else
+	{
+		shaper.head = flow;
+	}
+	shaper.tail = flow;
+	shaper.queued++;
+}
+
+static void dequeue(Flow *flow)
+{
+	if (flow->prev != NULL)
+	{
+		flow->prev->next = flow->next;
+	}
+	else
+	{
+		shaper.head = flow->next;
+	}
+	if (flow->next != NULL)
+	{
+		flow->next->prev = flow->prev;
+	}
+	else
+	{
+		shaper.tail = flow->prev;
+	}
+	flow->queued = 0;
+	shaper.queued--;
+}
@@ -6,7 +6,12 @@
  *         Created on 21/10/2019.
  */
 
+#define _GNU_SOURCE
+
+#include <poll.h>
+
 #include "../include/tftp_client.h"
+#include "../include/batch_io.h"
 
 void main_loop()
 {
@@ -30,10 +35,22 @@ void main_loop()
 		{
 			set_transfer_mode();
 		}
+		else if (strncmp(command, "!blksize", 8) == 0)	// BLKSIZE
+		{
+			set_blksize();
+		}
+		else if (strncmp(command, "!windowsize", 11) == 0)	// WINDOWSIZE
+		{
+			set_windowsize();
+		}
 		else if (strncmp(command, "!get", 4) == 0)	// GET
 		{
 			get_file();
 		}
+		else if (strncmp(command, "!put", 4) == 0)	// PUT
+		{
+			put_file();
+		}
 		else if (strncmp(command, "!quit", 5) == 0)	// QUIT
 		{
 			print_log(INFO, "Quitting TFTP Client as requested.");
@@ -54,8 +71,14 @@ void print_help_menu()
 	fprintf(stdout, "\n> Options:\n"
 		"   !mode <mode>\t\tSets the transfer mode to be used: "
 		"<txt> for text mode and <bin> for binary mode.\n"
+		"   !blksize <n>\tRequests blocks of <n> bytes (8-65464), "
+		"0 to use the default 512 bytes blocks.\n"
+		"   !windowsize <n>\tRequests windows of <n> blocks "
+		"(1-65535), 0 to acknowledge every block.\n"
 		"   !get <src> <dest>\tTransfers the file identified by "
 		"<src> from the server and saves it as <dst>.\n"
+		"   !put <src> <dest>\tTransfers the local file <src> to the "
+		"server and saves it as <dest>.\n"
 		"   !quit\t\tQuit and close the client.\n"
 		"   !help\t\tPrint this help menu.\n");
 }
@@ -91,6 +114,136 @@ void set_transfer_mode()
 	}
 }
 
+void set_blksize()
+{
+	char size[1024];
+
+	// retrieve block size from stdin
+	scanf("%1023s", size);
+
+	// check if the provided block size is valid and store it
+	int value = atoi(size);
+	if (value == 0)					// DEFAULT
+	{
+		blksize = 0;
+		print_log(INFO, "Block size correctly set to default.");
+	}
+	else if (value >= MIN_BLKSIZE && value <= MAX_BLKSIZE)	// BLKSIZE
+	{
+		blksize = value;
+		sprintf(log_message, "Block size correctly set to %d.", value);
+		print_log(INFO, log_message);
+	}
+	else						// INVALID SIZE
+	{
+		print_log(ERROR,
+			  "Invalid block size. Valid values range between 8 "
+			  "and 65464, 0 restores the default.");
+	}
+}
+
+void set_windowsize()
+{
+	char size[1024];
+
+	// retrieve window size from stdin
+	scanf("%1023s", size);
+
+	// check if the provided window size is valid and store it
+	int value = atoi(size);
+	if (value == 0)					// DEFAULT
+	{
+		windowsize = 0;
+		print_log(INFO, "Window size correctly set to default.");
+	}
+	else if (value >= 1 && value <= 65535)		// WINDOWSIZE
+	{
+		windowsize = value;
+		sprintf(log_message, "Window size correctly set to %d.", value);
+		print_log(INFO, log_message);
+	}
+	else						// INVALID SIZE
+	{
+		print_log(ERROR,
+			  "Invalid window size. Valid values range between 1 "
+			  "and 65535, 0 restores the default.");
+	}
+}
+
+int tsize_requested()
+{
+	// options are negotiated anyway, the netascii size is unknown
+	return (blksize > 0 || windowsize > 0) &&
+	       strcmp(transfer_mode, "octet") == 0;
+}
+
+int parse_OACK(const char *buffer, int len, int *blk_size, int *window_size,
+	       uint64_t *file_size, int *rollover)
+{
+	// options follow the opcode as option name and value strings pairs
+	const char *option = buffer + 2;
+	while (option < buffer + len)
+	{
+		// both option name and value must be terminated
+		const char *end = memchr(option, '\0', len - (option - buffer));
+		if (end == NULL || end + 1 >= buffer + len)
+		{
+			return -1;
+		}
+		const char *value = end + 1;
+		end = memchr(value, '\0', len - (value - buffer));
+		if (end == NULL)
+		{
+			return -1;
+		}
+
+		// the server may only lower the requested block size
+		if (strcasecmp(option, "blksize") == 0 && blksize > 0)
+		{
+			*blk_size = atoi(value);
+			if (*blk_size < MIN_BLKSIZE || *blk_size > blksize)
+			{
+				return -1;
+			}
+		}
+		else if (strcasecmp(option, "windowsize") == 0 &&
+			 windowsize > 0)
+		{
+			// the server may only lower the requested window size
+			*window_size = atoi(value);
+			if (*window_size < 1 || *window_size > windowsize)
+			{
+				return -1;
+			}
+		}
+		else if (strcasecmp(option, "tsize") == 0 && tsize_requested())
+		{
+			// size of the requested file
+			*file_size = strtoull(value, NULL, 10);
+		}
+		else if (strcasecmp(option, "rollover") == 0 &&
+			 (blksize > 0 || windowsize > 0))
+		{
+			// block number following 65535: 0 or 1
+			*rollover = atoi(value);
+			if (*rollover != 0 && *rollover != 1)
+			{
+				return -1;
+			}
+		}
+		else
+		{
+			// option not requested
+			return -1;
+		}
+
+		// next option
+		option = end + 1;
+	}
+
+	return 0;
+}
+
 void get_file()
 {
 	// fill in tftp server address struct: use IPv4 address family
@@ -124,11 +277,32 @@ void get_file()
 	sprintf(log_message, "Requesting %s from the TFTP Server.", source);
 	print_log(INFO, log_message);
 
+	// TFTP Server response buffer: big enough for the largest block size
+	char *buffer = malloc(MAX_BLKSIZE + 4);
+	if (buffer == NULL)
+	{
+		print_log(ERROR, "Unable to allocate transfer buffer.");
+		close(cli_socket);
+		return;
+	}
+
+	// round trip time estimator of the transfer
+	RttEstimator rtt;
+	rtt_init(&rtt);
+
 	// send RRQ request
-	send_RRQ(cli_socket, source);
+	send_request(cli_socket, OP_RRQ, source, 0);
 
-	// TFTP Server response buffer
-	char buffer[BUFSIZE];
+	// wait for the response, sending the RRQ again on timeouts
+	if (wait_packet(cli_socket, &rtt) < 0)
+	{
+		print_log(ERROR, "The TFTP Server is not responding. Transfer "
+			  "cancelled.");
+		close(cli_socket);
+		free(buffer);
+		return;
+	}
+	sample_last_packet(&rtt);
 
 	// retrieve server address length
 	int addr_len = sizeof(serv_addr);
@@ -136,7 +310,7 @@ void get_file()
 	// receive response from TFTP Server
 	int recv_len = recvfrom(cli_socket,
 				(char *)buffer,
-				BUFSIZE,
+				MAX_BLKSIZE + 4,
 				MSG_WAITALL,
 				(struct sockaddr *)&serv_addr,
 				(socklen_t *) & addr_len);
@@ -146,35 +320,113 @@ void get_file()
 		    "Error while receiving response after sending RRQ packet");
 
 	// retrieve server response opcode
-	memcpy(&opcode, (uint16_t *) & buffer, 2);
+	memcpy(&opcode, buffer, 2);
 	opcode = ntohs(opcode);
 
+	// negotiated block and window sizes, the default ones if options are
+	// not supported by the server
+	int blk_size = MAX;
+	int window_size = 1;
+
+	// requested file size, 0 if unknown
+	uint64_t file_size = 0;
+
+	// block number following 65535
+	int rollover = 0;
+
+	// check the opcode for options acknowledgment
+	if (opcode == 6)
+	{
+		// check the acknowledged options
+		if (parse_OACK(buffer, recv_len, &blk_size, &window_size,
+			       &file_size, &rollover) < 0)
+		{
+			print_log(ERROR, "Invalid options acknowledgment "
+				  "received. Transfer cancelled.");
+			send_ERROR(cli_socket, &serv_addr, ERR_OPTION,
+				   "Invalid options");
+			close(cli_socket);
+			free(buffer);
+			return;
+		}
+
+		// print info log message
+		sprintf(log_message, "Block size negotiated: %d bytes, window "
+			"size negotiated: %d blocks.", blk_size, window_size);
+		print_log(INFO, log_message);
+
+		// the file size is used to allocate the destination file
+		if (file_size > 0)
+		{
+			sprintf(log_message, "File size: %llu bytes.",
+				(unsigned long long)file_size);
+			print_log(INFO, log_message);
+		}
+
+		// confirm the options, the server starts sending data packets
+		send_ACK(cli_socket, 0);
+
+		// receive the first data packet from the server TID, the
+		// packets coming from another TID are answered and ignored
+		while (1)
+		{
+			// wait for the first data packet, sending the ACK again
+			// on timeouts
+			if (wait_packet(cli_socket, &rtt) < 0)
+			{
+				print_log(ERROR, "The TFTP Server is not "
+					  "responding. Transfer cancelled.");
+				close(cli_socket);
+				free(buffer);
+				return;
+			}
+
+			// receive first data packet from the Server
+			struct sockaddr_in from;
+			socklen_t from_len = sizeof(from);
+			recv_len = recvfrom(cli_socket,
+					    (char *)buffer,
+					    blk_size + 4,
+					    MSG_WAITALL,
+					    (struct sockaddr *)&from,
+					    &from_len);
+
+			// check for errors
+			check_errno(recv_len,
+				    "Error while receiving data packets");
+
+			if (from.sin_addr.s_addr == serv_addr.sin_addr.s_addr &&
+			    from.sin_port == serv_addr.sin_port)
+			{
+				break;
+			}
+			send_ERROR(cli_socket, &from, ERR_UNKNOWN_TID,
+				   "Unknown transfer ID");
+		}
+		sample_last_packet(&rtt);
+
+		// retrieve server response opcode
+		memcpy(&opcode, buffer, 2);
+		opcode = ntohs(opcode);
+	}
+
 	// check the opcode for error messages
 	if (opcode == 5)
 	{
 		// error message opcode found, print a warning error log
-		sprintf(log_message, "Error: %s.", buffer + 2);
-		print_log(ERROR, log_message);
+		print_ERROR(buffer, recv_len);
 	}
 	else if (opcode == 3)	// check the opcode for data messages
 	{
-		// block number
-		uint16_t block_number;
-
-		// retrieve block number from transfer buffer
-		memcpy(&block_number, (uint16_t *) & buffer[2], 2);
-
-		// deserialize block number
-		block_number = ntohs(block_number);
-
 		// print info log message
 		print_log(INFO, "Transferring file from the Server.");
 
-		// open file in write mode
-		FILE *dest_file = fopen(dest, "w");
+		// open file in write mode, allocating its space if the size is
+		// known
+		AsyncWriter *writer = writer_open(dest, file_size);
 
 		// check if the file was correctly opened
-		if (dest_file == NULL)
+		if (writer == NULL)
 		{
 			// if not, print a warning error log
 			sprintf(log_message,
@@ -186,67 +438,792 @@ void get_file()
 			exit(-1);
 		}
 
-		// write received buffer to the file considering that each data packet
-		// has 2 bytes opcode and 2 bytes block number
-		int i = 0;
-		for (i = 0; i < recv_len - 4; i++) {
-			// skip opcode and block number and write
-			fputc(buffer[i + 4], dest_file);
+		// receive the whole file starting from the first data packet
+		int received = receive_file(cli_socket, writer, &rtt, buffer,
+					    recv_len, blk_size, window_size,
+					    rollover);
+
+		// wait for the queued data to be written and close the file
+		if (writer_close(writer) < 0 && received == 0)
+		{
+			sprintf(log_message,
+				"Error while writing the destination file: "
+				"errno = %d", errno);
+			print_log(ERROR, log_message);
+			received = -1;
 		}
 
-		// send ACK packet for received block
-		send_ACK(cli_socket, block_number);
+		// print an info log message
+		if (received == 0)
+		{
+			sprintf(log_message,
+				"File %s correctly downloaded. Saved in %s.",
+				source, dest);
+			print_log(INFO, log_message);
+		}
+	}
 
-		// until data packets of length >= 516 are sent
-		while (recv_len == 516) {
-			// receive data packet from the Server
-			recv_len = recvfrom(cli_socket,
-					    (char *)buffer,
-					    BUFSIZE,
-					    MSG_WAITALL,
-					    (struct sockaddr *)&serv_addr,
-					    (socklen_t *) & addr_len);
+	// transfer completed, shutdown socket read and write
+	shutdown(cli_socket, SHUT_RDWR);
 
-			// check for errors
-			check_errno(recv_len,
-				    "Error while receiving data packets");
+	// close the socket
+	close(cli_socket);
+
+	// release the transfer buffer
+	free(buffer);
+}
+
+void put_file()
+{
+	// fill in tftp server address struct: use IPv4 address family
+	serv_addr.sin_family = AF_INET;
+
+	// set network address
+	inet_pton(AF_INET, server_ip, &serv_addr.sin_addr);
+
+	// set network port: port numbers below 1024 are privileged ports
+	serv_addr.sin_port = htons(server_port);
+
+	// transfer source file
+	char source[256];
+
+	// transfer destination file
+	char dest[256];
+
+	// retrieve source file name
+	scanf("%255s", source);
+
+	// retrieve destination file name
+	scanf("%255s", dest);
+
+	// open the local file, converted to netascii in text mode
+	int netascii = strcmp(transfer_mode, "netascii") == 0;
+	BlockSource *src = block_source_open(source, SOURCE_PREAD, netascii);
+	if (src == NULL)
+	{
+		sprintf(log_message, "Error while opening the source file %s: "
+			"errno = %d", source, errno);
+		print_log(ERROR, log_message);
+		return;
+	}
+
+	// create client socket descriptor
+	int cli_socket = socket(AF_INET, SOCK_DGRAM, 0);
+
+	// print info log message
+	sprintf(log_message, "Sending %s to the TFTP Server as %s.", source,
+		dest);
+	print_log(INFO, log_message);
+
+	// round trip time estimator of the transfer
+	RttEstimator rtt;
+	rtt_init(&rtt);
+
+	// send WRQ request announcing the file size
+	send_request(cli_socket, OP_WRQ, dest, src->size);
+
+	// transfer result
+	int sent = -1;
+
+	// TFTP Server response buffer
+	char buffer[BUFSIZE];
+
+	// wait for the response, sending the WRQ again on timeouts
+	if (wait_packet(cli_socket, &rtt) < 0)
+	{
+		print_log(ERROR, "The TFTP Server is not responding. Transfer "
+			  "cancelled.");
+		goto out;
+	}
+	sample_last_packet(&rtt);
+
+	// receive response from TFTP Server: the server TID is taken from it
+	socklen_t addr_len = sizeof(serv_addr);
+	int recv_len = recvfrom(cli_socket,
+				buffer,
+				BUFSIZE - 1,
+				0,
+				(struct sockaddr *)&serv_addr,
+				&addr_len);
+
+	// check for errors
+	check_errno(recv_len,
+		    "Error while receiving response after sending WRQ packet");
+	buffer[recv_len] = '\0';
+
+	// retrieve server response opcode and block number
+	uint16_t opcode = 0;
+	uint16_t block = 0;
+	if (recv_len >= 4)
+	{
+		memcpy(&opcode, buffer, 2);
+		memcpy(&block, buffer + 2, 2);
+		opcode = ntohs(opcode);
+		block = ntohs(block);
+	}
+
+	// negotiated block and window sizes, the default ones if options are
+	// not supported by the server
+	int blk_size = MAX;
+	int window_size = 1;
+
+	// size echoed by the server, unused
+	uint64_t file_size = 0;
+
+	// block number following 65535
+	int rollover = 0;
+
+	if (opcode == OP_OACK)		// OPTIONS ACKNOWLEDGED
+	{
+		// check the acknowledged options
+		if (parse_OACK(buffer, recv_len, &blk_size, &window_size,
+			       &file_size, &rollover) < 0)
+		{
+			print_log(ERROR, "Invalid options acknowledgment "
+				  "received. Transfer cancelled.");
+			send_ERROR(cli_socket, &serv_addr, ERR_OPTION,
+				   "Invalid options");
+			goto out;
+		}
+
+		// print info log message
+		sprintf(log_message, "Block size negotiated: %d bytes, window "
+			"size negotiated: %d blocks.", blk_size, window_size);
+		print_log(INFO, log_message);
+	}
+	else if (opcode == OP_ERROR)	// REQUEST REFUSED
+	{
+		print_ERROR(buffer, recv_len);
+		goto out;
+	}
+	else if (opcode != OP_ACK || block != 0)
+	{
+		print_log(ERROR, "Unexpected response received. Transfer "
+			  "cancelled.");
+		goto out;
+	}
+
+	// the first DATA packet confirms the options
+	print_log(INFO, "Transferring file to the Server.");
+	sent = send_file(cli_socket, src, &rtt, blk_size, window_size,
+			 rollover);
+
+	// print an info log message
+	if (sent == 0)
+	{
+		sprintf(log_message, "File %s correctly uploaded. Saved as %s.",
+			source, dest);
+		print_log(INFO, log_message);
+	}
+
+out:
+	// transfer completed, shutdown socket read and write
+	shutdown(cli_socket, SHUT_RDWR);
+
+	// close the socket and the source file
+	close(cli_socket);
+	block_source_close(src);
+}
+
+int send_file(int cli_socket, BlockSource *source, RttEstimator *rtt,
+	      int blk_size, int window_size, int rollover)
+{
+	// window slots: opcode and block number followed by a whole block
+	char *slots = malloc((size_t)window_size * (blk_size + 4));
+
+	// payload of each slot and the time it was sent (us), 0 once it was
+	// sent more than once
+	struct iovec *blocks = calloc(window_size, sizeof(struct iovec));
+	uint64_t *sent_us = calloc(window_size, sizeof(uint64_t));
+
+	// ACKs received with a single system call
+	RecvBatch batch;
+	int batch_ok = batch_recv_alloc(&batch, window_size, BUFSIZE) == 0;
+
+	if (slots == NULL || blocks == NULL || sent_us == NULL || !batch_ok)
+	{
+		print_log(ERROR, "Unable to allocate transfer window.");
+		if (batch_ok)
+		{
+			batch_recv_free(&batch);
+		}
+		free(slots);
+		free(blocks);
+		free(sent_us);
+		return -1;
+	}
+
+	// index of the last acknowledged block and of the last block sent:
+	// the block numbers carried on the wire wrap around past 65535
+	uint64_t acked = 0;
+	uint64_t sent = 0;
+
+	// window slot of block acked + 1 and blocks not acknowledged yet
+	int head = 0;
+	int in_flight = 0;
+
+	// 1 once the last block has been read
+	int eof = 0;
+
+	// transfer statistics
+	uint64_t packets = 0;
+	uint64_t acks = 0;
+	uint64_t duplicates = 0;
+	uint64_t stale = 0;
+	uint64_t gaps = 0;
+	uint64_t foreign = 0;
 
-			// retrieve block number from transfer buffer
-			memcpy(&block_number, (uint16_t *) & buffer[2], 2);
+	// transfer result
+	int result = -1;
 
-			// deserialize block number
-			block_number = ntohs(block_number);
+	// outgoing packets batch
+	SendBatch out;
+	batch_init(&out, cli_socket);
 
-			// write received buffer to the file considering that each data packet
-			// has 2 bytes opcode and 2 bytes block number
-			int i = 0;
-			for (i = 0; i < recv_len - 4; i++) {
-				// skip opcode and block number and write
-				fputc(buffer[i + 4], dest_file);
+	// wait on the client socket only
+	struct pollfd pfd;
+	pfd.fd = cli_socket;
+	pfd.events = POLLIN;
+
+	while (1)
+	{
+		// fill the free window slots with the next blocks
+		int count = window_size - in_flight;
+		if (!eof && count > 0)
+		{
+			// read the blocks right after opcode and block number
+			int i;
+			for (i = 0; i < count; i++)
+			{
+				int slot = (head + in_flight + i) % window_size;
+				blocks[slot].iov_base = slots + (size_t)slot *
+							(blk_size + 4) + 4;
 			}
 
-			// send ACK packet for received block
-			send_ACK(cli_socket, block_number);
+			// the free slots may wrap around the window end
+			int first = (head + in_flight) % window_size;
+			int run = window_size - first < count ?
+				  window_size - first : count;
+			int read = block_source_read(source, blocks + first,
+						     run, blk_size);
+			if (read == run && run < count)
+			{
+				int more = block_source_read(source, blocks,
+							     count - run,
+							     blk_size);
+				read = more < 0 ? -1 : read + more;
+			}
+
+			// the file could not be read, cancel the transfer
+			if (read < 0)
+			{
+				print_log(ERROR, "Error while reading the "
+					  "source file. Transfer cancelled.");
+				send_ERROR(cli_socket, &serv_addr,
+					   ERR_UNDEFINED, "Read error");
+				break;
+			}
+
+			// queue the new blocks
+			for (i = 0; i < read; i++)
+			{
+				int slot = (head + in_flight) % window_size;
+				char *header = slots + (size_t)slot *
+					       (blk_size + 4);
+
+				// a block shorter than the block size
+				// terminates the transfer
+				eof = blocks[slot].iov_len < (size_t)blk_size;
+				sent++;
+				in_flight++;
+
+				// opcode = 3 (= DATA) and wrapped block number
+				uint16_t opcode = htons(OP_DATA);
+				uint16_t block = htons(wrap_block(sent,
+								  rollover));
+				memcpy(header, &opcode, 2);
+				memcpy(header + 2, &block, 2);
+
+				batch_add(&out, &serv_addr, header, 4,
+					  &blocks[slot]);
+				sent_us[slot] = get_time_us();
+				packets++;
+			}
 		}
 
-		// transfer completed, shutdown socket read and write
-		shutdown(cli_socket, SHUT_RDWR);
+		// the whole window goes out with a single system call
+		if (out.count > 0 && batch_flush(&out) < 0)
+		{
+			// a failed send is recovered by the timeout
+			sprintf(log_message, "Error while sending data "
+				"packets: errno = %d", errno);
+			print_log(ERROR, log_message);
+		}
 
-		// close the socket
-		close(cli_socket);
+		// wait up to the retransmission timeout
+		int ready = poll(&pfd, 1, rtt_timeout_ms(rtt));
 
-		// close the destination file stream
-		fclose(dest_file);
+		// interrupted by a signal, just wait again
+		if (ready < 0 && errno == EINTR)
+		{
+			continue;
+		}
 
-		// print an info log message
-		sprintf(log_message,
-			"File %s correctly downloaded. Saved in %s.", source,
-			dest);
-		print_log(INFO, log_message);
+		// check for errors
+		check_errno(ready, "Error while waiting for packets");
+
+		// timeout: send the blocks in flight again
+		if (ready == 0)
+		{
+			// the server may be slower than estimated: wait
+			// longer, or give up once the retry budget is spent
+			if (rtt_backoff(rtt) < 0)
+			{
+				print_log(ERROR, "The TFTP Server is not "
+					  "responding. Transfer cancelled.");
+				break;
+			}
+
+			int i;
+			for (i = 0; i < in_flight; i++)
+			{
+				int slot = (head + i) % window_size;
+				batch_add(&out, &serv_addr,
+					  slots + (size_t)slot * (blk_size + 4),
+					  4, &blocks[slot]);
+				sent_us[slot] = 0;
+				packets++;
+			}
+			continue;
+		}
+
+		// take all the ACKs already queued
+		count = batch_recv(cli_socket, &batch, MSG_DONTWAIT);
+		if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			continue;
+		}
+		check_errno(count, "Error while receiving ACK packets");
+
+		// set once the transfer is over
+		int done = 0;
+
+		int i;
+		for (i = 0; i < count && !done; i++)
+		{
+			// next received packet and its sender
+			struct sockaddr_in *from = &batch.addrs[i];
+			int recv_len;
+			char *buffer = batch_packet(&batch, i, &recv_len);
+
+			// packets coming from another TID are answered without
+			// disturbing the transfer
+			if (from->sin_addr.s_addr != serv_addr.sin_addr.s_addr ||
+			    from->sin_port != serv_addr.sin_port)
+			{
+				foreign++;
+				send_ERROR(cli_socket, from, ERR_UNKNOWN_TID,
+					   "Unknown transfer ID");
+				continue;
+			}
+
+			// retrieve opcode and block number
+			if (recv_len < 4)
+			{
+				continue;
+			}
+			uint16_t opcode;
+			uint16_t block;
+			memcpy(&opcode, buffer, 2);
+			memcpy(&block, buffer + 2, 2);
+			opcode = ntohs(opcode);
+			block = ntohs(block);
+
+			// the server cancelled the transfer
+			if (opcode == OP_ERROR)
+			{
+				print_ERROR(buffer, recv_len);
+				done = 1;
+				break;
+			}
+
+			// ignore anything else but ACKs
+			if (opcode != OP_ACK)
+			{
+				continue;
+			}
+			acks++;
+
+			// blocks acknowledged by this ACK
+			uint16_t distance = block_distance(
+				wrap_block(acked, rollover), block, rollover);
+
+			// a late copy of an ACK sent again by the server
+			if (distance > in_flight)
+			{
+				stale++;
+				continue;
+			}
+
+			// a duplicate ACK never triggers a retransmission
+			// (Sorcerer's Apprentice Syndrome): lost blocks are
+			// sent again on timeout
+			if (distance == 0)
+			{
+				duplicates++;
+				continue;
+			}
+
+			// Karn's algorithm: sample blocks sent only once
+			int last = (head + distance - 1) % window_size;
+			if (sent_us[last] > 0)
+			{
+				rtt_sample(rtt, get_time_us() - sent_us[last]);
+			}
+
+			// ACKs are cumulative: slide the window
+			acked += distance;
+			head = (head + distance) % window_size;
+			in_flight -= distance;
+			rtt_progress(rtt);
+
+			// the last DATA packet was acknowledged
+			if (eof && in_flight == 0)
+			{
+				result = 0;
+				done = 1;
+				break;
+			}
+
+			// an ACK before the end of the window reports a gap at
+			// the server: go back to the block following the
+			// acknowledged one
+			if (in_flight > 0)
+			{
+				gaps++;
+				int j;
+				for (j = 0; j < in_flight; j++)
+				{
+					int slot = (head + j) % window_size;
+					batch_add(&out, &serv_addr,
+						  slots + (size_t)slot *
+						  (blk_size + 4), 4,
+						  &blocks[slot]);
+					sent_us[slot] = 0;
+					packets++;
+				}
+			}
+		}
+
+		if (done)
+		{
+			break;
+		}
+	}
+
+	// report the transfer statistics
+	sprintf(log_message, "Sent %llu blocks with %llu packets, %llu ACKs "
+		"received: window negotiated %d. Duplicate ACKs: %llu, stale "
+		"ACKs: %llu, gaps: %llu, packets from other TIDs: %llu.",
+		(unsigned long long)sent, (unsigned long long)packets,
+		(unsigned long long)acks, window_size,
+		(unsigned long long)duplicates, (unsigned long long)stale,
+		(unsigned long long)gaps, (unsigned long long)foreign);
+	print_log(INFO, log_message);
+
+	// report the batching achieved and the round trip times
+	batch_print_stats(print_log);
+	rtt_print_stats(rtt, "the transfer", print_log);
+
+	batch_recv_free(&batch);
+	free(slots);
+	free(blocks);
+	free(sent_us);
+
+	return result;
+}
+
+int receive_file(int cli_socket, AsyncWriter *writer, RttEstimator *rtt,
+		 char *buffer, int recv_len, int blk_size, int window_size,
+		 int rollover)
+{
+	// data packets received with a single system call: up to a window
+	RecvBatch batch;
+	if (batch_recv_alloc(&batch, window_size, blk_size + 4) < 0)
+	{
+		print_log(ERROR, "Unable to allocate receive buffers.");
+		return -1;
+	}
+
+	// number of packets received with the last call
+	int count = 0;
+
+	// index of the next packet to be processed
+	int next = 0;
+
+	// blocks received out of order, waiting for the missing ones
+	char *reorder = malloc(window_size * blk_size);
+	int *reorder_len = calloc(window_size, sizeof(int));
+	if (reorder == NULL || reorder_len == NULL)
+	{
+		print_log(ERROR, "Unable to allocate reorder buffer.");
+		batch_recv_free(&batch);
+		free(reorder);
+		free(reorder_len);
+		return -1;
+	}
+
+	// text mode payloads are converted from netascii
+	NetasciiDecoder decoder;
+	NetasciiDecoder *dec = NULL;
+	if (strcmp(transfer_mode, "netascii") == 0)
+	{
+		netascii_decoder_init(&decoder);
+		dec = &decoder;
+	}
+
+	// reorder buffer slot of the expected block
+	int head = 0;
+
+	// index of the next block expected in sequence: the block numbers
+	// carried on the wire wrap around past 65535
+	uint64_t expected = 1;
+
+	// blocks received in sequence since the last ACK
+	int in_window = 0;
+
+	// set once a gap has been reported or a duplicate acknowledged
+	int gap_acked = 0;
+	int dup_acked = 0;
+
+	// transfer statistics
+	uint64_t blocks = 0;
+	uint64_t acks = 0;
+	uint64_t out_of_order = 0;
+	uint64_t duplicates = 0;
+	uint64_t foreign = 0;
+
+	// sender of the packet being processed: the first one was received
+	// from the server TID
+	struct sockaddr_in *from = NULL;
+
+	// transfer result
+	int result = -1;
+
+	// until the last data packet is written
+	while (1)
+	{
+		// retrieve opcode and block number from transfer buffer
+		uint16_t opcode;
+		uint16_t block_number;
+		memcpy(&opcode, buffer, 2);
+		memcpy(&block_number, buffer + 2, 2);
+		opcode = ntohs(opcode);
+		block_number = ntohs(block_number);
+
+		// distance from the expected block: block numbers wrap around
+		uint16_t distance = block_distance(wrap_block(expected,
+							      rollover),
+						   block_number, rollover);
+
+		// packets coming from another TID are answered without
+		// disturbing the transfer
+		if (from != NULL &&
+		    (from->sin_addr.s_addr != serv_addr.sin_addr.s_addr ||
+		     from->sin_port != serv_addr.sin_port))
+		{
+			foreign++;
+			send_ERROR(cli_socket, from, ERR_UNKNOWN_TID,
+				   "Unknown transfer ID");
+		}
+		else if (opcode == 5)		// TRANSFER CANCELLED
+		{
+			print_ERROR(buffer, recv_len);
+			break;
+		}
+		else if (opcode != 3 || recv_len < 4)
+		{
+			// not a data packet, ignore it
+		}
+		else if (distance == 0)		// EXPECTED BLOCK
+		{
+			// the first block received after an ACK measures its
+			// round trip time
+			if (next == 1)
+			{
+				sample_last_packet(rtt);
+			}
+
+			// queue received payload skipping opcode and block number
+			int failed = write_block(writer, dec, buffer + 4,
+						 recv_len - 4) < 0;
+			int last = recv_len - 4 < blk_size;
+
+			// move past the expected block
+			reorder_len[head] = 0;
+			head = (head + 1) % window_size;
+			expected++;
+			in_window++;
+			blocks++;
+			gap_acked = 0;
+			dup_acked = 0;
+
+			// deliver the blocks already received out of order
+			while (!last && reorder_len[head] > 0)
+			{
+				int len = reorder_len[head] - 1;
+				failed |= write_block(writer, dec,
+						      reorder + head * blk_size,
+						      len) < 0;
+				last = len < blk_size;
+
+				reorder_len[head] = 0;
+				head = (head + 1) % window_size;
+				expected++;
+				in_window++;
+				blocks++;
+			}
+
+			// the destination file can not be written: cancel the
+			// transfer
+			if (failed)
+			{
+				sprintf(log_message, "Error while writing the "
+					"destination file: errno = %d", errno);
+				print_log(ERROR, log_message);
+				send_ERROR(cli_socket, &serv_addr, ERR_DISK_FULL,
+					   "Write error");
+				break;
+			}
+
+			// the blocks are safely queued: acknowledge at window
+			// boundaries and on the last block
+			if (last || in_window >= window_size)
+			{
+				send_ACK(cli_socket,
+					 wrap_block(expected - 1, rollover));
+				acks++;
+				in_window = 0;
+			}
+
+			// transfer completed
+			if (last)
+			{
+				// write a CR ending the file
+				char cr;
+				if (dec != NULL &&
+				    netascii_decode_end(dec, &cr) > 0)
+				{
+					writer_write(writer, &cr, 1);
+				}
+
+				result = 0;
+				break;
+			}
+		}
+		else if (distance < window_size)	// AHEAD OF A GAP
+		{
+			// keep the block until the missing ones are received
+			int slot = (head + distance) % window_size;
+			if (reorder_len[slot] == 0)
+			{
+				memcpy(reorder + slot * blk_size, buffer + 4,
+				       recv_len - 4);
+				reorder_len[slot] = recv_len - 4 + 1;
+			}
+			out_of_order++;
+
+			// report the gap once: the server goes back to the
+			// block following the acknowledged one
+			if (!gap_acked)
+			{
+				send_ACK(cli_socket,
+					 wrap_block(expected - 1, rollover));
+				acks++;
+				gap_acked = 1;
+				in_window = 0;
+			}
+		}
+		else				// ALREADY RECEIVED
+		{
+			duplicates++;
+
+			// our ACK was lost: acknowledge again, only once, the
+			// server starts a new window from every ACK (RFC 7440)
+			if (!dup_acked)
+			{
+				send_ACK(cli_socket,
+					 wrap_block(expected - 1, rollover));
+				acks++;
+				dup_acked = 1;
+				in_window = 0;
+			}
+		}
+
+		// all the received packets processed: wait for the next data
+		// packet and take all the others already queued with it
+		if (next == count)
+		{
+			// the last ACK is sent again on timeouts
+			if (wait_packet(cli_socket, rtt) < 0)
+			{
+				print_log(ERROR, "The TFTP Server is not "
+					  "responding. Transfer cancelled.");
+				break;
+			}
+
+			count = batch_recv(cli_socket, &batch, MSG_WAITFORONE);
+			next = 0;
+
+			// check for errors
+			check_errno(count, "Error while receiving data packets");
+		}
+
+		// next received data packet and its sender
+		from = &batch.addrs[next];
+		buffer = batch_packet(&batch, next++, &recv_len);
 	}
+
+	// report the window actually achieved
+	sprintf(log_message, "Received %llu blocks with %llu ACKs: window "
+		"negotiated %d, achieved %.1f blocks per ACK. Out of order "
+		"blocks: %llu, duplicate blocks: %llu, packets from other "
+		"TIDs: %llu.",
+		(unsigned long long)blocks, (unsigned long long)acks,
+		window_size, acks > 0 ? (double)blocks / acks : 0.0,
+		(unsigned long long)out_of_order,
+		(unsigned long long)duplicates, (unsigned long long)foreign);
+	print_log(INFO, log_message);
+
+	// report the receive batching achieved and the round trip times
+	batch_print_stats(print_log);
+	rtt_print_stats(rtt, "the transfer", print_log);
+
+	batch_recv_free(&batch);
+	free(reorder);
+	free(reorder_len);
+
+	return result;
 }
 
-void send_RRQ(int cli_socket, char *file_name)
+int write_block(AsyncWriter *writer, NetasciiDecoder *dec, const char *data,
+		int len)
+{
+	// binary mode: queue the whole payload at once
+	if (dec == NULL)
+	{
+		return writer_write(writer, data, len);
+	}
+
+	// text mode: convert the payload, a CR may be carried from the
+	// previous block
+	static char decoded[MAX_BLKSIZE + 1];
+	size_t decoded_len = netascii_decode(dec, data, len, decoded);
+	return writer_write(writer, decoded, decoded_len);
+}
+
+void send_request(int cli_socket, uint16_t code, char *file_name,
+		  uint64_t file_size)
 {
 	// final transfer buffer length
 	int len = 0;
@@ -254,8 +1231,8 @@ void send_RRQ(int cli_socket, char *file_name)
 	// transfer buffer
 	char buffer[BUFSIZE];
 
-	// opcode to be used (RRQ = 1)
-	uint16_t opcode = htons(1);
+	// opcode to be used (RRQ = 1, WRQ = 2)
+	uint16_t opcode = htons(code);
 
 	// terminating end string
 	uint8_t end_string = 0;
@@ -290,7 +1267,37 @@ void send_RRQ(int cli_socket, char *file_name)
 	// update transfer buffer size
 	len++;
 
-	// send RRQ to the TFTP Server
+	// append the blksize option name and value strings
+	if (blksize > 0)
+	{
+		len += sprintf(buffer + len, "blksize") + 1;
+		len += sprintf(buffer + len, "%d", blksize) + 1;
+	}
+
+	// append the windowsize option name and value strings
+	if (windowsize > 0)
+	{
+		len += sprintf(buffer + len, "windowsize") + 1;
+		len += sprintf(buffer + len, "%d", windowsize) + 1;
+	}
+
+	// ask for the file size, used to allocate the destination file, or
+	// announce the size of the uploaded one
+	if (tsize_requested())
+	{
+		len += sprintf(buffer + len, "tsize") + 1;
+		len += sprintf(buffer + len, "%llu",
+			       (unsigned long long)file_size) + 1;
+	}
+
+	// make block numbers restart from 0 after 65535 on large files
+	if (blksize > 0 || windowsize > 0)
+	{
+		len += sprintf(buffer + len, "rollover") + 1;
+		len += sprintf(buffer + len, "0") + 1;
+	}
+
+	// send RRQ or WRQ to the TFTP Server
 	int sent_len = sendto(cli_socket,	// client socket
 			      buffer,		// transfer buffer
 			      len,		// transfer buffer length
@@ -299,7 +1306,50 @@ void send_RRQ(int cli_socket, char *file_name)
 			      sizeof(serv_addr));
 
 	// check for errors
-	check_errno(sent_len, "Error while sending RRQ packet.");
+	check_errno(sent_len, "Error while sending request packet.");
+
+	// retain the packet for retransmissions
+	keep_last_packet(buffer, len);
+}
+
+void send_ERROR(int cli_socket, const struct sockaddr_in *addr, uint16_t code,
+		const char *message)
+{
+	// transfer buffer
+	char buffer[BUFSIZE];
+
+	// serialize opcode (ERROR = 5) and error code
+	uint16_t opcode = htons(OP_ERROR);
+	code = htons(code);
+
+	// copy opcode and error code to the transfer buffer
+	memcpy(buffer, &opcode, 2);
+	memcpy(buffer + 2, &code, 2);
+
+	// copy error message and its terminating end string to the buffer
+	strcpy(buffer + 4, message);
+
+	// send error message: it is not acknowledged, a failure is just
+	// logged
+	int sent_len = sendto(cli_socket,
+			      buffer,
+			      strlen(message) + 5,
+			      MSG_CONFIRM,
+			      (const struct sockaddr *)addr,
+			      sizeof(struct sockaddr_in));
+	if (sent_len < 0)
+	{
+		print_log(ERROR, "Error while sending ERROR packet.");
+	}
+}
+
+void print_ERROR(const char *buffer, int len)
+{
+	// the text stops at its terminator or at the end of the packet
+	int text_len = len > 4 ? len - 4 : 0;
+	snprintf(log_message, sizeof(log_message), "Error: %.*s.", text_len,
+		 buffer + 4);
+	print_log(ERROR, log_message);
 }
 
 void send_ACK(int cli_socket, uint16_t block_number)
@@ -338,6 +1388,82 @@ void send_ACK(int cli_socket, uint16_t block_number)
 
 	// check for errors
 	check_errno(sent_len, "Error while sending ACK packet");
+
+	// retain the packet for retransmissions
+	keep_last_packet(buffer, len);
+}
+
+void keep_last_packet(const char *buffer, int len)
+{
+	memcpy(last_packet, buffer, len);
+	last_packet_len = len;
+	last_packet_sent_us = get_time_us();
+	last_packet_resent = 0;
+}
+
+void sample_last_packet(RttEstimator *rtt)
+{
+	// Karn's algorithm: a response to a retransmitted packet may refer to
+	// any of its copies
+	if (last_packet_sent_us > 0 && !last_packet_resent)
+	{
+		rtt_sample(rtt, get_time_us() - last_packet_sent_us);
+	}
+
+	// one sample per packet sent
+	last_packet_sent_us = 0;
+}
+
+int wait_packet(int cli_socket, RttEstimator *rtt)
+{
+	// wait on the client socket only
+	struct pollfd pfd;
+	pfd.fd = cli_socket;
+	pfd.events = POLLIN;
+
+	while (1)
+	{
+		// wait up to the retransmission timeout
+		int ready = poll(&pfd, 1, rtt_timeout_ms(rtt));
+		if (ready > 0)
+		{
+			rtt_progress(rtt);
+			return 0;
+		}
+
+		// interrupted by a signal, just wait again
+		if (ready < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		// check for errors
+		check_errno(ready, "Error while waiting for packets");
+
+		// the server may be slower than estimated: wait longer, or give
+		// up once the retry budget is spent
+		if (rtt_backoff(rtt) < 0)
+		{
+			return -1;
+		}
+
+		// the packet or its response was lost: send it again
+		int sent_len = sendto(cli_socket,
+				      last_packet,
+				      last_packet_len,
+				      MSG_CONFIRM,
+				      (const struct sockaddr *)&serv_addr,
+				      sizeof(serv_addr));
+		check_errno(sent_len, "Error while sending packet again");
+		last_packet_resent = 1;
+
+		// if debugging is enabled
+		if (DEBUG)
+		{
+			print_log(INFO, "Timeout expired, last packet sent "
+				  "again.");
+		}
+	}
 }
 
 /**
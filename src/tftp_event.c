@@ -0,0 +1,495 @@
+/**
+ * File: tftp_event.c
+ *       TFTP Server Event Loop Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#include "../include/tftp_server.h"
+#include "../include/tftp_event.h"
+#include "../include/batch_io.h"
+
+/**
+ * Epoll instance multiplexing the listener and all the transfer sockets.
+ */
+static int epoll_fd;
+
+/**
+ * Active transfer sessions list.
+ */
+static Session *sessions = NULL;
+
+/**
+ * Number of active transfer sessions.
+ */
+static int sessions_count = 0;
+
+/**
+ * Requests received from the listener.
+ */
+static RecvBatch requests;
+
+/**
+ * Retransmission deadlines of the active sessions.
+ */
+static TimerWheel timers;
+
+/**
+ * Reads all the requests waiting on the listener socket and starts a new
+ * session for each valid RRQ or WRQ.
+ */
+static void accept_requests();
+
+/**
+ * Creates and starts the session serving the given admitted request. If the
+ * session can not be created the transfer slot is released.
+ *
+ * @param  req       the admitted request;
+ * @param  cli_addr  address of the client requesting the file transfer.
+ */
+static void start_session(const Request *req,
+			  const struct sockaddr_in *cli_addr);
+
+/**
+ * Starts the pending requests while transfer slots are free.
+ */
+static void start_pending();
+
+/**
+ * Adds the given session to the active sessions and registers its socket in
+ * the epoll instance.
+ *
+ * @param  session  the session to be added.
+ */
+static void add_session(Session *session);
+
+/**
+ * Removes the given session from the active sessions and destroys it.
+ *
+ * @param  session  the session to be removed.
+ */
+static void remove_session(Session *session);
+
+/**
+ * Removes the given session if the transfer is over, otherwise schedules its
+ * retransmission deadline.
+ *
+ * @param  session  the session just processed.
+ */
+static void update_session(Session *session);
+
+/**
+ * Handles the expiration of a session retransmission deadline.
+ *
+ * @param  timer  the expired session timer.
+ */
+static void expire_session(Timer *timer);
+
+/**
+ * Sends the new DATA packets of a shaped session allowed by the scheduler.
+ *
+ * @param  flow     the session flow;
+ * @param  packets  maximum number of packets to be sent.
+ *
+ * @return  the number of packets sent.
+ */
+static int send_flow(Flow *flow, int packets);
+
+/**
+ * Returns the time left before the earliest retransmission deadline or the
+ * next bandwidth shaper round.
+ *
+ * @return  the epoll timeout (ms), -1 if there is nothing to wait for.
+ */
+static int next_timeout();
+
+void event_loop()
+{
+	// print info log message
+	print_log(INFO, "Event loop started.");
+
+	// the listener is drained until EAGAIN on every readiness notification
+	int flags = fcntl(listener, F_GETFL, 0);
+	check_errno(fcntl(listener, F_SETFL, flags | O_NONBLOCK),
+		    "Error while setting listener non blocking");
+
+	// allocate the received requests batch
+	if (batch_recv_alloc(&requests, MAX_BATCH, BUFSIZE) < 0)
+	{
+		print_log(ERROR, "Unable to allocate receive buffers. Quitting.");
+		exit(-1);
+	}
+
+	// create epoll instance
+	epoll_fd = epoll_create1(0);
+	check_errno(epoll_fd, "Error while creating epoll instance");
+
+	// register the listener: a NULL pointer identifies it among sessions
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	check_errno(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &ev),
+		    "Error while registering listener socket");
+
+	// no deadline scheduled yet
+	wheel_init(&timers, get_time_ms());
+
+	// allocate the live transfers table
+	if (table_init(&session_table) < 0)
+	{
+		print_log(ERROR, "Unable to allocate the session table. Quitting.");
+		exit(-1);
+	}
+
+	// hold the base directory and watch it for changes
+	if (meta_init(base_dir) < 0)
+	{
+		print_log(ERROR, "Unable to open the base directory. Quitting.");
+		exit(-1);
+	}
+
+	// transfer latencies
+	latency_init();
+
+	// fill the bandwidth shaper buckets
+	if (shaper_enabled())
+	{
+		shaper_init();
+	}
+
+	// ready events
+	struct epoll_event events[MAX_EVENTS];
+
+	// infinite loop
+	while (1)
+	{
+		// wait for packets up to the earliest retransmission deadline
+		// or shaper round
+		int ready = epoll_wait(epoll_fd, events, MAX_EVENTS,
+				       next_timeout());
+
+		// interrupted by a signal: dump the statistics if requested
+		if (ready < 0 && errno == EINTR)
+		{
+			if (stats_requested)
+			{
+				print_stats();
+			}
+			continue;
+		}
+
+		// check for errors
+		check_errno(ready, "Error while waiting for events");
+
+		// dispatch ready sockets
+		int i;
+		for (i = 0; i < ready; i++)
+		{
+			if (events[i].data.ptr == NULL)
+			{
+				accept_requests();
+			}
+			else
+			{
+				session_receive(events[i].data.ptr);
+				update_session(events[i].data.ptr);
+			}
+		}
+
+		// retransmit timed out packets
+		wheel_advance(&timers, get_time_ms(), expire_session);
+
+		// terminated transfers leave their slots to pending requests
+		start_pending();
+
+		// send the new blocks of the shaped transfers
+		shaper_run(send_flow);
+	}
+}
+
+static void accept_requests()
+{
+	// parsed request
+	Request req;
+
+	// number of requests received with the last call
+	int count = 0;
+
+	// index of the next request to be processed
+	int i = 0;
+
+	// reception time of the last batch, the start of the transfer latency
+	uint64_t received = 0;
+
+	// drain all the requests waiting on the listener
+	while (1)
+	{
+		// all the received requests processed, receive a new batch
+		if (i == count)
+		{
+			count = batch_recv(listener, &requests, MSG_DONTWAIT);
+			received = get_time_us();
+			i = 0;
+
+			// nothing more to read
+			if (count <= 0)
+			{
+				break;
+			}
+		}
+
+		// next received request and its client address
+		struct sockaddr_in cli_addr = requests.addrs[i];
+		int recv_len;
+		char *buffer = batch_packet(&requests, i++, &recv_len);
+
+		// the only valid requests at this point are well formed RRQs
+		// and WRQs
+		if (parse_request(buffer, recv_len, &req) < 0 ||
+		    (req.opcode != OP_RRQ && req.opcode != OP_WRQ))
+		{
+			// print a warning error message
+			print_log(ERROR, "Received invalid request.");
+
+			// handle invalid opcode received
+			send_reject(listener, &cli_addr, ERR_ILLEGAL_OP);
+
+			continue;
+		}
+		req.received = received;
+
+		// files known to be missing are rejected straight away, without
+		// allocating a session
+		if (request_missing(&req))
+		{
+			send_reject(listener, &cli_addr, ERR_NOT_FOUND);
+			continue;
+		}
+
+		// log info of the received message
+		sprintf(log_message,
+			"Received %s for file name: %s and mode: %s.",
+			req.opcode == OP_RRQ ? "RRQ" : "WRQ", req.file_name,
+			req.mode);
+		print_log(INFO, log_message);
+
+		// the client retransmitted the request of a live transfer: the
+		// session keeps serving it from its own socket
+		if (table_lookup(&session_table, &cli_addr, req.file_name) != NULL)
+		{
+			sprintf(log_message, "Duplicate %s absorbed.",
+				req.opcode == OP_RRQ ? "RRQ" : "WRQ");
+			print_log(INFO, log_message);
+			table_count_duplicate(&session_table);
+			continue;
+		}
+
+		// start the session, or queue the request while the server is
+		// saturated
+		switch (admission_request(listener, &req, &cli_addr))
+		{
+		case ADMIT_START:
+			start_session(&req, &cli_addr);
+			break;
+
+		case ADMIT_QUEUED:
+			print_log(INFO, "Server saturated, request queued.");
+			break;
+
+		case ADMIT_DUPLICATE:
+			print_log(INFO, "Duplicate queued request absorbed.");
+			break;
+
+		case ADMIT_BUSY:
+			print_log(ERROR, "Server busy, request refused.");
+			break;
+		}
+	}
+}
+
+static void start_session(const Request *req,
+			  const struct sockaddr_in *cli_addr)
+{
+	// create the transfer session, errors are notified to the client
+	Session *session = session_create(req, cli_addr);
+	if (session == NULL)
+	{
+		admission_done();
+		return;
+	}
+
+	add_session(session);
+	session_start(session);
+	update_session(session);
+}
+
+static void start_pending()
+{
+	Request req;
+	struct sockaddr_in cli_addr;
+	while (admission_next(&req, &cli_addr))
+	{
+		sprintf(log_message, "Starting queued request for file %s.",
+			req.file_name);
+		print_log(INFO, log_message);
+
+		start_session(&req, &cli_addr);
+	}
+}
+
+static void add_session(Session *session)
+{
+	// register the transfer socket in the epoll instance
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = session;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, session->sock, &ev) < 0)
+	{
+		print_log(ERROR, "Error while registering transfer socket.");
+		session->state = SESSION_FAILED;
+	}
+
+	// push the session on the head of the list
+	session->prev = NULL;
+	session->next = sessions;
+	if (sessions != NULL)
+	{
+		sessions->prev = session;
+	}
+	sessions = session;
+	sessions_count++;
+
+	// downloads send their new blocks through the bandwidth shaper
+	if (shaper_enabled() && !session->upload)
+	{
+		shaper_add(&session->flow, &session->cli_addr,
+			   session->blksize + 4, session);
+		session->quota = 0;
+	}
+
+	// index the session by client endpoint and file name
+	if (table_insert(&session_table, &session->cli_addr,
+			 session->file_name, session) < 0)
+	{
+		print_log(ERROR, "Unable to index the transfer session.");
+	}
+}
+
+static void remove_session(Session *session)
+{
+	// unlink the session from the list
+	if (session->prev != NULL)
+	{
+		session->prev->next = session->next;
+	}
+	else
+	{
+		sessions = session->next;
+	}
+	if (session->next != NULL)
+	{
+		session->next->prev = session->prev;
+	}
+	sessions_count--;
+	table_remove(&session_table, &session->cli_addr, session->file_name,
+		     session);
+	admission_done();
+
+	// notify transfer result with log message
+	if (session->state == SESSION_DONE)
+	{
+		sprintf(log_message,
+			"File %s correctly %s the Client. Active transfers: "
+			"%d.", session->file_name, session->upload ?
+			"received from" : "transferred to", sessions_count);
+		print_log(INFO, log_message);
+	}
+
+	// export the round trip times and anomalies of the transfer
+	session_print_stats(session, print_log);
+
+	// no retransmission left
+	timer_cancel(&timers, &session->timer);
+	shaper_remove(&session->flow);
+
+	// closing the socket also removes it from the epoll instance
+	session_destroy(session);
+}
+
+static void update_session(Session *session)
+{
+	// transfer completed or failed
+	if (!session_active(session))
+	{
+		remove_session(session);
+		return;
+	}
+
+	// free window slots are filled by the shaper: nothing to retransmit
+	// until it sends the first of them
+	if (session_throttled(session))
+	{
+		shaper_wake(&session->flow);
+		if (session->in_flight == 0)
+		{
+			timer_cancel(&timers, &session->timer);
+			return;
+		}
+	}
+
+	// re-arm the timer on the deadline of the last packets sent
+	timer_arm(&timers, &session->timer, session->deadline);
+}
+
+static void expire_session(Timer *timer)
+{
+	Session *session = timer->data;
+
+	// retransmit the packets not acknowledged yet, sessions failed while
+	// sending for the shaper are only removed
+	if (session_active(session))
+	{
+		session_timeout(session);
+	}
+	update_session(session);
+}
+
+static int send_flow(Flow *flow, int packets)
+{
+	Session *session = flow->data;
+	int sent = session_send(session, packets);
+
+	// the scheduler still holds the flow: a failed session is removed by
+	// its timer
+	if (!session_active(session))
+	{
+		timer_arm(&timers, &session->timer, 0);
+		return 0;
+	}
+
+	// deadline of the packets just sent, or next paced round
+	if (sent > 0 || session->pace != 0)
+	{
+		timer_arm(&timers, &session->timer, session->deadline);
+	}
+
+	return sent;
+}
+
+static int next_timeout()
+{
+	int timeout = wheel_next_timeout(&timers, get_time_ms());
+	int shaper_timeout = shaper_next_timeout();
+	if (timeout < 0 || (shaper_timeout >= 0 && shaper_timeout < timeout))
+	{
+		timeout = shaper_timeout;
+	}
+
+	return timeout;
+}
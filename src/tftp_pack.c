@@ -0,0 +1,337 @@
+/**
+ * File: tftp_pack.c
+ *       TFTP Serving Archive Packer Source File.
+ *
+ *       Compile using the Provided Makefile.
+ *
+ *       Execute using
+ *          $ ./bin/tftp_pack <base directory> <archive file>
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../include/tftp_pack.h"
+
+/**
+ * Rounds the given offset up to the archive alignment.
+ *
+ * @param  offset  the offset.
+ *
+ * @return  the aligned offset.
+ */
+static uint64_t align_offset(uint64_t offset);
+
+/**
+ * Copies the contents of the given file to the archive at the given offset.
+ *
+ * @param  fd    archive file descriptor;
+ * @param  file  the file to be copied.
+ *
+ * @return  0 on success, -1 if the file can not be read or its size changed.
+ */
+static int copy_file(int fd, const PackedFile *file);
+
+int walk_directory(FileList *list, const char *dir, const char *prefix)
+{
+	DIR *d = opendir(dir);
+	if (d == NULL)
+	{
+		snprintf(log_message, sizeof(log_message), "Unable to open "
+			 "directory %s: errno = %d", dir, errno);
+		print_log(ERROR, log_message);
+		return -1;
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL)
+	{
+		// skip hidden files, temporary uploads and the directory itself
+		if (ent->d_name[0] == '.')
+		{
+			continue;
+		}
+
+		// entry path and name relative to the base directory: longer
+		// names can not be requested
+		char path[4096];
+		char name[512];
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		if (snprintf(name, sizeof(name), "%s%s", prefix,
+			     ent->d_name) >= (int)sizeof(name))
+		{
+			continue;
+		}
+
+		// symbolic links are never followed: they may loop back to a
+		// parent directory or point outside of the base directory
+		struct stat st;
+		if (lstat(path, &st) < 0)
+		{
+			continue;
+		}
+		if (S_ISLNK(st.st_mode))
+		{
+			snprintf(log_message, sizeof(log_message), "Skipping "
+				 "symbolic link %s.", name);
+			print_log(INFO, log_message);
+			continue;
+		}
+
+		// descend into subdirectories
+		if (S_ISDIR(st.st_mode))
+		{
+			char sub_prefix[4096];
+			snprintf(sub_prefix, sizeof(sub_prefix), "%s/", name);
+			if (walk_directory(list, path, sub_prefix) < 0)
+			{
+				closedir(d);
+				return -1;
+			}
+			continue;
+		}
+
+		// only regular files are packed
+		if (!S_ISREG(st.st_mode))
+		{
+			continue;
+		}
+
+		// grow the files array
+		if (list->count == list->capacity)
+		{
+			uint64_t capacity = list->capacity > 0 ?
+					    2 * list->capacity : 64;
+			PackedFile *files = realloc(list->files, capacity *
+						    sizeof(PackedFile));
+			if (files == NULL)
+			{
+				closedir(d);
+				return -1;
+			}
+			list->files = files;
+			list->capacity = capacity;
+		}
+
+		PackedFile *file = &list->files[list->count++];
+		file->name = strdup(name);
+		file->path = strdup(path);
+		file->size = st.st_size;
+		file->offset = 0;
+		if (file->name == NULL || file->path == NULL)
+		{
+			closedir(d);
+			return -1;
+		}
+	}
+
+	closedir(d);
+	return 0;
+}
+
+int write_archive(FileList *list, const char *path)
+{
+	// index at most half full, so that probe sequences stay short
+	uint64_t slots = 16;
+	while (slots < 2 * list->count)
+	{
+		slots *= 2;
+	}
+
+	// layout: header, index, names, then the aligned contents
+	uint64_t index_offset = sizeof(ArchiveHeader);
+	uint64_t names_offset = index_offset + slots * sizeof(ArchiveEntry);
+	uint64_t names_len = 0;
+	uint64_t i;
+	for (i = 0; i < list->count; i++)
+	{
+		names_len += strlen(list->files[i].name);
+	}
+	uint64_t offset = align_offset(names_offset + names_len);
+	for (i = 0; i < list->count; i++)
+	{
+		list->files[i].offset = offset;
+		offset = align_offset(offset + list->files[i].size);
+	}
+
+	// header, index and names are built in memory
+	char *meta = calloc(1, names_offset + names_len);
+	if (meta == NULL)
+	{
+		print_log(ERROR, "Unable to allocate the archive index.");
+		return -1;
+	}
+	ArchiveHeader *header = (ArchiveHeader *)meta;
+	header->magic = ARCHIVE_MAGIC;
+	header->version = ARCHIVE_VERSION;
+	header->align = ARCHIVE_ALIGN;
+	header->count = list->count;
+	header->index_size = slots;
+	header->index_offset = index_offset;
+	header->size = offset;
+
+	ArchiveEntry *index = (ArchiveEntry *)(meta + index_offset);
+	uint64_t name_offset = names_offset;
+	for (i = 0; i < list->count; i++)
+	{
+		const PackedFile *file = &list->files[i];
+		uint32_t len = strlen(file->name);
+		uint32_t hash = archive_hash(file->name, len);
+
+		// linear probing from the home slot
+		uint64_t slot = hash & (slots - 1);
+		while (index[slot].name_len > 0)
+		{
+			slot = (slot + 1) & (slots - 1);
+		}
+		index[slot].hash = hash;
+		index[slot].name_len = len;
+		index[slot].name_offset = name_offset;
+		index[slot].offset = file->offset;
+		index[slot].size = file->size;
+
+		memcpy(meta + name_offset, file->name, len);
+		name_offset += len;
+	}
+
+	// write a temporary archive first: a running server may be mapping
+	// the previous one
+	char temp[4096];
+	snprintf(temp, sizeof(temp), "%s.%d.tmp", path, getpid());
+	int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		snprintf(log_message, sizeof(log_message), "Unable to create "
+			 "the archive %s: errno = %d", path, errno);
+		print_log(ERROR, log_message);
+		free(meta);
+		return -1;
+	}
+
+	// size the archive, the alignment padding stays sparse
+	int failed = ftruncate(fd, offset) < 0 ||
+		     pwrite(fd, meta, names_offset + names_len, 0) !=
+		     (ssize_t)(names_offset + names_len);
+	free(meta);
+
+	// copy the file contents
+	for (i = 0; i < list->count && !failed; i++)
+	{
+		failed = copy_file(fd, &list->files[i]) < 0;
+	}
+
+	// the archive must be complete on disk before replacing the old one
+	if (failed || fsync(fd) < 0 || close(fd) < 0 || rename(temp, path) < 0)
+	{
+		sprintf(log_message, "Error while writing the archive: errno = "
+			"%d", errno);
+		print_log(ERROR, log_message);
+		unlink(temp);
+		return -1;
+	}
+
+	snprintf(log_message, sizeof(log_message), "Packed %llu files in %s: "
+		 "%llu bytes, index of %llu slots.",
+		 (unsigned long long)list->count, path,
+		 (unsigned long long)offset, (unsigned long long)slots);
+	print_log(INFO, log_message);
+
+	return 0;
+}
+
+static uint64_t align_offset(uint64_t offset)
+{
+	return (offset + ARCHIVE_ALIGN - 1) & ~(uint64_t)(ARCHIVE_ALIGN - 1);
+}
+
+static int copy_file(int fd, const PackedFile *file)
+{
+	int src = open(file->path, O_RDONLY);
+	if (src < 0)
+	{
+		snprintf(log_message, sizeof(log_message), "Unable to open %s: "
+			 "errno = %d", file->path, errno);
+		print_log(ERROR, log_message);
+		return -1;
+	}
+
+	// copy the file in large chunks
+	static char chunk[1024 * 1024];
+	uint64_t done = 0;
+	while (1)
+	{
+		ssize_t ret = read(src, chunk, sizeof(chunk));
+		if (ret < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (ret <= 0 || done + ret > file->size)
+		{
+			if (ret == 0 && done == file->size)
+			{
+				break;
+			}
+
+			// the file changed since it was found
+			snprintf(log_message, sizeof(log_message), "Error "
+				 "while reading %s, changed while being "
+				 "packed.", file->path);
+			print_log(ERROR, log_message);
+			close(src);
+			return -1;
+		}
+
+		if (pwrite(fd, chunk, ret, file->offset + done) != ret)
+		{
+			close(src);
+			return -1;
+		}
+		done += ret;
+	}
+
+	close(src);
+	return 0;
+}
+
+/**
+ * Entry point.
+ *
+ * @param  argc  command line arguments counter.
+ * @param  argv  command line arguments.
+ *
+ * @return  execution exit code.
+ */
+int main(int argc, char *argv[])
+{
+	// check if the base directory and archive arguments were provided
+	if (argc != 3)
+	{
+		print_log(ERROR, "Invalid number of arguments. "
+			  "Usage: tftp_pack <base directory> <archive file>. "
+			  "Quitting.");
+
+		return -1;
+	}
+
+	// find all the files to be packed
+	FileList list;
+	memset(&list, 0, sizeof(list));
+	if (walk_directory(&list, argv[1], "") < 0)
+	{
+		return -1;
+	}
+
+	// write the archive
+	if (write_archive(&list, argv[2]) < 0)
+	{
+		return -1;
+	}
+
+	return 0;
+}
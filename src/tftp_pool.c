@@ -0,0 +1,356 @@
+/**
+ * File: tftp_pool.c
+ *       TFTP Server Transfer Pool Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/prctl.h>
+
+#include "../include/tftp_server.h"
+#include "../include/tftp_pool.h"
+
+int pool_size = 0;
+
+/**
+ * Transfer processes of the pool.
+ */
+static PoolProcess pool[POOL_MAX];
+
+/**
+ * Spawns the transfer process of the given pool slot.
+ *
+ * @param  index  the pool slot.
+ */
+static void spawn_process(int index);
+
+/**
+ * Main loop of a transfer process: serves the jobs received on the given
+ * socket until the listener terminates.
+ *
+ * @param  sock  transfer process end of the socket pair.
+ */
+static void serve_jobs(int sock);
+
+/**
+ * Receives a job together with the file descriptor passed with it.
+ *
+ * @param  sock  transfer process end of the socket pair;
+ * @param  job   the job to be filled;
+ * @param  fd    the passed descriptor to be set, -1 if none.
+ *
+ * @return  the received length, 0 if the listener terminated, -1 in case of
+ *          error.
+ */
+static ssize_t receive_job(int sock, PoolJob *job, int *fd);
+
+/**
+ * Releases the transfer of the given pool slot.
+ *
+ * @param  index  the pool slot.
+ */
+static void release_process(int index);
+
+void pool_start()
+{
+	int i;
+	for (i = 0; i < pool_size; i++)
+	{
+		pool[i].sock = -1;
+		spawn_process(i);
+	}
+
+	sprintf(log_message, "Transfer pool of %d processes started.",
+		pool_size);
+	print_log(INFO, log_message);
+}
+
+int pool_dispatch(const Request *req, const struct sockaddr_in *cli_addr,
+		  int fd, uint64_t size)
+{
+	// first idle process
+	int i;
+	for (i = 0; i < pool_size; i++)
+	{
+		if (!pool[i].busy && pool[i].sock >= 0)
+		{
+			break;
+		}
+	}
+	if (i == pool_size)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return -1;
+	}
+
+	// job message
+	PoolJob job;
+	job.req = *req;
+	job.cli_addr = *cli_addr;
+	job.size = size;
+
+	struct iovec iov;
+	iov.iov_base = &job;
+	iov.iov_len = sizeof(job);
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	// the file descriptor travels as ancillary data
+	char control[CMSG_SPACE(sizeof(int))];
+	if (fd >= 0)
+	{
+		memset(control, 0, sizeof(control));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	ssize_t sent = sendmsg(pool[i].sock, &msg, MSG_NOSIGNAL);
+
+	// the transfer process holds its own copy of the descriptor
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+
+	if (sent != sizeof(job))
+	{
+		sprintf(log_message, "Error while handing the transfer to the "
+			"pool process %d: errno = %d", pool[i].pid, errno);
+		print_log(ERROR, log_message);
+		return -1;
+	}
+
+	// keep track of the transfer until the process reports back
+	pool[i].busy = 1;
+	pool[i].job = job;
+	if (table_insert(&session_table, cli_addr, req->file_name,
+			 (void *)(intptr_t)pool[i].pid) < 0)
+	{
+		print_log(ERROR, "Unable to track the transfer.");
+	}
+
+	return 0;
+}
+
+int pool_poll_fds(struct pollfd *fds)
+{
+	int i;
+	for (i = 0; i < pool_size; i++)
+	{
+		fds[i].fd = pool[i].sock;
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+
+	return pool_size;
+}
+
+void pool_collect(const struct pollfd *fds, int count)
+{
+	int i;
+	for (i = 0; i < count; i++)
+	{
+		if (!(fds[i].revents & POLLIN) || fds[i].fd != pool[i].sock)
+		{
+			continue;
+		}
+
+		// completion report: the process is idle again
+		char done;
+		if (recv(pool[i].sock, &done, sizeof(done), MSG_DONTWAIT) > 0 &&
+		    pool[i].busy)
+		{
+			release_process(i);
+		}
+	}
+}
+
+int pool_reaped(pid_t pid)
+{
+	int i;
+	for (i = 0; i < pool_size; i++)
+	{
+		if (pool[i].pid != pid)
+		{
+			continue;
+		}
+
+		sprintf(log_message, "Pool process %d terminated unexpectedly. "
+			"Restarting it.", pid);
+		print_log(ERROR, log_message);
+
+		// its transfer is lost
+		if (pool[i].busy)
+		{
+			release_process(i);
+		}
+
+		spawn_process(i);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void spawn_process(int index)
+{
+	// drop the socket pair of the previous process
+	if (pool[index].sock >= 0)
+	{
+		close(pool[index].sock);
+		pool[index].sock = -1;
+	}
+	pool[index].busy = 0;
+	pool[index].pid = -1;
+
+	// message boundaries are preserved, one job per message
+	int socks[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, socks) < 0)
+	{
+		sprintf(log_message, "Unable to create the pool socket pair: "
+			"errno = %d", errno);
+		print_log(ERROR, log_message);
+		return;
+	}
+
+	// create a new process by duplicating the calling process
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		sprintf(log_message, "Unable to create a pool process: errno = "
+			"%d", errno);
+		print_log(ERROR, log_message);
+		close(socks[0]);
+		close(socks[1]);
+		return;
+	}
+
+	// listener: keep track of the process
+	if (pid > 0)
+	{
+		close(socks[1]);
+		pool[index].pid = pid;
+		pool[index].sock = socks[0];
+		return;
+	}
+
+	// terminate the process together with its listener
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+	// drop the listener state, the other processes sockets included
+	close(socks[0]);
+	detach_child();
+	int i;
+	for (i = 0; i < pool_size; i++)
+	{
+		if (pool[i].sock >= 0)
+		{
+			close(pool[i].sock);
+		}
+	}
+
+	// files opened by the transfer process itself are never cached:
+	// changes can not be noticed anymore
+	meta_flush();
+
+	serve_jobs(socks[1]);
+	exit(0);
+}
+
+static void serve_jobs(int sock)
+{
+	while (1)
+	{
+		// wait for the next transfer
+		PoolJob job;
+		int fd;
+		ssize_t len = receive_job(sock, &job, &fd);
+
+		// the listener terminated
+		if (len == 0)
+		{
+			return;
+		}
+
+		// interrupted by a signal or malformed job
+		if (len != sizeof(job))
+		{
+			if (len < 0 && errno != EINTR)
+			{
+				return;
+			}
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+			continue;
+		}
+
+		// drive the transfer until completion
+		serve_transfer(&job.req, &job.cli_addr, fd, job.size);
+
+		// ready for the next job
+		char done = 1;
+		if (send(sock, &done, sizeof(done), MSG_NOSIGNAL) < 0)
+		{
+			return;
+		}
+	}
+}
+
+static ssize_t receive_job(int sock, PoolJob *job, int *fd)
+{
+	*fd = -1;
+
+	struct iovec iov;
+	iov.iov_base = job;
+	iov.iov_len = sizeof(PoolJob);
+
+	char control[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	if (len < 0)
+	{
+		return -1;
+	}
+
+	// retrieve the passed descriptor, if any
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+	    cmsg->cmsg_type == SCM_RIGHTS)
+	{
+		memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+
+	return len;
+}
+
+static void release_process(int index)
+{
+	pool[index].busy = 0;
+	table_remove(&session_table, &pool[index].job.cli_addr,
+		     pool[index].job.req.file_name,
+		     (void *)(intptr_t)pool[index].pid);
+	admission_done();
+}
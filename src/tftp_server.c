@@ -5,13 +5,214 @@
  *       Compile using the Provided Makefile.
  *
  *       Execute using
- *          $ ./bin/tftp_server <port> <base directory>
+ *          $ ./bin/tftp_server [options] <port> <base directory>
  * 
  * Author: Rambod Rahmani <rambodrahmani@autistici.org>
  *         Created on 21/10/2019.
  */
 
+#define _GNU_SOURCE
+
+#include <poll.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <sys/signalfd.h>
+
 #include "../include/tftp_server.h"
+#include "../include/tftp_event.h"
+#include "../include/tftp_workers.h"
+#include "../include/tftp_pool.h"
+#include "../include/batch_io.h"
+
+char *base_dir;
+
+int listener;
+
+int fork_mode = 0;
+
+SourceType source_type = SOURCE_PREAD;
+
+Archive archive;
+
+SessionTable session_table;
+
+volatile sig_atomic_t stats_requested = 0;
+
+/**
+ * SIGUSR1 handler: the statistics are printed by the main loop, outside of the
+ * signal handler.
+ *
+ * @param  sig  received signal.
+ */
+static void request_stats(int sig)
+{
+	// the signal number is not needed, SIGUSR1 is the only one handled
+	(void)sig;
+
+	stats_requested = 1;
+}
+
+void print_stats()
+{
+	stats_requested = 0;
+
+	// print info log message
+	sprintf(log_message, "Statistics of process %d:", getpid());
+	print_log(INFO, log_message);
+
+	// socket batching counters
+	batch_print_stats(print_log);
+
+	// transfer slots and pending requests
+	admission_print_stats(print_log);
+
+	// startup cost of the transfers
+	latency_print_stats(print_log);
+
+	// bandwidth shaper counters, only the event loop shapes transfers
+	if (shaper_enabled() && !fork_mode)
+	{
+		shaper_print_stats(print_log);
+	}
+
+	// open files kept by the metadata cache
+	if (meta_cache.dir_fd >= 0)
+	{
+		meta_print_stats(print_log);
+	}
+
+	// block cache counters, used to size its budget
+	if (source_type == SOURCE_CACHE)
+	{
+		cache_print_stats(print_log);
+	}
+
+	// live transfers index, once the main loop allocated it
+	if (session_table.entries != NULL)
+	{
+		table_print_stats(&session_table, print_log);
+	}
+}
+
+/**
+ * SIGCHLD notifications of the fork-per-request listener, -1 if not created.
+ */
+static int child_fd = -1;
+
+/**
+ * Number of buckets of the forked children index (power of 2).
+ */
+#define CHILD_BUCKETS 1024
+
+/**
+ * A transfer served by a forked child process, along with its session table
+ * key.
+ */
+typedef struct Child {
+	pid_t pid;			// child process id
+	struct sockaddr_in cli_addr;	// client address
+	char file_name[512];		// requested file name
+	struct Child *next;		// next child of the same bucket
+} Child;
+
+/**
+ * Forked children indexed by process id, so that a terminated child is
+ * removed from the session table by key.
+ */
+static Child *children[CHILD_BUCKETS];
+
+/**
+ * Keeps track of the transfer served by the given child process until it
+ * terminates.
+ *
+ * @param  pid        child process id;
+ * @param  cli_addr   client address;
+ * @param  file_name  requested file name.
+ */
+static void track_child(pid_t pid, const struct sockaddr_in *cli_addr,
+			const char *file_name)
+{
+	Child *child = malloc(sizeof(Child));
+	if (child == NULL || table_insert(&session_table, cli_addr, file_name,
+					  (void *)(intptr_t)pid) < 0)
+	{
+		free(child);
+		print_log(ERROR, "Unable to track the transfer.");
+		return;
+	}
+
+	child->pid = pid;
+	child->cli_addr = *cli_addr;
+	strcpy(child->file_name, file_name);
+
+	Child **bucket = &children[pid & (CHILD_BUCKETS - 1)];
+	child->next = *bucket;
+	*bucket = child;
+}
+
+/**
+ * Removes the transfer of the given terminated child process from the session
+ * table, if it was tracked.
+ *
+ * @param  pid  child process id.
+ */
+static void untrack_child(pid_t pid)
+{
+	Child **link = &children[pid & (CHILD_BUCKETS - 1)];
+	while (*link != NULL && (*link)->pid != pid)
+	{
+		link = &(*link)->next;
+	}
+
+	if (*link != NULL)
+	{
+		Child *child = *link;
+		*link = child->next;
+		table_remove(&session_table, &child->cli_addr, child->file_name,
+			     (void *)(intptr_t)pid);
+		free(child);
+	}
+}
+
+/**
+ * Reaps the terminated child processes, removes their transfers from the
+ * session table and releases their transfer slots.
+ */
+static void reap_children()
+{
+	pid_t pid;
+	while ((pid = waitpid(-1, NULL, WNOHANG)) > 0)
+	{
+		// pool processes are spawned again
+		if (pool_reaped(pid))
+		{
+			continue;
+		}
+
+		untrack_child(pid);
+		admission_done();
+	}
+}
+
+/**
+ * Hands the given admitted request to the transfer pool, or forks the child
+ * process serving it. If the transfer can not be started the client is sent a
+ * busy error message and the transfer slot is released.
+ *
+ * @param  req       the admitted request;
+ * @param  cli_addr  address of the client requesting the file transfer;
+ * @param  fd        descriptor of the requested file opened by the listener,
+ *                   closed once handed to the transfer, or -1 to open it;
+ * @param  st        metadata of the requested file, if opened.
+ */
+static void start_transfer(const Request *req,
+			   const struct sockaddr_in *cli_addr, int fd,
+			   const struct stat *st);
+
+/**
+ * Starts the pending requests while transfer slots are free.
+ */
+static void start_pending();
 
 int createUDPSocket(int port)
 {
@@ -87,77 +288,188 @@ void listen_for_packets()
 	// incoming message buffer
 	char buffer[BUFSIZE];
 
-	// received file name
-	char file_name[512];
+	// parsed request
+	Request req;
 
-	// received transfer mode
-	char mode[10];
+	// allocate the live transfers table
+	if (table_init(&session_table) < 0)
+	{
+		print_log(ERROR, "Unable to allocate the session table. Quitting.");
+		exit(-1);
+	}
+
+	// hold the base directory and watch it for changes
+	if (meta_init(base_dir) < 0)
+	{
+		print_log(ERROR, "Unable to open the base directory. Quitting.");
+		exit(-1);
+	}
 
-	// received opcode
-	uint16_t opcode;
+	// transfer latencies, recorded by the children as well
+	latency_init();
+
+	// terminated children are reaped as soon as they exit: SIGCHLD is
+	// read from a descriptor polled together with the listener
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	check_errno(sigprocmask(SIG_BLOCK, &mask, NULL),
+		    "Error while blocking SIGCHLD");
+	child_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	check_errno(child_fd, "Error while creating SIGCHLD descriptor");
+
+	// transfer processes spawned once for all
+	if (pool_size > 0)
+	{
+		pool_start();
+	}
 
-	// process fork id
-	pid_t fork_id;
+	// listener, SIGCHLD descriptor and transfer pool sockets
+	struct pollfd fds[2 + POOL_MAX];
+	fds[0].fd = listener;
+	fds[0].events = POLLIN;
+	fds[1].fd = child_fd;
+	fds[1].events = POLLIN;
 
 	// infinite loop
 	while (1) {
 		// print info log message
 		print_log(INFO, "Listening for incoming packets.");
 
+		// wait for a packet, a terminated child or a completed transfer
+		int pooled = pool_poll_fds(fds + 2);
+		int ready = poll(fds, 2 + pooled, -1);
+
+		// interrupted by a signal: dump the statistics if requested
+		if (ready < 0 && errno == EINTR)
+		{
+			if (stats_requested)
+			{
+				print_stats();
+			}
+			continue;
+		}
+
+		// check for errors
+		check_errno(ready, "Error while waiting for packets");
+
+		// terminated transfers leave their slots to pending requests
+		if (fds[1].revents & POLLIN)
+		{
+			struct signalfd_siginfo info;
+			while (read(child_fd, &info, sizeof(info)) > 0)
+			{
+			}
+			reap_children();
+			start_pending();
+		}
+
+		// transfers completed by the pool processes
+		if (pooled > 0)
+		{
+			pool_collect(fds + 2, pooled);
+			start_pending();
+		}
+
+		// no packet received
+		if (!(fds[0].revents & POLLIN))
+		{
+			continue;
+		}
+
 		// recieve the data
 		recv_len =
 		    recvfrom(listener, (char *)buffer, BUFSIZE, MSG_WAITALL,
 			     &cli_addr, (socklen_t *) &cli_size);
 
+		// interrupted by a signal: dump the statistics if requested
+		if (recv_len < 0 && errno == EINTR)
+		{
+			if (stats_requested)
+			{
+				print_stats();
+			}
+			continue;
+		}
+
 		// check for errors
 		check_errno(recv_len, "Error while listening for packets");
 
-		// retrieve opcode
-		memcpy(&opcode, (uint16_t *) & buffer, 2);
-		opcode = ntohs(opcode);
+		// reception time, the start of the transfer latency
+		uint64_t received = get_time_us();
 
-		// retrieve file name
-		strcpy(file_name, buffer + 2);
+		// retrieve opcode, file name and transfer mode
+		if (parse_request(buffer, recv_len, &req) < 0)
+		{
+			// malformed request, handled as an invalid opcode
+			req.opcode = 0;
+			req.file_name[0] = '\0';
+			req.mode[0] = '\0';
+		}
+		req.received = received;
 
-		// retrieve transfer mode
-		strcpy(mode, buffer + 3 + strlen(file_name));
+		// files known to be missing are rejected straight away
+		if (request_missing(&req))
+		{
+			handle_file_not_found(listener, cli_addr);
+			continue;
+		}
 
 		// log info of the received message
 		sprintf(log_message,
 			"Received opcode: %d, file name: %s and mode: %s.",
-			opcode, file_name, mode);
+			req.opcode, req.file_name, req.mode);
 		print_log(INFO, log_message);
 
-		// the only valid opcode at this point is 1 (RRQ)
-		if (opcode != 1)
+		// the only valid opcodes at this point are 1 (RRQ) and 2 (WRQ)
+		if (req.opcode != OP_RRQ && req.opcode != OP_WRQ)
 		{
 			// print a warning error message
 			sprintf(log_message, "Received invalid opcode: %d.",
-				opcode);
+				req.opcode);
 			print_log(ERROR, log_message);
 
 			// handle invalid opcode received
 			handle_invalid_opcode(cli_addr);
-		}
 
-		// requested file full path
-		char *path = malloc(strlen(base_dir) + strlen(file_name) + 1);
+			// loop again
+			continue;
+		}
 
-		// setup requested file full path
-		strcpy(path, base_dir);
-		strcat(path, "/");
-		strcat(path, file_name);
+		// the client retransmitted the request of a live transfer
+		if (table_lookup(&session_table, (struct sockaddr_in *)&cli_addr,
+				 req.file_name) != NULL)
+		{
+			sprintf(log_message, "Duplicate %s absorbed.",
+				req.opcode == OP_RRQ ? "RRQ" : "WRQ");
+			print_log(INFO, log_message);
+			table_count_duplicate(&session_table);
+			continue;
+		}
 
-		// check if the file actually exists
-		if (access(path, F_OK) != -1)
+		// check if the file actually exists: uploads create it, a
+		// served archive is looked up without touching the file system,
+		// otherwise the file is opened relative to the base directory
+		// and handed to the transfer
+		int found = req.opcode == OP_WRQ;
+		int fd = -1;
+		struct stat st;
+		if (!found && archive.map != NULL)
 		{
-			// file exists, nothing to do
+			found = archive_lookup(&archive, req.file_name) != NULL;
 		}
-		else
+		else if (!found)
+		{
+			fd = meta_open(req.file_name, &st);
+			found = fd >= 0;
+		}
+
+		if (!found)
 		{
 			// file doesn't exist, print an error log message
 			sprintf(log_message,
-				"Unable to open the requested file: %s.", path);
+				"Unable to open the requested file: %s.",
+				req.file_name);
 			print_log(ERROR, log_message);
 
 			// send error message to the client
@@ -167,530 +479,567 @@ void listen_for_packets()
 			continue;
 		}
 
-		// create a new process by duplicating the calling process
-		fork_id = fork();
-
-		// on success, the PID of the child process is returned in the parent,
-		// and 0 is returned in the child.  On failure, -1 is returned in the
-		// parent, no child process is created, and errno is set appropriately
-		if (fork_id == 0)	// child process
+		// start the transfer, or queue it while the server is saturated
+		switch (admission_request(listener, &req,
+					  (struct sockaddr_in *)&cli_addr))
 		{
-			handle_transfer(mode, cli_addr, file_name);
+		case ADMIT_START:
+			start_transfer(&req, (struct sockaddr_in *)&cli_addr,
+				       fd, &st);
+			fd = -1;
+			break;
+
+		case ADMIT_QUEUED:
+			print_log(INFO, "Server saturated, request queued.");
+			break;
+
+		case ADMIT_DUPLICATE:
+			print_log(INFO, "Duplicate queued request absorbed.");
+			break;
+
+		case ADMIT_BUSY:
+			print_log(ERROR, "Server busy, request refused.");
+			break;
 		}
-		else if (fork_id > 0)	// parent process
+
+		// queued requests open the file again once started
+		if (fd >= 0)
 		{
-			// just clear the buffer before looping again
-			memset(buffer, 0, BUFSIZE);
+			close(fd);
 		}
-		else if (fork_id < 0)	// fork() error
-		{
-			// print a warning error log message
-			print_log(ERROR,
-				  "Error while creating child process for "
-				  "client. Quitting.");
 
-			// exit wirh error
-			exit(-1);
-		}
+		// just clear the buffer before looping again
+		memset(buffer, 0, BUFSIZE);
 	}
 }
 
-void handle_transfer(char mode[10], struct sockaddr cli_addr,
-		     char file_name[512])
+static void start_transfer(const Request *req,
+			   const struct sockaddr_in *cli_addr, int fd,
+			   const struct stat *st)
 {
-	// requested file full path
-	char *path = malloc(strlen(base_dir) + strlen(file_name) + 1);
-
-	// set requested file full path
-	strcpy(path, base_dir);
-	strcat(path, "/");
-	strcat(path, file_name);
-
-	// incoming message buffer
-	char buffer[BUFSIZE];
-
-	// clear the buffer
-	memset(buffer, 0, BUFSIZE);
-
-	// new socket to be used to send data packets
-	int data_sock = socket(AF_INET, SOCK_DGRAM, 0);
-
-	// check if the socket was correctly created
-	check_errno(data_sock, "Error while creating child process socket");
-
-	// source file pointer
-	FILE *src_file;
-
-	// check requested transfer mode
-	if (strncmp(mode, "netascii", 8) == 0)	// TEXT MODE
+	// the file is opened once by the listener, relative to the base
+	// directory, and its descriptor handed to the transfer
+	struct stat opened;
+	if (fd < 0 && req->opcode == OP_RRQ && archive.map == NULL)
 	{
-		// print an info log message
-		child_log(INFO, "Starting File Transfer in TEXT mode.");
-
-		// open file as text file
-		src_file = fopen(path, "r");
-
-		// check if the file was correctly opened
-		if (src_file == NULL)
+		st = &opened;
+		fd = meta_open(req->file_name, &opened);
+		if (fd < 0)
 		{
-			// if not, print a warning log message
-			child_log(ERROR,
-				  "Error while opening transfer file. Transfer Cancelled.");
-
-			// send error message to the client
-			handle_file_not_found(data_sock, cli_addr);
-
-			// loop again
+			send_reject(listener, cli_addr, ERR_NOT_FOUND);
+			admission_done();
 			return;
 		}
-		else
+	}
+	uint64_t size = fd >= 0 ? (uint64_t)st->st_size : 0;
+
+	// no process creation on the critical path with a transfer pool: the
+	// descriptor is passed to the process, and closed here
+	if (pool_size > 0)
+	{
+		if (pool_dispatch(req, cli_addr, fd, size) < 0)
 		{
-			text_mode_transfer(src_file, data_sock, cli_addr);
+			send_reject(listener, cli_addr, ERR_UNDEFINED);
+			admission_done();
 		}
+		return;
 	}
-	else if (strncmp(mode, "octet", 5) == 0)	// BINARY MODE
+
+	// add the requested file to the block cache before forking: the
+	// children load and read its contents in the shared mapping, the file
+	// is loaded only once
+	CachedFile *cached = NULL;
+	if (source_type == SOURCE_CACHE && fd >= 0)
 	{
-		// print an info log message
-		child_log(INFO, "Starting File Transfer in BINARY mode.");
+		// requested file full path, the block cache key
+		char path[BUFSIZE];
+		snprintf(path, sizeof(path), "%s/%s", base_dir, req->file_name);
+		cached = cache_acquire(fd, path, strcasecmp(req->mode,
+				       "netascii") == 0);
+	}
 
-		// open file as non-text file
-		src_file = fopen(path, "rb");
+	// create a new process by duplicating the calling process
+	pid_t fork_id = fork();
 
-		// check if the file was correctly opened
-		if (src_file == NULL) {
-			// if not, print a warning log message
-			child_log(ERROR,
-				  "Error while opening transfer file. Transfer Cancelled.");
+	// the children keep their own copy of the reference and of the
+	// descriptor
+	if (fork_id != 0 && cached != NULL)
+	{
+		cache_release(cached);
+	}
+	if (fork_id != 0 && fd >= 0)
+	{
+		close(fd);
+	}
 
-			// send error message to the client
-			handle_file_not_found(data_sock, cli_addr);
+	// on success, the PID of the child process is returned in the parent,
+	// and 0 is returned in the child.  On failure, -1 is returned in the
+	// parent, no child process is created, and errno is set appropriately
+	if (fork_id == 0)	// child process
+	{
+		// the child reads the file opened by its parent
+		detach_child();
 
-			// loop again
-			return;
-		}
-		else
-		{
-			binary_mode_transfer(src_file, data_sock, cli_addr);
-		}
+		struct sockaddr addr;
+		memcpy(&addr, cli_addr, sizeof(addr));
+		handle_transfer(req, addr, fd, size);
+	}
+	else if (fork_id > 0)	// parent process
+	{
+		// keep track of the transfer until the child terminates
+		track_child(fork_id, cli_addr, req->file_name);
 	}
+	else if (fork_id < 0)	// fork() error
+	{
+		// the listener keeps serving: the client may retry later
+		sprintf(log_message, "Error while creating child process for "
+			"client: errno = %d", errno);
+		print_log(ERROR, log_message);
 
-	// file transfer completed, clear transfer buffer
-	memset(buffer, 0, BUFSIZE);
+		send_reject(listener, cli_addr, ERR_UNDEFINED);
+		admission_done();
+	}
+}
 
-	// close source file
-	fclose(src_file);
+static void start_pending()
+{
+	Request req;
+	struct sockaddr_in cli_addr;
+	while (admission_next(&req, &cli_addr))
+	{
+		sprintf(log_message, "Starting queued request for file %s.",
+			req.file_name);
+		print_log(INFO, log_message);
 
-	// shutdown transfer socket
-	shutdown(data_sock, SHUT_RDWR);
+		start_transfer(&req, &cli_addr, -1, NULL);
+	}
+}
 
-	// close transfer socket
-	close(data_sock);
+int request_missing(const Request *req)
+{
+	// uploads create the file
+	if (req->opcode != OP_RRQ)
+	{
+		return 0;
+	}
 
-	// notify file transfer completed with log message
-	sprintf(log_message,
-		"File %s correctly transferred to the Client.", file_name);
-	child_log(INFO, log_message);
+	// a served archive holds all the files
+	if (archive.map != NULL)
+	{
+		return archive_lookup(&archive, req->file_name) == NULL;
+	}
 
-	// kill child process
-	exit(0);
+	return meta_missing(req->file_name);
 }
 
-void text_mode_transfer(FILE * src_file, int data_sock,
-			struct sockaddr cli_addr)
+void detach_child()
 {
-	// incoming message buffer
-	char buffer[BUFSIZE];
-
-	// message opcode
-	uint16_t opcode;
+	// the child does not supervise anything
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_UNBLOCK, &mask, NULL);
+	if (child_fd >= 0)
+	{
+		close(child_fd);
+		child_fd = -1;
+	}
 
-	// received message length
-	int recv_len;
+	// file changes are noticed by the listener only
+	meta_detach();
+}
 
-	// client address length
-	size_t cli_size = sizeof(cli_addr);
+int serve_transfer(const Request *req, const struct sockaddr_in *cli_addr,
+		   int fd, uint64_t size)
+{
+	// create the transfer session: opens the file and the transfer socket
+	Session *session = session_create_fd(req, cli_addr, fd, size);
 
-	// single char store buffer
-	char c;
+	// errors were already notified to the client
+	if (session == NULL)
+	{
+		child_log(ERROR, "Transfer Cancelled.");
+		return 0;
+	}
 
-	// chars counter: the first 4 bytes of the transfer buffer
-	// must be left empty for the opcode and block number
-	int i = 4;
+	// print an info log message
+	if (session->text_mode)
+	{
+		child_log(INFO, "Starting File Transfer in TEXT mode.");
+	}
+	else
+	{
+		child_log(INFO, "Starting File Transfer in BINARY mode.");
+	}
 
-	// data transfer blocks counter
-	uint16_t block_counter = 1;
+	// drive the transfer until completion
+	session_run(session);
 
-	// until the EOF is found in the opened file
-	do {
-		// retrieve next char from the source file
-		c = fgetc(src_file);
+	// retrieve transfer result
+	int done = session->state == SESSION_DONE;
 
-		// avoid adding the EOF to the transfer buffer
-		if (c != EOF)
-		{
-			// copy retrieved char in the transfer buffer
-			buffer[i] = c;
+	// notify file transfer result with log message
+	if (done)
+	{
+		sprintf(log_message, "File %s correctly %s the Client.",
+			req->file_name, session->upload ? "received from" :
+			"transferred to");
+		child_log(INFO, log_message);
+	}
 
-			// increase chars counter
-			i++;
-		}
+	// export the round trip times and anomalies of the transfer
+	session_print_stats(session, child_log);
 
-		// check if either the maximum number of chars or the
-		// EOF has been reached
-		if (i == MAX + 4 || c == EOF)
-		{
-			// if so, send the data message to the client
-			// opcode = 3 (= DATA)
-			opcode = htons(3);
-
-			// prepare block number
-			uint16_t block = htons(block_counter);
-
-			// copy opcode to the transfer buffer
-			memcpy(buffer, &opcode, 2);
-
-			// copy block_number to the transfer buffer
-			memcpy(buffer + 2, &block, 2);
-
-			// send transfer buffer to the client
-			recv_len =
-			    sendto(data_sock,
-				   buffer,
-				   i,
-				   MSG_CONFIRM,
-				   (const struct sockaddr *) &cli_addr,
-				   sizeof(cli_addr));
-
-			// check for errors
-			check_errno(recv_len,
-				    "Error while sending data packet in text mode");
-
-			// if debugging is enabled
-			if (DEBUG)
-			{
-				// print debugging info log message
-				sprintf
-				    (log_message,
-				     "Data packet with block number %d sent. Waiting "
-				     "to receive ACK response.", block_counter);
-				child_log(INFO, log_message);
-			}
+	// close source file and transfer socket
+	session_destroy(session);
 
-			// clear transfer buffer
-			memset(buffer, 0, BUFSIZE);
+	return done;
+}
 
-			// wait for ACK response from the client
-			recv_len = recvfrom(data_sock, (char *)
-					    buffer,
-					    BUFSIZE,
-					    MSG_WAITALL, (struct sockaddr *)
-					    &cli_addr,
-					    (socklen_t *) & cli_size);
+void handle_transfer(const Request *req, struct sockaddr cli_addr, int fd,
+		     uint64_t size)
+{
+	// drive the transfer until completion
+	int done = serve_transfer(req, (struct sockaddr_in *)&cli_addr, fd,
+				  size);
 
-			// check for errors
-			check_errno(recv_len,
-				    "Error while receiving ACK packet.");
+	// kill child process
+	exit(done ? 0 : -1);
+}
 
-			// retrieve block number from transfer buffer
-			memcpy(&block, (uint16_t *) & buffer[2], 2);
+void handle_invalid_opcode(struct sockaddr cli_addr)
+{
+	// send the prebuilt error message (4 = Illegal TFTP operation)
+	send_reject(listener, (struct sockaddr_in *)&cli_addr, ERR_ILLEGAL_OP);
+}
 
-			// deserialize block number
-			block = ntohs(block);
+void handle_file_not_found(int socket, struct sockaddr cli_addr)
+{
+	// send the prebuilt error message (1 = File not found)
+	send_reject(socket, (struct sockaddr_in *)&cli_addr, ERR_NOT_FOUND);
+}
 
-			// if debugging is enabled
-			if (DEBUG)
+/**
+ * Entry point.
+ *
+ * @param  argc  command line arguments counter.
+ * @param  argv  command line arguments.
+ *
+ * @return  execution exit code.
+ */
+int main(int argc, char *argv[])
+{
+	// available command line options
+	static struct option long_options[] = {
+		{"fork", no_argument, NULL, 'f'},
+		{"workers", required_argument, NULL, 'w'},
+		{"source", required_argument, NULL, 's'},
+		{"cache-size", required_argument, NULL, 'c'},
+		{"archive", required_argument, NULL, 'a'},
+		{"no-gso", no_argument, NULL, 'g'},
+		{"max-transfers", required_argument, NULL, 'm'},
+		{"queue", required_argument, NULL, 'q'},
+		{"priority", required_argument, NULL, 'p'},
+		{"pool", required_argument, NULL, 'P'},
+		{"rate", required_argument, NULL, 'R'},
+		{"client-rate", required_argument, NULL, 'C'},
+		{"subnet-rate", required_argument, NULL, 'S'},
+		{"subnet-prefix", required_argument, NULL, 'N'},
+		{"burst", required_argument, NULL, 'B'},
+		{"quantum", required_argument, NULL, 'Q'},
+		{"no-cc", no_argument, NULL, 'n'},
+		{"trace-cwnd", no_argument, NULL, 'T'},
+		{"max-upload", required_argument, NULL, 'u'},
+		{"overwrite", no_argument, NULL, 'o'},
+		{NULL, 0, NULL, 0}
+	};
+
+	// serving archive path, NULL to serve the base directory
+	char *archive_path = NULL;
+
+	// parse command line options
+	int opt;
+	while ((opt = getopt_long(argc, argv, "fw:s:c:a:gm:q:p:P:R:C:S:N:B:Q:nTu:o",
+				  long_options, NULL)) != -1)
+	{
+		switch (opt) {
+		case 'f':
 			{
-				// print debugging info log message
-				sprintf
-				    (log_message,
-				     "ACK response received for block number: %d.",
-				     block);
-				child_log(INFO, log_message);
+				// serve each RRQ from a forked child process
+				fork_mode = 1;
+				break;
 			}
 
-			// before sending next data message, check ack message block number
-			if (block != block_counter)
+		case 'w':
 			{
-				// print a warning error log
-				child_log(ERROR,
-					  "Sent block number and ACK packet block number do not "
-					  "match. Transfer cancelled.");
-
-				// cancel tranfer, close source file
-				fclose(src_file);
-
-				// shutdown transfer socket
-				shutdown(data_sock, SHUT_RDWR);
-
-				// close transfer socket
-				close(data_sock);
-
-				// exit with error
-				exit(-1);
+				// shard the server on the given number of workers
+				workers = atoi(optarg);
+				if (workers < 1 || workers > MAX_WORKERS)
+				{
+					print_log(ERROR,
+						  "Invalid number of workers. "
+						  "Quitting.");
+
+					return -1;
+				}
+				break;
 			}
 
-			// reset chars counter for new transfer
-			i = 4;
-
-			// increase block number counter
-			block_counter++;
-		}
-	}
-	while (c != EOF);
-}
-
-void binary_mode_transfer(FILE * src_file, int data_sock,
-			  struct sockaddr cli_addr)
-{
-	// incoming message buffer
-	char buffer[BUFSIZE];
-
-	// message opcode
-	uint16_t opcode;
-
-	// received message length
-	int recv_len;
-
-	// client address length
-	size_t cli_size = sizeof(cli_addr);
-
-	// size in bytes of the data read from the file
-	size_t dim = 0;
-
-	// chars counter: the first 4 bytes of the transfer buffer
-	// must be left empty for the opcode and block number
-	int i = 4;
-
-	// data transfer blocks counter
-	uint16_t block_counter = 1;
-
-	// until the EOF is found in the opened file
-	do {
-		// retrieve next char from the file
-		dim = fread(&buffer[i], 1, 1, src_file);
-
-		// increase chars counter
-		i += dim;
-
-		// check if either the maximum number of chars or the
-		// EOF has been reached
-		if (i == MAX + 4 || dim != 1)
-		{
-			// if so, send the message to the client
-			// opcode = 3 (= DATA)
-			opcode = htons(3);
-
-			// set block number
-			uint16_t block = htons(block_counter);
-
-			// copy opcode to the transfer buffer
-			memcpy(buffer, &opcode, 2);
+		case 's':
+			{
+				// select the file blocks reading strategy
+				if (strcmp(optarg, "pread") == 0)
+				{
+					source_type = SOURCE_PREAD;
+				}
+				else if (strcmp(optarg, "mmap") == 0)
+				{
+					source_type = SOURCE_MMAP;
+				}
+				else if (strcmp(optarg, "cache") == 0)
+				{
+					source_type = SOURCE_CACHE;
+				}
+				else
+				{
+					print_log(ERROR,
+						  "Invalid block source: use "
+						  "pread, mmap or cache. "
+						  "Quitting.");
+
+					return -1;
+				}
+				break;
+			}
 
-			// copy block_number to the transfer buffer
-			memcpy(buffer + 2, &block, 2);
+		case 'c':
+			{
+				// memory budget of the block cache (MB)
+				int size = atoi(optarg);
+				if (size < 1)
+				{
+					print_log(ERROR,
+						  "Invalid block cache size. "
+						  "Quitting.");
+
+					return -1;
+				}
+				cache_init((uint64_t)size * 1024 * 1024);
+				break;
+			}
 
-			// send transfer buffer to the client
-			recv_len =
-			    sendto(data_sock,
-				   buffer, i,
-				   MSG_CONFIRM, (const struct sockaddr *)
-				   &cli_addr, sizeof(cli_addr));
+		case 'a':
+			{
+				// serve the files packed by tftp_pack
+				archive_path = optarg;
+				break;
+			}
 
-			// check for errors
-			check_errno(recv_len,
-				    "Error while sending data packet in binary mode");
+		case 'g':
+			{
+				// send every packet as its own datagram
+				gso_enabled = 0;
+				break;
+			}
 
-			// if debugging is enabled
-			if (DEBUG)
+		case 'm':
 			{
-				// print info log message
-				sprintf
-				    (log_message,
-				     "Data packet with block number %d sent. Waiting "
-				     "to receive ACK response.", block_counter);
-				child_log(INFO, log_message);
+				// concurrent transfers cap of each process
+				admission.max_transfers = atoi(optarg);
+				if (admission.max_transfers < 1)
+				{
+					print_log(ERROR,
+						  "Invalid maximum number of "
+						  "transfers. Quitting.");
+
+					return -1;
+				}
+				break;
 			}
 
-			// clear transfer buffer
-			memset(buffer, 0, BUFSIZE);
+		case 'q':
+			{
+				// pending requests cap of each process
+				admission.queue_len = atoi(optarg);
+				if (admission.queue_len < 0 ||
+				    admission.queue_len > ADMISSION_QUEUE_MAX)
+				{
+					print_log(ERROR,
+						  "Invalid pending queue length. "
+						  "Quitting.");
+
+					return -1;
+				}
+				break;
+			}
 
-			// wait for ACK response from the client
-			recv_len = recvfrom(data_sock, (char *)
-					    buffer,
-					    BUFSIZE,
-					    MSG_WAITALL, (struct sockaddr *)
-					    &cli_addr,
-					    (socklen_t *) & cli_size);
+		case 'p':
+			{
+				// requests served before the others
+				if (admission_add_pattern(optarg) < 0)
+				{
+					print_log(ERROR,
+						  "Too many priority patterns. "
+						  "Quitting.");
+
+					return -1;
+				}
+				break;
+			}
 
-			// check for errors
-			check_errno(recv_len,
-				    "Error while receiving ACK packet.");
+		case 'P':
+			{
+				// serve the transfers from pre-spawned processes
+				pool_size = atoi(optarg);
+				if (pool_size < 1 || pool_size > POOL_MAX)
+				{
+					print_log(ERROR,
+						  "Invalid transfer pool size. "
+						  "Quitting.");
+
+					return -1;
+				}
+				fork_mode = 1;
+				break;
+			}
 
-			// retrieve block number from transfer buffer
-			memcpy(&block, (uint16_t *) & buffer[2], 2);
+		case 'R':
+		case 'C':
+		case 'S':
+			{
+				// bandwidth limits (Mbit/s)
+				double mbps = atof(optarg);
+				if (mbps <= 0)
+				{
+					print_log(ERROR,
+						  "Invalid bandwidth limit. "
+						  "Quitting.");
+
+					return -1;
+				}
+				uint64_t rate = mbps * 125000;
+				if (opt == 'R')
+				{
+					shaper.rate = rate;
+				}
+				else if (opt == 'C')
+				{
+					shaper.client_rate = rate;
+				}
+				else
+				{
+					shaper.subnet_rate = rate;
+				}
+				break;
+			}
 
-			// deserialize block number
-			block = ntohs(block);
+		case 'N':
+			{
+				// clients sharing a subnet rate
+				shaper.prefix = atoi(optarg);
+				if (shaper.prefix < 0 || shaper.prefix > 32)
+				{
+					print_log(ERROR,
+						  "Invalid subnet prefix length. "
+						  "Quitting.");
+
+					return -1;
+				}
+				break;
+			}
 
-			// if debugging is enabled
-			if (DEBUG)
+		case 'B':
 			{
-				// print info log message
-				sprintf
-				    (log_message,
-				     "ACK response received for block number: %d.",
-				     block);
-				child_log(INFO, log_message);
+				// bytes sent at once by an idle bucket (KB)
+				int burst = atoi(optarg);
+				if (burst < 1)
+				{
+					print_log(ERROR,
+						  "Invalid burst size. "
+						  "Quitting.");
+
+					return -1;
+				}
+				shaper.burst = (uint64_t)burst * 1024;
+				break;
 			}
 
-			// before sending next data packet, check ack message block number
-			if (block != block_counter)
+		case 'Q':
 			{
-				// print a warning error log
-				child_log(ERROR,
-					  "Sent block number and ACK packet block number do not "
-					  "match. Transfer cancelled.");
+				// bytes sent by a transfer per scheduler round
+				shaper.quantum = atoi(optarg);
+				if (shaper.quantum < 1)
+				{
+					print_log(ERROR,
+						  "Invalid scheduler quantum. "
+						  "Quitting.");
+
+					return -1;
+				}
+				break;
+			}
 
-				// cancel tranfer, close source file
-				fclose(src_file);
+		case 'n':
+			{
+				// send whole windows regardless of losses
+				cc_enabled = 0;
+				break;
+			}
 
-				// shutdown transfer socket
-				shutdown(data_sock, SHUT_RDWR);
+		case 'T':
+			{
+				// log the congestion window changes
+				cc_trace = 1;
+				break;
+			}
 
-				// close transfer socket
-				close(data_sock);
+		case 'u':
+			{
+				// largest upload accepted (MB)
+				int size = atoi(optarg);
+				if (size < 1)
+				{
+					print_log(ERROR,
+						  "Invalid upload size limit. "
+						  "Quitting.");
+
+					return -1;
+				}
+				upload_max = (uint64_t)size * 1024 * 1024;
+				break;
+			}
 
-				// exit with error
-				exit(-1);
+		case 'o':
+			{
+				// uploads may replace the existing files
+				upload_overwrite = 1;
+				break;
 			}
 
-			// reset chars counter for new transfer
-			i = 4;
+		default:
+			{
+				print_log(ERROR,
+					  "Invalid option. Usage: tftp_server "
+					  "[options] <port> <base directory>. "
+					  "Quitting.");
 
-			// increase block number counter
-			block_counter++;
+				return -1;
+			}
 		}
 	}
-	while (dim == 1);
-
-}
-
-void handle_invalid_opcode(struct sockaddr cli_addr)
-{
-	// terminating end string
-	uint8_t end_string = 0;
-
-	// response message buffer
-	char buffer[BUFSIZE];
-
-	// response message error message text
-	char error_message[512];
-
-	// set opcode (ERROR = 5)
-	uint16_t opcode = htons(5);
-
-	// set error code (4 = Illegal TFTP operation)
-	uint16_t error_code = htons(4);
-
-	// copy opcode to the transfer buffer
-	memcpy(buffer, &opcode, 2);
-
-	// copy error code to the transfer buffer
-	memcpy(buffer + 2, &error_code, 2);
-
-	// set error message text
-	strcpy(error_message, "Illegal TFTP operation");
-
-	// copy error message to the tranfer buffer
-	strcpy(buffer + 2, error_message);
-
-	// add final terminating end string to the buffer
-	memcpy(buffer + strlen(error_message) + 2, &end_string, 1);
-
-	// send error message to the TFTP client
-	int sent_len = sendto(listener,
-			      buffer,
-			      strlen(error_message) + 4,
-			      MSG_CONFIRM,
-			      (const struct sockaddr *)&cli_addr,
-			      sizeof(cli_addr));
-
-	// check for errors
-	check_errno(sent_len, "Error while sending invalid opcode error message");
-
-	// error message correctly sent
-	print_log(INFO, "Error message correctly sent.");
-}
-
-void handle_file_not_found(int socket, struct sockaddr cli_addr)
-{
-	// terminating end string
-	uint8_t end_string = 0;
-
-	// response message buffer
-	char buffer[BUFSIZE];
-
-	// response message error message text
-	char error_message[512];
 
-	// set opcode (ERROR = 5)
-	uint16_t opcode = htons(5);
-
-	// set error code (1 = File not found)
-	uint16_t error_code = htons(1);
-
-	// copy opcode to the transfer buffer
-	memcpy(buffer, &opcode, 2);
-
-	// copy error code to the transfer buffer
-	memcpy(buffer + 2, &error_code, 2);
-
-	// set error message text
-	strcpy(error_message, "File not found");
-
-	// copy error message to the tranfer buffer
-	strcpy(buffer + 2, error_message);
-
-	// add final terminating end string to the buffer
-	memcpy(buffer + strlen(error_message) + 2, &end_string, 1);
-
-	// send error message to the TFTP client
-	int sent_len = sendto(socket,
-			      buffer,
-			      strlen(error_message) + 4,
-			      MSG_CONFIRM,
-			      (const struct sockaddr *)&cli_addr,
-			      sizeof(cli_addr));
-
-	// check for errors
-	check_errno(sent_len, "Error while sending file not found error message");
-
-	// error message correctly sent
-	print_log(INFO, "Error message correctly sent.");
-}
-
-/**
- * Entry point.
- *
- * @param  argc  command line arguments counter.
- * @param  argv  command line arguments.
- *
- * @return  execution exit code.
- */
-int main(int argc, char *argv[])
-{
 	// check if the port and base directory arguments were provided
-	if (argc != 3) {
+	if (argc - optind != 2) {
 		print_log(ERROR,
 			  "Invalid number of arguments. "
-			  "Usage: tftp_server <port> <base directory>. "
-			  "Quitting.");
+			  "Usage: tftp_server [options] <port> "
+			  "<base directory>. Quitting.");
 
 		return -1;
 	}
 
 	// set listener server port
-	int port = atoi(argv[1]);
+	int port = atoi(argv[optind]);
 
 	// check if the given port need root privileges
 	if (port < 1024) {
@@ -706,14 +1055,14 @@ int main(int argc, char *argv[])
 	}
 
 	// check if the given directory path is valid
-	DIR *dir = opendir(argv[2]);
+	DIR *dir = opendir(argv[optind + 1]);
 	if (dir)
 	{
 		// directory correctly opened, it exists, just close it
 		closedir(dir);
 
 		// set tftp server base directory
-		base_dir = argv[2];
+		base_dir = argv[optind + 1];
 	}
 	else if (ENOENT == errno)
 	{
@@ -736,6 +1085,52 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	// map the serving archive once, shared by all the processes
+	if (archive_path != NULL)
+	{
+		if (archive_open(&archive, archive_path) < 0)
+		{
+			print_log(ERROR,
+				  "The provided archive is not a valid serving "
+				  "archive. Quitting.");
+
+			return -1;
+		}
+
+		sprintf(log_message, "Serving archive: %s, %llu files.",
+			archive_path,
+			(unsigned long long)archive.header->count);
+		print_log(INFO, log_message);
+	}
+
+	// a transfer slot for each pool process
+	if (pool_size > 0 && admission.max_transfers > pool_size)
+	{
+		admission.max_transfers = pool_size;
+	}
+
+	// forked transfers do not share the shaper state
+	if (shaper_enabled() && fork_mode)
+	{
+		print_log(ERROR, "Bandwidth limits are only applied by the event "
+			  "loop, ignored.");
+	}
+
+	// dump the statistics on SIGUSR1: blocking calls are interrupted
+	// instead of restarted, so that the main loops notice the request
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = request_stats;
+	sigemptyset(&sa.sa_mask);
+	check_errno(sigaction(SIGUSR1, &sa, NULL),
+		    "Error while installing SIGUSR1 handler");
+
+	// shard the server on multiple workers, never returns
+	if (workers > 1)
+	{
+		start_workers(port);
+	}
+
 	// create listener UDP server
 	listener = createUDPSocket(port);
 
@@ -743,7 +1138,14 @@ int main(int argc, char *argv[])
 	check_errno(listener, "Error while creating listener socket. Quitting.");
 
 	// start main loop
-	listen_for_packets();
+	if (fork_mode)
+	{
+		listen_for_packets();
+	}
+	else
+	{
+		event_loop();
+	}
 
 	// return with no errors
 	return 0;
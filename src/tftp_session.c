@@ -0,0 +1,1669 @@
+/**
+ * File: tftp_session.c
+ *       TFTP Transfer Session Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#define _GNU_SOURCE
+
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include "../include/tftp_server.h"
+#include "../include/batch_io.h"
+
+uint64_t upload_max = UPLOAD_MAX_DEFAULT;
+
+int upload_overwrite = 0;
+
+/**
+ * Packets received from the session sockets: sessions are served one at a time
+ * by a process, so a single batch is shared by all of them.
+ */
+static RecvBatch received;
+
+/**
+ * ERROR packet having the given error code byte and text, terminating end
+ * string included.
+ */
+#define REJECT_PACKET(code, message) \
+	{ "\0\5\0" code message, sizeof("\0\5\0" code message) }
+
+/**
+ * ERROR packets built at compile time, indexed by error code: rejecting a
+ * request costs a single sendto() call.
+ */
+static const struct {
+	const char *packet;	// ERROR packet
+	int len;		// packet length
+} rejects[] = {
+	[ERR_UNDEFINED] = REJECT_PACKET("\0", "Server busy, try again later"),
+	[ERR_NOT_FOUND] = REJECT_PACKET("\1", "File not found"),
+	[ERR_ILLEGAL_OP] = REJECT_PACKET("\4", "Illegal TFTP operation"),
+};
+
+/**
+ * Builds the OACK packet listing the accepted options and queues it in the
+ * given batch. The client confirms it with the ACK of block number 0.
+ *
+ * @param  session  the session the options were negotiated for;
+ * @param  batch    outgoing packets batch.
+ */
+static void send_oack(Session *session, SendBatch *batch);
+
+/**
+ * Queues the blocks allowed by the congestion window in the current round:
+ * first the blocks in flight not sent again since the last go back, then new
+ * blocks. If blocks are left for the next round, its start is scheduled.
+ *
+ * @param  session  the session the blocks are sent for;
+ * @param  batch    outgoing packets batch.
+ */
+static void send_window(Session *session, SendBatch *batch);
+
+/**
+ * Reads from the source file and queues new blocks as DATA packets until the
+ * window is full, the given number of blocks is reached or the last block has
+ * been read. A block shorter than the block size marks the last packet. The
+ * packets are retained in the window slots until acknowledged.
+ *
+ * @param  session  the session the blocks are sent for;
+ * @param  batch    outgoing packets batch;
+ * @param  max      maximum number of blocks to be queued.
+ *
+ * @return  the number of blocks queued.
+ */
+static int fill_window(Session *session, SendBatch *batch, int max);
+
+/**
+ * Goes back to the block following the last acknowledged one: the retained
+ * packets not acknowledged yet are queued again, as allowed by the congestion
+ * window.
+ *
+ * @param  session  the session the packets are sent for;
+ * @param  batch    outgoing packets batch.
+ */
+static void resend_window(Session *session, SendBatch *batch);
+
+/**
+ * Handles a gap reported by the client: the next blocks sent are the ones
+ * following the acknowledged one, with a smaller congestion window.
+ *
+ * @param  session  the session the gap was reported for.
+ */
+static void go_back(Session *session);
+
+/**
+ * Returns the end of the round trip following the last go back: until then an
+ * ACK before the end of the window may answer a copy the client already had.
+ *
+ * @param  session  the session.
+ *
+ * @return  the end of the round trip (us).
+ */
+static uint64_t go_back_end(const Session *session);
+
+/**
+ * Queues the packet stored in the given window slot in the given batch.
+ *
+ * @param  session  the session the packet is sent for;
+ * @param  batch    outgoing packets batch;
+ * @param  slot     window slot holding the packet.
+ */
+static void queue_packet(Session *session, SendBatch *batch, int slot);
+
+/**
+ * Sends all the packets queued in the given batch with a single system call
+ * and arms the retransmission deadline, or the next paced round if earlier.
+ *
+ * @param  session  the session the packets are sent for;
+ * @param  batch    outgoing packets batch.
+ */
+static void send_batch(Session *session, SendBatch *batch);
+
+/**
+ * Handles the ACK of the given block number.
+ *
+ * @param  session  the session the ACK was received for;
+ * @param  block    acknowledged block number.
+ */
+static void handle_ack(Session *session, uint16_t block);
+
+/**
+ * Updates the session round trip time estimator with the packet stored in the
+ * given window slot, just acknowledged, unless it was sent more than once.
+ *
+ * @param  session  the session the ACK was received for;
+ * @param  slot     window slot of the acknowledged packet.
+ */
+static void take_sample(Session *session, int slot);
+
+/**
+ * Creates the temporary file an upload is written to. The requested file name
+ * must be a plain name within the base directory, naming no existing file
+ * unless overwriting is allowed, and the announced size must fit within the
+ * upload limit and the free space of the base directory.
+ *
+ * @param  session  the upload session;
+ * @param  req      the received WRQ.
+ *
+ * @return  0 on success, -1 in case of error, already notified to the client.
+ */
+static int open_upload(Session *session, const Request *req);
+
+/**
+ * Builds the ACK of the last block received in sequence and queues it in the
+ * given batch. The packet is kept in the first window slot to be sent again on
+ * timeouts.
+ *
+ * @param  session  the upload session;
+ * @param  batch    outgoing packets batch.
+ */
+static void send_ack(Session *session, SendBatch *batch);
+
+/**
+ * Handles a DATA packet of an upload: blocks received in sequence are queued
+ * to the temporary file writer and acknowledged at window boundaries, blocks
+ * ahead of a missing one and blocks already received are reported once with
+ * the ACK of the last block received in sequence.
+ *
+ * @param  session  the upload session;
+ * @param  block    block number;
+ * @param  data     block payload;
+ * @param  len      block payload length.
+ */
+static void handle_data(Session *session, uint16_t block, const char *data,
+			int len);
+
+/**
+ * Waits for the whole upload to be written and renames the temporary file to
+ * the requested file name.
+ *
+ * @param  session  the upload session.
+ *
+ * @return  0 on success, -1 in case of error, already notified to the client.
+ */
+static int finish_upload(Session *session);
+
+/**
+ * Releases the upload temporary file, removing it if the upload was not
+ * completed.
+ *
+ * @param  session  the upload session.
+ */
+static void close_upload(Session *session);
+
+int parse_request(const char *buffer, int len, Request *req)
+{
+	// the shortest valid request is opcode + two empty strings
+	if (len < 4)
+	{
+		return -1;
+	}
+
+	// retrieve opcode
+	memcpy(&req->opcode, buffer, 2);
+	req->opcode = ntohs(req->opcode);
+
+	// the file name must be terminated within the received bytes
+	const char *end = memchr(buffer + 2, '\0', len - 2);
+	if (end == NULL ||
+	    (size_t)(end - (buffer + 2)) >= sizeof(req->file_name))
+	{
+		return -1;
+	}
+
+	// retrieve file name
+	strcpy(req->file_name, buffer + 2);
+
+	// the transfer mode must be terminated within the received bytes
+	const char *mode = end + 1;
+	end = memchr(mode, '\0', len - (mode - buffer));
+	if (end == NULL || (size_t)(end - mode) >= sizeof(req->mode))
+	{
+		return -1;
+	}
+
+	// retrieve transfer mode
+	strcpy(req->mode, mode);
+
+	// no option requested yet
+	req->blksize = 0;
+	req->windowsize = 0;
+	req->tsize = 0;
+	req->size = 0;
+	req->rollover = -1;
+
+	// options follow as option name and value strings pairs
+	const char *option = end + 1;
+	while (option < buffer + len)
+	{
+		// both option name and value must be terminated
+		end = memchr(option, '\0', len - (option - buffer));
+		if (end == NULL || end + 1 >= buffer + len)
+		{
+			break;
+		}
+		const char *value = end + 1;
+		end = memchr(value, '\0', len - (value - buffer));
+		if (end == NULL)
+		{
+			break;
+		}
+
+		// block size option (RFC 2348)
+		if (strcasecmp(option, "blksize") == 0)
+		{
+			int blksize = atoi(value);
+
+			// values out of range are ignored, values bigger than
+			// the maximum are lowered to the maximum
+			if (blksize >= MIN_BLKSIZE)
+			{
+				req->blksize = blksize < MAX_BLKSIZE ?
+					       blksize : MAX_BLKSIZE;
+			}
+		}
+
+		// window size option (RFC 7440)
+		if (strcasecmp(option, "windowsize") == 0)
+		{
+			int windowsize = atoi(value);
+
+			// valid values range between 1 and 65535
+			if (windowsize >= 1 && windowsize <= 65535)
+			{
+				req->windowsize = windowsize;
+			}
+		}
+
+		// transfer size option (RFC 2349): the value of a RRQ is 0,
+		// a WRQ announces the size of the file
+		if (strcasecmp(option, "tsize") == 0)
+		{
+			req->tsize = 1;
+			req->size = strtoull(value, NULL, 10);
+		}
+
+		// block number following 65535, only 0 and 1 are defined
+		if (strcasecmp(option, "rollover") == 0 &&
+		    (strcmp(value, "0") == 0 || strcmp(value, "1") == 0))
+		{
+			req->rollover = atoi(value);
+		}
+
+		// next option
+		option = end + 1;
+	}
+
+	return 0;
+}
+
+void send_error(int socket, const struct sockaddr_in *addr, uint16_t code,
+		const char *message)
+{
+	// response message buffer
+	char buffer[BUFSIZE];
+
+	// set opcode (ERROR = 5)
+	uint16_t opcode = htons(OP_ERROR);
+
+	// serialize error code
+	code = htons(code);
+
+	// copy opcode and error code to the transfer buffer
+	memcpy(buffer, &opcode, 2);
+	memcpy(buffer + 2, &code, 2);
+
+	// copy error message and its terminating end string to the buffer
+	strcpy(buffer + 4, message);
+
+	// send error message to the TFTP client
+	int sent_len = sendto(socket,
+			      buffer,
+			      strlen(message) + 5,
+			      MSG_CONFIRM,
+			      (const struct sockaddr *)addr,
+			      sizeof(*addr));
+
+	// an error message is not acknowledged nor retransmitted: just log
+	if (sent_len < 0)
+	{
+		sprintf(log_message,
+			"Error while sending error message: errno = %d", errno);
+		print_log(ERROR, log_message);
+	}
+}
+
+void send_reject(int socket, const struct sockaddr_in *addr, uint16_t code)
+{
+	// no prebuilt packet for the given error code
+	if (code >= sizeof(rejects) / sizeof(rejects[0]) ||
+	    rejects[code].packet == NULL)
+	{
+		send_error(socket, addr, code, "Request rejected");
+		return;
+	}
+
+	// send the prebuilt error message to the TFTP client
+	if (sendto(socket, rejects[code].packet, rejects[code].len, 0,
+		   (const struct sockaddr *)addr, sizeof(*addr)) < 0)
+	{
+		sprintf(log_message,
+			"Error while sending error message: errno = %d", errno);
+		print_log(ERROR, log_message);
+	}
+}
+
+Session *session_create(const Request *req, const struct sockaddr_in *cli_addr)
+{
+	return session_create_fd(req, cli_addr, -1, 0);
+}
+
+Session *session_create_fd(const Request *req,
+			   const struct sockaddr_in *cli_addr, int fd,
+			   uint64_t size)
+{
+	// allocate and clear the new session
+	Session *session = calloc(1, sizeof(Session));
+	if (session == NULL)
+	{
+		print_log(ERROR, "Unable to allocate a new transfer session.");
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return NULL;
+	}
+
+	// store client address, requested file name and reception time
+	session->cli_addr = *cli_addr;
+	strcpy(session->file_name, req->file_name);
+	session->received = req->received;
+
+	// new socket to be used to send data packets
+	session->sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (session->sock < 0)
+	{
+		print_log(ERROR, "Error while creating transfer socket.");
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		free(session);
+		return NULL;
+	}
+
+	// check requested transfer mode
+	if (strcasecmp(req->mode, "netascii") == 0)		// TEXT MODE
+	{
+		session->text_mode = 1;
+	}
+	else if (strcasecmp(req->mode, "octet") == 0)		// BINARY MODE
+	{
+		session->text_mode = 0;
+	}
+	else							// INVALID MODE
+	{
+		send_error(session->sock, cli_addr, ERR_ILLEGAL_OP,
+			   "Invalid transfer mode");
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		close(session->sock);
+		free(session);
+		return NULL;
+	}
+
+	// uploads are written to a temporary file
+	if (req->opcode == OP_WRQ)
+	{
+		session->upload = 1;
+		if (fd >= 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+		if (open_upload(session, req) < 0)
+		{
+			close(session->sock);
+			free(session);
+			return NULL;
+		}
+	}
+
+	// serve the file straight from the archive mapping
+	if (!session->upload && fd < 0 && archive.map != NULL)
+	{
+		const ArchiveEntry *entry = archive_lookup(&archive,
+							   req->file_name);
+		if (entry != NULL)
+		{
+			session->source = block_source_memory(
+				archive.map + entry->offset, entry->size,
+				session->text_mode);
+		}
+	}
+	else if (!session->upload)
+	{
+		// open source file: the descriptor resolved by the listener if
+		// any, otherwise resolved relative to the base directory,
+		// missing files are remembered and popular files kept open
+		if (fd < 0)
+		{
+			struct stat st;
+			fd = meta_open(req->file_name, &st);
+			size = fd >= 0 ? (uint64_t)st.st_size : 0;
+		}
+		if (fd >= 0)
+		{
+			// the block cache is indexed by full path
+			char path[BUFSIZE];
+			snprintf(path, sizeof(path), "%s/%s", base_dir,
+				 req->file_name);
+			session->source = block_source_fd(fd, path, size,
+							  source_type,
+							  session->text_mode);
+		}
+	}
+
+	// check if the file was correctly opened
+	if (!session->upload && session->source == NULL)
+	{
+		// if not, print a warning log message
+		sprintf(log_message,
+			"Error while opening transfer file %s. Transfer Cancelled.",
+			req->file_name);
+		print_log(ERROR, log_message);
+
+		// send error message to the client
+		send_reject(session->sock, cli_addr, ERR_NOT_FOUND);
+
+		close(session->sock);
+		free(session);
+		return NULL;
+	}
+
+	// negotiate block size
+	session->blksize = MAX;
+	if (req->blksize > 0)
+	{
+		session->blksize = req->blksize;
+		session->options |= OPT_BLKSIZE;
+		session->oack = 1;
+	}
+
+	// negotiate window size: bounded by the memory retained per window
+	session->windowsize = 1;
+	if (req->windowsize > 0)
+	{
+		int max_window = MAX_WINDOW_BYTES / (session->blksize + 4);
+		if (max_window > MAX_WINDOWSIZE)
+		{
+			max_window = MAX_WINDOWSIZE;
+		}
+		if (max_window < 1)
+		{
+			max_window = 1;
+		}
+
+		session->windowsize = req->windowsize < max_window ?
+				      req->windowsize : max_window;
+		session->options |= OPT_WINDOWSIZE;
+		session->oack = 1;
+	}
+
+	// report the file size, unknown in advance for netascii transfers,
+	// or confirm the size announced for an upload
+	if (req->tsize && (session->upload || !session->text_mode))
+	{
+		session->options |= OPT_TSIZE;
+		session->oack = 1;
+	}
+
+	// block numbers restart from 0 after 65535 unless requested otherwise
+	session->rollover = 0;
+	if (req->rollover >= 0)
+	{
+		session->rollover = req->rollover;
+		session->options |= OPT_ROLLOVER;
+		session->oack = 1;
+	}
+
+	// allocate the window slots buffers for the negotiated sizes: uploads
+	// only keep their last ACK
+	int slots = session->upload ? 1 : session->windowsize;
+	size_t buffers_size = slots * (session->blksize + 4);
+	session->buffers = malloc(buffers_size > OACK_SIZE ? buffers_size :
+				  OACK_SIZE);
+	session->window = malloc(session->windowsize * sizeof(Packet));
+	if (session->buffers == NULL || session->window == NULL)
+	{
+		print_log(ERROR, "Unable to allocate transfer buffer.");
+		send_error(session->sock, cli_addr, ERR_UNDEFINED,
+			   "Out of memory");
+		free(session->buffers);
+		free(session->window);
+		if (session->upload)
+		{
+			close_upload(session);
+		}
+		else
+		{
+			block_source_close(session->source);
+		}
+		close(session->sock);
+		free(session);
+		return NULL;
+	}
+
+	// each slot header is followed by the room for a whole block
+	int i;
+	for (i = 0; i < slots; i++)
+	{
+		session->window[i].header = session->buffers +
+					    i * (session->blksize + 4);
+		session->window[i].header_len = 0;
+	}
+
+	// no round trip time sample yet
+	rtt_init(&session->rtt);
+
+	// deadline not scheduled in the event loop yet
+	timer_init(&session->timer, session);
+
+	// no DATA packet sent or received yet
+	session->state = session->upload ? SESSION_RECEIVING : SESSION_SENDING;
+	session->acked = 0;
+	session->sent = 0;
+	session->in_flight = 0;
+	session->cursor = 0;
+	session->resent_us = 0;
+	session->deferred_gap = 0;
+	session->client_window = 0;
+	session->head = 0;
+
+	// slow start up to the negotiated window
+	cc_init(&session->cc, session->windowsize, session->file_name);
+
+	// new blocks are sent without waiting for the shaper
+	session->quota = -1;
+
+	return session;
+}
+
+void session_start(Session *session)
+{
+	// outgoing packets batch
+	SendBatch batch;
+	batch_init(&batch, session->sock);
+
+	// acknowledge options first, the ACK of block 0 starts the transfer
+	if (session->oack)
+	{
+		send_oack(session, &batch);
+	}
+	else if (session->upload)
+	{
+		// the ACK of block 0 lets the client send the first window
+		send_ack(session, &batch);
+	}
+	else
+	{
+		// send the first window, the client ACKs drive the rest of
+		// the transfer
+		send_window(session, &batch);
+	}
+
+	send_batch(session, &batch);
+
+	// startup cost of the transfer, from the listener to the first response:
+	// shaped transfers may wait for the shaper
+	if (!session->upload && session->received > 0 && session->packets > 0)
+	{
+		latency_record(get_time_us() - session->received);
+	}
+}
+
+static void send_oack(Session *session, SendBatch *batch)
+{
+	// nothing is in flight yet: the OACK is stored in the first slot
+	char *packet = session->window[0].header;
+	int len = 0;
+
+	// opcode = 6 (= OACK)
+	uint16_t opcode = htons(OP_OACK);
+	memcpy(packet, &opcode, 2);
+	len += 2;
+
+	// accepted block size: option name and value strings
+	if (session->options & OPT_BLKSIZE)
+	{
+		len += sprintf(packet + len, "blksize") + 1;
+		len += sprintf(packet + len, "%d", session->blksize) + 1;
+	}
+
+	// accepted window size
+	if (session->options & OPT_WINDOWSIZE)
+	{
+		len += sprintf(packet + len, "windowsize") + 1;
+		len += sprintf(packet + len, "%d", session->windowsize) + 1;
+	}
+
+	// size of the requested file
+	if (session->options & OPT_TSIZE)
+	{
+		len += sprintf(packet + len, "tsize") + 1;
+		len += sprintf(packet + len, "%llu", (unsigned long long)
+			       (session->upload ? session->size :
+				session->source->size)) + 1;
+	}
+
+	// accepted rollover value
+	if (session->options & OPT_ROLLOVER)
+	{
+		len += sprintf(packet + len, "rollover") + 1;
+		len += sprintf(packet + len, "%d", session->rollover) + 1;
+	}
+
+	// the OACK is retransmitted as the DATA packets are
+	session->window[0].header_len = len;
+	session->window[0].data.iov_len = 0;
+	session->window[0].resent = 0;
+	rtt_progress(&session->rtt);
+
+	queue_packet(session, batch, 0);
+}
+
+static void send_window(Session *session, SendBatch *batch)
+{
+	// blocks allowed in the current round
+	uint64_t now = get_time_us();
+	int budget = cc_budget(&session->cc, now, session->rtt.srtt,
+			       session->rtt.rto);
+	int count = 0;
+
+	// blocks left behind by the last go back first
+	while (count < budget && session->cursor < session->in_flight)
+	{
+		int slot = (session->head + session->cursor) %
+			   session->windowsize;
+
+		// retransmitted packets give ambiguous round trip times
+		session->window[slot].resent = 1;
+		queue_packet(session, batch, slot);
+		session->cursor++;
+		session->resent_us = now;
+		count++;
+	}
+
+	// then new blocks
+	count += fill_window(session, batch, budget - count);
+	cc_sent(&session->cc, count, session->sent, now, session->rtt.srtt,
+		session->rtt.rto);
+
+	// the rest of the window waits for the next round
+	session->pace = 0;
+	if (count == budget && session_active(session) &&
+	    (session->cursor < session->in_flight ||
+	     (!session->eof && session->in_flight < session->windowsize)))
+	{
+		session->pace = (cc_next_send(&session->cc, session->rtt.srtt,
+					      session->rtt.rto) + 999) / 1000;
+	}
+
+	// a deferred gap is checked once the round trip of the last go back
+	// is over
+	if (session->deferred_gap != 0)
+	{
+		uint64_t check = (go_back_end(session) + 999) / 1000;
+		if (session->pace == 0 || check < session->pace)
+		{
+			session->pace = check;
+		}
+	}
+}
+
+static int fill_window(Session *session, SendBatch *batch, int max)
+{
+	// number of blocks to be read to fill the window, as many as allowed
+	// by the congestion window and the shaper
+	int count = session->windowsize - session->in_flight;
+	if (count > max)
+	{
+		count = max;
+	}
+	if (session->quota >= 0 && count > session->quota)
+	{
+		count = session->quota;
+	}
+	if (session->eof || count <= 0)
+	{
+		return 0;
+	}
+
+	// read the blocks right after the opcode and block number of the
+	// free window slots
+	struct iovec blocks[MAX_WINDOWSIZE];
+	int i;
+	for (i = 0; i < count; i++)
+	{
+		int slot = (session->head + session->in_flight + i) %
+			   session->windowsize;
+		blocks[i].iov_base = session->window[slot].header + 4;
+	}
+	count = block_source_read(session->source, blocks, count,
+				  session->blksize);
+
+	// the file could not be read, cancel the transfer
+	if (count < 0)
+	{
+		print_log(ERROR, "Error while reading transfer file. Transfer "
+			  "cancelled.");
+		send_error(session->sock, &session->cli_addr, ERR_UNDEFINED,
+			   "Read error");
+		session->state = SESSION_FAILED;
+		return 0;
+	}
+
+	// queue the new blocks
+	for (i = 0; i < count; i++)
+	{
+		// window slot of the new block
+		int slot = (session->head + session->in_flight) %
+			   session->windowsize;
+		Packet *packet = &session->window[slot];
+
+		// a block shorter than the block size terminates the transfer
+		session->eof = blocks[i].iov_len < (size_t)session->blksize;
+
+		// increase block number counter
+		session->sent++;
+		session->in_flight++;
+		session->cursor++;
+
+		// opcode = 3 (= DATA)
+		uint16_t opcode = htons(OP_DATA);
+
+		// set block number: wraps around past 65535
+		uint16_t block = htons(wrap_block(session->sent,
+						  session->rollover));
+
+		// copy opcode and block number to the packet header
+		memcpy(packet->header, &opcode, 2);
+		memcpy(packet->header + 2, &block, 2);
+		packet->header_len = 4;
+
+		// retain the payload for retransmissions
+		packet->data = blocks[i];
+		packet->resent = 0;
+
+		queue_packet(session, batch, slot);
+	}
+
+	// the shaper allowance is used by the queued blocks
+	if (session->quota >= 0)
+	{
+		session->quota -= count;
+	}
+
+	return count;
+}
+
+static void resend_window(Session *session, SendBatch *batch)
+{
+	// go back to the block following the last acknowledged one
+	session->cursor = 0;
+	send_window(session, batch);
+}
+
+static void go_back(Session *session)
+{
+	session->anomalies.gaps++;
+	cc_loss(&session->cc, session->acked, session->sent,
+		get_time_us() - session->window[session->head].sent_us,
+		session->rtt.srtt, session->rtt.min_rtt);
+	session->client_window = session->acked;
+	session->cursor = 0;
+	session->deferred_gap = 0;
+}
+
+static uint64_t go_back_end(const Session *session)
+{
+	return session->resent_us + session->rtt.srtt * 5 / 4;
+}
+
+static void queue_packet(Session *session, SendBatch *batch, int slot)
+{
+	// packet stored in the given slot
+	Packet *packet = &session->window[slot];
+
+	// header and payload, which may live in the file mapping, are
+	// gathered by the kernel when the batch is sent
+	batch_add(batch, &session->cli_addr, packet->header,
+		  packet->header_len, &packet->data);
+	packet->sent_us = get_time_us();
+	session->packets++;
+
+	// retransmissions are not scheduled, but still use the bandwidth
+	if (packet->resent && session->flow.data != NULL)
+	{
+		shaper_charge(&session->flow, packet->header_len +
+			      packet->data.iov_len);
+	}
+
+	// if debugging is enabled
+	if (DEBUG)
+	{
+		uint16_t block;
+		memcpy(&block, packet->header + 2, 2);
+		sprintf(log_message,
+			"Data packet with block number %d sent. Waiting "
+			"to receive ACK response.", ntohs(block));
+		print_log(INFO, log_message);
+	}
+}
+
+static void send_batch(Session *session, SendBatch *batch)
+{
+	// nothing queued, the current retransmission deadline still holds
+	if (batch->count > 0)
+	{
+		// send the whole batch to the client
+		if (batch_flush(batch) < 0)
+		{
+			// a failed send is recovered by the retransmission
+			// timeout
+			sprintf(log_message, "Error while sending data "
+				"packets: errno = %d", errno);
+			print_log(ERROR, log_message);
+		}
+
+		// arm retransmission deadline
+		session->retransmit = get_time_ms() +
+				      rtt_timeout_ms(&session->rtt);
+	}
+
+	// the next paced round may come first, the retransmission deadline
+	// is stale once all the blocks were acknowledged
+	session->deadline = session->retransmit;
+	if (session->pace != 0 && (session->pace < session->retransmit ||
+				   session->in_flight == 0))
+	{
+		session->deadline = session->pace;
+	}
+}
+
+void session_receive(Session *session)
+{
+	// allocate the received packets batch on first use, growing it for
+	// the DATA packets of uploads
+	int size = session->upload ? session->blksize + 4 : BUFSIZE;
+	if (received.size < size)
+	{
+		batch_recv_free(&received);
+		if (batch_recv_alloc(&received, MAX_BATCH, size) < 0)
+		{
+			print_log(ERROR, "Unable to allocate receive buffers.");
+			return;
+		}
+	}
+
+	// number of packets received with the last call
+	int count = 0;
+
+	// index of the next packet to be processed
+	int i = 0;
+
+	// drain all the packets waiting on the socket
+	while (session_active(session))
+	{
+		// all the received packets processed, receive a new batch
+		if (i == count)
+		{
+			count = batch_recv(session->sock, &received,
+					   MSG_DONTWAIT);
+			i = 0;
+
+			// nothing more to read
+			if (count <= 0)
+			{
+				break;
+			}
+		}
+
+		// next received packet and its sender address
+		struct sockaddr_in *addr = &received.addrs[i];
+		int recv_len;
+		char *buffer = batch_packet(&received, i++, &recv_len);
+
+		// packets coming from another TID are answered without
+		// disturbing the transfer
+		if (addr->sin_addr.s_addr != session->cli_addr.sin_addr.s_addr ||
+		    addr->sin_port != session->cli_addr.sin_port)
+		{
+			session->anomalies.foreign++;
+			send_error(session->sock, addr, ERR_UNKNOWN_TID,
+				   "Unknown transfer ID");
+			continue;
+		}
+
+		// too short to be an ACK
+		if (recv_len < 4)
+		{
+			session->anomalies.unexpected++;
+			continue;
+		}
+
+		// retrieve opcode and block number
+		uint16_t opcode;
+		uint16_t block;
+		memcpy(&opcode, buffer, 2);
+		memcpy(&block, buffer + 2, 2);
+		opcode = ntohs(opcode);
+		block = ntohs(block);
+
+		// the client cancelled the transfer
+		if (opcode == OP_ERROR)
+		{
+			sprintf(log_message, "Transfer of %s cancelled by the "
+				"client.", session->file_name);
+			print_log(ERROR, log_message);
+			session->state = SESSION_FAILED;
+			break;
+		}
+
+		// uploads only expect DATA packets
+		if (session->upload)
+		{
+			if (opcode != OP_DATA)
+			{
+				session->anomalies.unexpected++;
+				continue;
+			}
+
+			handle_data(session, block, buffer + 4, recv_len - 4);
+			continue;
+		}
+
+		// ignore anything else but ACKs
+		if (opcode != OP_ACK)
+		{
+			session->anomalies.unexpected++;
+			continue;
+		}
+
+		// if debugging is enabled
+		if (DEBUG)
+		{
+			sprintf(log_message,
+				"ACK response received for block number: %d.",
+				block);
+			print_log(INFO, log_message);
+		}
+
+		handle_ack(session, block);
+	}
+}
+
+static void handle_ack(Session *session, uint16_t block)
+{
+	// outgoing packets batch: the packets queued are sent before the
+	// window slides again, as their slots are reused for new blocks
+	SendBatch batch;
+	batch_init(&batch, session->sock);
+
+	// the ACK of block 0 confirms the options
+	if (session->oack)
+	{
+		// no DATA packet sent yet: the OACK is sent again on timeout
+		if (block != 0)
+		{
+			session->anomalies.stale++;
+			return;
+		}
+
+		// options confirmed, send the first window
+		take_sample(session, 0);
+		session->oack = 0;
+		rtt_progress(&session->rtt);
+		send_window(session, &batch);
+		send_batch(session, &batch);
+		return;
+	}
+
+	// blocks acknowledged by this ACK: block numbers wrap around
+	uint16_t acked = block_distance(wrap_block(session->acked,
+						   session->rollover),
+					block, session->rollover);
+
+	// an ACK outside the blocks in flight is a late copy of an ACK sent
+	// again by the client on its timeout: ignore it
+	if (acked > session->in_flight)
+	{
+		session->anomalies.stale++;
+
+		// if debugging is enabled
+		if (DEBUG)
+		{
+			sprintf(log_message, "Ignored ACK of block number %d "
+				"outside the window.", block);
+			print_log(INFO, log_message);
+		}
+		return;
+	}
+
+	// a duplicate ACK never triggers a retransmission: answering each
+	// copy would double the packets sent at every round trip (Sorcerer's
+	// Apprentice Syndrome), lost packets are sent again on timeout
+	if (acked == 0)
+	{
+		session->anomalies.duplicate++;
+		return;
+	}
+
+	// a timeout is undone if the blocks sent before it were not lost
+	cc_ack(&session->cc, session->acked + acked,
+	       session->acked + session->cursor);
+
+	// ACKs are cumulative: slide the window past the acknowledged blocks
+	int resent = 0;
+	int i;
+	for (i = 0; i < acked; i++)
+	{
+		int slot = (session->head + i) % session->windowsize;
+		session->bytes += session->window[slot].data.iov_len;
+		resent |= session->window[slot].resent;
+	}
+
+	// the round trip time is measured on the acknowledged block, unless
+	// the ACK followed a block sent again: the wait for the lost block
+	// would be measured as well. A gap is reported once the following
+	// block arrives, or again on the client timeout: only the ACKs ending
+	// a window or the transfer measure it
+	int window_end = session->acked + acked - session->client_window ==
+			 (uint64_t)session->windowsize;
+	int last = session->eof && acked == session->in_flight;
+	if (!resent && (window_end || last))
+	{
+		take_sample(session, (session->head + acked - 1) %
+			    session->windowsize);
+	}
+	session->acked += acked;
+	session->head = (session->head + acked) % session->windowsize;
+	session->in_flight -= acked;
+	session->cursor = session->cursor > acked ? session->cursor - acked : 0;
+	rtt_progress(&session->rtt);
+	session->deferred_gap = 0;
+
+	// the last DATA packet was acknowledged
+	if (session->eof && session->in_flight == 0)
+	{
+		session->state = SESSION_DONE;
+		return;
+	}
+
+	// the client acknowledges a window once it received windowsize
+	// blocks since its last ACK, each ACK starting a new window (RFC
+	// 7440): the blocks sent past the end of its window were not lost
+	if (session->acked - session->client_window ==
+	    (uint64_t)session->windowsize)
+	{
+		session->client_window = session->acked;
+	}
+
+	// an ACK before the end of the window reports a gap at the client:
+	// go back to the block following the acknowledged one, with a smaller
+	// congestion window. Within a round trip of the last go back the ACK
+	// may answer a copy the client already had, so it only slides the
+	// window: going back again would send more copies, each one
+	// acknowledged as a new gap. The gap is checked again at the end of
+	// the round trip, since the client reports it only once
+	else if (session->in_flight > 0)
+	{
+		session->client_window = session->acked;
+		if (get_time_us() >= go_back_end(session))
+		{
+			go_back(session);
+		}
+		else
+		{
+			session->deferred_gap = session->acked;
+		}
+	}
+
+	// send the blocks lost and new blocks in place of the acknowledged
+	// ones
+	send_window(session, &batch);
+
+	// the whole window goes out with a single system call
+	send_batch(session, &batch);
+}
+
+static void take_sample(Session *session, int slot)
+{
+	// Karn's algorithm: the ACK may refer to any of the copies sent
+	Packet *packet = &session->window[slot];
+	if (packet->resent)
+	{
+		return;
+	}
+
+	rtt_sample(&session->rtt, get_time_us() - packet->sent_us);
+}
+
+static int open_upload(Session *session, const Request *req)
+{
+	// the file must be created right in the base directory, hidden names
+	// are left to the temporary files, and a served archive is immutable
+	const char *name = req->file_name;
+	if (archive.map != NULL || name[0] == '\0' || name[0] == '.' || strchr(name, '/') != NULL)
+	{
+		sprintf(log_message, "Invalid upload file name %s. Transfer "
+			"cancelled.", name);
+		print_log(ERROR, log_message);
+		send_error(session->sock, &session->cli_addr, ERR_ACCESS,
+			   "Access violation");
+		return -1;
+	}
+
+	// uploads received by this process so far, making the temporary
+	// file names unique
+	static unsigned int uploads = 0;
+
+	// the temporary file lives next to the destination one: the final
+	// rename is atomic within the same file system
+	char path[BUFSIZE];
+	snprintf(path, sizeof(path), "%s/%s", base_dir, name);
+
+	// files being served are never replaced unless explicitly allowed
+	struct stat st;
+	if (!upload_overwrite && fstatat(AT_FDCWD, path, &st,
+					 AT_SYMLINK_NOFOLLOW) == 0)
+	{
+		sprintf(log_message, "Upload file %s already exists. Transfer "
+			"cancelled.", name);
+		print_log(ERROR, log_message);
+		send_error(session->sock, &session->cli_addr, ERR_FILE_EXISTS,
+			   "File already exists");
+		return -1;
+	}
+
+	// the announced size must fit within the upload limit and the free
+	// space of the base directory before it is allocated
+	struct statvfs fs;
+	if (req->size > upload_max || (statvfs(base_dir, &fs) == 0 &&
+	    req->size > (uint64_t)fs.f_bavail * fs.f_frsize))
+	{
+		sprintf(log_message, "Upload file %s of %llu bytes exceeds the "
+			"allowed size. Transfer cancelled.", name,
+			(unsigned long long)req->size);
+		print_log(ERROR, log_message);
+		send_error(session->sock, &session->cli_addr, ERR_DISK_FULL,
+			   "Disk full or allocation exceeded");
+		return -1;
+	}
+
+	session->path = strdup(path);
+	snprintf(path, sizeof(path), "%s/.%s.%d.%u.part", base_dir, name,
+		 getpid(), uploads++);
+	session->temp_path = strdup(path);
+	if (session->path == NULL || session->temp_path == NULL)
+	{
+		print_log(ERROR, "Unable to allocate upload file paths.");
+		send_error(session->sock, &session->cli_addr, ERR_UNDEFINED,
+			   "Out of memory");
+		close_upload(session);
+		return -1;
+	}
+
+	// the announced size is allocated at once, blocks are written by the
+	// writer thread off the ACK path
+	session->size = req->size;
+	session->writer = writer_open(session->temp_path, req->size);
+	if (session->writer == NULL)
+	{
+		sprintf(log_message, "Error while creating upload file %s: "
+			"errno = %d. Transfer cancelled.", session->temp_path,
+			errno);
+		print_log(ERROR, log_message);
+		if (errno == ENOSPC)
+		{
+			send_error(session->sock, &session->cli_addr,
+				   ERR_DISK_FULL,
+				   "Disk full or allocation exceeded");
+		}
+		else
+		{
+			send_error(session->sock, &session->cli_addr,
+				   ERR_ACCESS, "Access violation");
+		}
+		close_upload(session);
+		return -1;
+	}
+
+	// text mode uploads are converted from netascii
+	netascii_decoder_init(&session->decoder);
+
+	return 0;
+}
+
+static void send_ack(Session *session, SendBatch *batch)
+{
+	// the ACK replaces the OACK or the previous ACK in the first slot
+	Packet *packet = &session->window[0];
+
+	// opcode = 4 (= ACK) and last block received in sequence
+	uint16_t opcode = htons(OP_ACK);
+	uint16_t block = htons(wrap_block(session->acked, session->rollover));
+	memcpy(packet->header, &opcode, 2);
+	memcpy(packet->header + 2, &block, 2);
+	packet->header_len = 4;
+	packet->data.iov_len = 0;
+	packet->resent = 0;
+
+	queue_packet(session, batch, 0);
+
+	// blocks of the next window are counted from here
+	session->in_flight = 0;
+}
+
+static void handle_data(Session *session, uint16_t block, const char *data,
+			int len)
+{
+	// outgoing packets batch: at most one ACK
+	SendBatch batch;
+	batch_init(&batch, session->sock);
+
+	// distance from the block expected in sequence: block numbers wrap
+	// around
+	uint16_t distance = block_distance(wrap_block(session->acked + 1,
+						      session->rollover),
+					   block, session->rollover);
+
+	if (distance == 0 && !session->eof)		// EXPECTED BLOCK
+	{
+		// the first DATA packet confirms the options
+		session->oack = 0;
+
+		// the first block following an ACK measures its round trip
+		// time
+		if (session->in_flight == 0)
+		{
+			take_sample(session, 0);
+		}
+
+		// text mode payloads are converted from netascii, a CR may be
+		// carried from the previous block
+		const char *payload = data;
+		size_t payload_len = len;
+		if (session->text_mode)
+		{
+			static char decoded[MAX_BLKSIZE + 1];
+			payload_len = netascii_decode(&session->decoder, data, len,
+						      decoded);
+			payload = decoded;
+		}
+
+		// uploads announcing no size are bounded as they are received
+		if (session->bytes + len > upload_max)
+		{
+			sprintf(log_message, "Upload file %s exceeds the "
+				"allowed size. Transfer cancelled.",
+				session->file_name);
+			print_log(ERROR, log_message);
+			send_error(session->sock, &session->cli_addr,
+				   ERR_DISK_FULL,
+				   "Disk full or allocation exceeded");
+			session->state = SESSION_FAILED;
+			return;
+		}
+
+		// queue the block to the writer thread
+		if (writer_write(session->writer, payload, payload_len) < 0)
+		{
+			sprintf(log_message, "Error while writing upload file "
+				"%s: errno = %d. Transfer cancelled.",
+				session->file_name, errno);
+			print_log(ERROR, log_message);
+			send_error(session->sock, &session->cli_addr,
+				   ERR_DISK_FULL,
+				   "Disk full or allocation exceeded");
+			session->state = SESSION_FAILED;
+			return;
+		}
+
+		// move past the received block
+		session->acked++;
+		session->in_flight++;
+		session->bytes += len;
+		rtt_progress(&session->rtt);
+		session->gap_acked = 0;
+		session->dup_acked = 0;
+
+		// a block shorter than the block size terminates the upload:
+		// the file is in place before the final ACK is sent
+		if (len < session->blksize)
+		{
+			if (finish_upload(session) < 0)
+			{
+				session->state = SESSION_FAILED;
+				return;
+			}
+			session->eof = 1;
+		}
+
+		// acknowledge at window boundaries and on the last block
+		if (session->eof || session->in_flight >= session->windowsize)
+		{
+			send_ack(session, &batch);
+		}
+		else
+		{
+			// the rest of the window is on its way
+			session->deadline = get_time_ms() +
+					    rtt_timeout_ms(&session->rtt);
+		}
+	}
+	else if (distance < session->windowsize && !session->eof) // AHEAD
+	{
+		session->anomalies.gaps++;
+
+		// report the gap once: the client goes back to the block
+		// following the acknowledged one
+		if (!session->gap_acked)
+		{
+			session->gap_acked = 1;
+			send_ack(session, &batch);
+		}
+	}
+	else						// ALREADY RECEIVED
+	{
+		session->anomalies.duplicate++;
+
+		// our ACK was lost: acknowledge again once, or every copy of
+		// the last block while the final ACK may have been lost
+		if (!session->dup_acked ||
+		    (session->eof &&
+		     block == wrap_block(session->acked, session->rollover)))
+		{
+			session->dup_acked = 1;
+			send_ack(session, &batch);
+		}
+	}
+
+	send_batch(session, &batch);
+}
+
+static int finish_upload(Session *session)
+{
+	// write a CR ending the file
+	char cr;
+	if (session->text_mode &&
+	    netascii_decode_end(&session->decoder, &cr) > 0)
+	{
+		writer_write(session->writer, &cr, 1);
+	}
+
+	// wait for the writer thread to write all the queued blocks
+	AsyncWriter *writer = session->writer;
+	session->writer = NULL;
+	if (writer_close(writer) < 0)
+	{
+		sprintf(log_message, "Error while writing upload file %s: "
+			"errno = %d. Transfer cancelled.", session->file_name,
+			errno);
+		print_log(ERROR, log_message);
+		send_error(session->sock, &session->cli_addr, ERR_DISK_FULL,
+			   "Disk full or allocation exceeded");
+		unlink(session->temp_path);
+		return -1;
+	}
+
+	// readers see either the previous file or the whole new one, a file
+	// created meanwhile is not replaced unless explicitly allowed
+	if (renameat2(AT_FDCWD, session->temp_path, AT_FDCWD, session->path,
+		      upload_overwrite ? 0 : RENAME_NOREPLACE) < 0)
+	{
+		sprintf(log_message, "Error while renaming upload file %s: "
+			"errno = %d. Transfer cancelled.", session->file_name,
+			errno);
+		print_log(ERROR, log_message);
+		if (errno == EEXIST)
+		{
+			send_error(session->sock, &session->cli_addr,
+				   ERR_FILE_EXISTS, "File already exists");
+		}
+		else
+		{
+			send_error(session->sock, &session->cli_addr,
+				   ERR_ACCESS, "Access violation");
+		}
+		unlink(session->temp_path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void close_upload(Session *session)
+{
+	// the upload was not completed: drop what was received
+	if (session->writer != NULL)
+	{
+		writer_close(session->writer);
+		unlink(session->temp_path);
+		session->writer = NULL;
+	}
+
+	free(session->path);
+	free(session->temp_path);
+	session->path = NULL;
+	session->temp_path = NULL;
+}
+
+void session_timeout(Session *session)
+{
+	// the client did not send the last block again: the final ACK was
+	// received
+	if (session->upload && session->eof)
+	{
+		session->state = SESSION_DONE;
+		return;
+	}
+
+	// outgoing packets batch
+	SendBatch batch;
+	batch_init(&batch, session->sock);
+
+	// the next round of a paced window is due, the blocks in flight did
+	// not time out yet
+	if (!session->upload && !session->oack &&
+	    (session->in_flight == 0 || get_time_ms() < session->retransmit))
+	{
+		// no ACK followed the gap reported within the round trip of
+		// the last go back: the blocks were lost indeed
+		if (session->deferred_gap != 0 &&
+		    get_time_us() >= go_back_end(session))
+		{
+			go_back(session);
+		}
+
+		send_window(session, &batch);
+		send_batch(session, &batch);
+		return;
+	}
+
+	// the peer may be slower than estimated: wait longer, or give up once
+	// the retry budget is spent
+	if (rtt_backoff(&session->rtt) < 0)
+	{
+		sprintf(log_message, "Transfer of %s timed out. Transfer "
+			"cancelled.", session->file_name);
+		print_log(ERROR, log_message);
+		session->state = SESSION_FAILED;
+		return;
+	}
+
+	if (session->oack || session->upload)
+	{
+		// the OACK or the last ACK was lost, send it again: the client
+		// goes back to the block following the acknowledged one
+		session->window[0].resent = 1;
+		session->in_flight = 0;
+		queue_packet(session, &batch, 0);
+	}
+	else
+	{
+		// go back to the last acknowledged block and send the window
+		// again, restarting from a single block unless the loss was
+		// random
+		cc_timeout(&session->cc, session->acked, session->sent,
+			   session->rtt.srtt, session->rtt.min_rtt);
+		session->deferred_gap = 0;
+		resend_window(session, &batch);
+	}
+
+	send_batch(session, &batch);
+}
+
+int session_send(Session *session, int packets)
+{
+	// outgoing packets batch
+	SendBatch batch;
+	batch_init(&batch, session->sock);
+
+	// fill the free slots allowed, the shaper decides the next ones
+	uint64_t sent = session->sent;
+	uint64_t total = session->packets;
+	session->quota = packets;
+	send_window(session, &batch);
+	session->quota = 0;
+
+	send_batch(session, &batch);
+
+	// first response of the transfer
+	if (total == 0 && session->packets > 0 && session->received > 0)
+	{
+		latency_record(get_time_us() - session->received);
+	}
+
+	return session->sent - sent;
+}
+
+int session_throttled(const Session *session)
+{
+	return session->flow.data != NULL && session_active(session) &&
+	       !session->upload && !session->oack && !session->eof &&
+	       session->in_flight < session->windowsize &&
+	       cc_budget(&session->cc, get_time_us(), session->rtt.srtt,
+			 session->rtt.rto) > 0;
+}
+
+int session_active(const Session *session)
+{
+	return session->state == SESSION_SENDING ||
+	       session->state == SESSION_RECEIVING;
+}
+
+void session_run(Session *session)
+{
+	// the only descriptor to wait on is the session socket
+	struct pollfd pfd;
+	pfd.fd = session->sock;
+	pfd.events = POLLIN;
+
+	session_start(session);
+
+	// until the transfer is completed or cancelled
+	while (session_active(session))
+	{
+		// wait for packets up to the retransmission deadline
+		uint64_t now = get_time_ms();
+		int timeout = session->deadline > now ?
+			      session->deadline - now : 0;
+
+		int ready = poll(&pfd, 1, timeout);
+
+		// interrupted by SIGUSR1: dump the statistics
+		if (ready < 0 && errno == EINTR && stats_requested)
+		{
+			print_stats();
+		}
+
+		if (ready > 0)
+		{
+			session_receive(session);
+		}
+		else if (ready == 0 || get_time_ms() >= session->deadline)
+		{
+			session_timeout(session);
+		}
+	}
+}
+
+void session_print_stats(const Session *session,
+			 void (*log)(LogType, const char *))
+{
+	// round trip times of the transfer
+	rtt_print_stats(&session->rtt, session->file_name, log);
+
+	// congestion window of windowed downloads
+	if (!session->upload && session->windowsize > 1)
+	{
+		cc_print_stats(&session->cc, log);
+	}
+
+	// blocks acknowledged and packets sent, block numbers wrapped after
+	// each 65535 blocks cycle
+	uint64_t cycle = 65536 - session->rollover;
+	uint64_t last = session->upload ? session->acked : session->sent;
+	sprintf(log_message, "Transferred %llu bytes of %s in %llu blocks with "
+		"%llu packets, %llu block number rollovers.",
+		(unsigned long long)session->bytes, session->file_name,
+		(unsigned long long)session->acked,
+		(unsigned long long)session->packets,
+		(unsigned long long)(last > 65535 ?
+				     (last - 65536) / cycle + 1 : 0));
+	log(INFO, log_message);
+
+	// unexpected packets received: DATA packets for uploads
+	const AckStats *anomalies = &session->anomalies;
+	const char *kind = session->upload ? "DATA packets" : "ACKs";
+	sprintf(log_message, "Anomalies of %s: %llu duplicate %s, %llu stale "
+		"%s, %llu gaps, %llu packets from other TIDs, %llu "
+		"unexpected packets.", session->file_name,
+		(unsigned long long)anomalies->duplicate, kind,
+		(unsigned long long)anomalies->stale, kind,
+		(unsigned long long)anomalies->gaps,
+		(unsigned long long)anomalies->foreign,
+		(unsigned long long)anomalies->unexpected);
+	log(INFO, log_message);
+}
+
+void session_destroy(Session *session)
+{
+	// close source file, or remove an incomplete upload, and free window
+	// buffers
+	if (session->upload)
+	{
+		close_upload(session);
+	}
+	else
+	{
+		block_source_close(session->source);
+	}
+	free(session->buffers);
+	free(session->window);
+
+	// shutdown and close transfer socket
+	shutdown(session->sock, SHUT_RDWR);
+	close(session->sock);
+
+	free(session);
+}
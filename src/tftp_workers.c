@@ -0,0 +1,236 @@
+/**
+ * File: tftp_workers.c
+ *       TFTP Server Sharded Workers Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <linux/filter.h>
+
+#include "../include/tftp_server.h"
+#include "../include/tftp_event.h"
+#include "../include/tftp_workers.h"
+
+int workers = 1;
+
+/**
+ * Workers listener sockets, in SO_REUSEPORT group order.
+ */
+static int listeners[MAX_WORKERS];
+
+/**
+ * Workers process ids.
+ */
+static pid_t worker_pids[MAX_WORKERS];
+
+/**
+ * Creates a SO_REUSEPORT listener socket bound to the given port.
+ *
+ * @param  port  server socket port.
+ *
+ * @return  the bound socket.
+ */
+static int create_worker_socket(int port);
+
+/**
+ * Attaches to the SO_REUSEPORT group of the given socket a classic BPF program
+ * selecting the listener by a hash of the client source address. Without it
+ * the kernel falls back to its own hash of the whole address and port tuple.
+ *
+ * @param  sockfd  a socket of the SO_REUSEPORT group.
+ */
+static void attach_steering_program(int sockfd);
+
+/**
+ * Forks the worker having the given index: the child pins itself to a core,
+ * closes the other listeners and runs the selected main loop.
+ *
+ * @param  index  worker index.
+ */
+static void spawn_worker(int index);
+
+static int create_worker_socket(int port)
+{
+	// create IPv4 UDP unbound socket
+	int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	check_errno(sockfd, "Error while creating worker UDP Socket");
+
+	// allow all the workers to bind the same address and port
+	int on = 1;
+	check_errno(setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on,
+			       sizeof(on)),
+		    "Error while enabling SO_REUSEPORT");
+
+	// bind to all local interfaces on the given port
+	struct sockaddr_in serv_addr;
+	memset(&serv_addr, 0, sizeof(serv_addr));
+	serv_addr.sin_family = AF_INET;
+	serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	serv_addr.sin_port = htons(port);
+
+	// associate the socket with its local address
+	int bound =
+	    bind(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr));
+	check_errno(bound, "Error while binding worker UDP Socket");
+
+	return sockfd;
+}
+
+static void attach_steering_program(int sockfd)
+{
+	// the accumulator returned is the index of the selected listener
+	struct sock_filter code[] = {
+		// A = client IPv4 source address
+		{BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_NET_OFF + 12},
+		// spread close addresses using a multiplicative hash
+		{BPF_ALU | BPF_MUL | BPF_K, 0, 0, 2654435761u},
+		{BPF_ALU | BPF_RSH | BPF_K, 0, 0, 16},
+		// A = A % workers
+		{BPF_ALU | BPF_MOD | BPF_K, 0, 0, workers},
+		{BPF_RET | BPF_A, 0, 0, 0},
+	};
+
+	struct sock_fprog prog;
+	prog.len = sizeof(code) / sizeof(code[0]);
+	prog.filter = code;
+
+	// attach the program to the whole SO_REUSEPORT group
+	if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) < 0)
+	{
+		sprintf(log_message, "Unable to attach the source address "
+			"steering program (errno = %d), using the kernel "
+			"SO_REUSEPORT hash.", errno);
+		print_log(ERROR, log_message);
+	}
+}
+
+static void spawn_worker(int index)
+{
+	// create a new process by duplicating the calling process
+	pid_t pid = fork();
+	check_errno(pid, "Error while creating worker process");
+
+	// parent process: keep track of the worker
+	if (pid > 0)
+	{
+		worker_pids[index] = pid;
+		return;
+	}
+
+	// terminate the worker together with its supervisor
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+	// pin the worker to its own core
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(index % (cores > 0 ? cores : 1), &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	{
+		print_log(ERROR, "Unable to pin worker process to its core.");
+	}
+
+	// close the other workers listeners, keeping them open would only
+	// waste descriptors: steering is done by the kernel
+	int i;
+	for (i = 0; i < workers; i++)
+	{
+		if (i != index)
+		{
+			close(listeners[i]);
+		}
+	}
+
+	// the worker listener becomes the server listener
+	listener = listeners[index];
+
+	// print info log message
+	sprintf(log_message, "Worker %d started on core %ld.", index,
+		index % (cores > 0 ? cores : 1));
+	print_log(INFO, log_message);
+
+	// start main loop
+	if (fork_mode)
+	{
+		listen_for_packets();
+	}
+	else
+	{
+		event_loop();
+	}
+
+	exit(0);
+}
+
+void start_workers(int port)
+{
+	// create the listeners before forking: the SO_REUSEPORT group index of
+	// each listener is given by the order the sockets are bound
+	int i;
+	for (i = 0; i < workers; i++)
+	{
+		listeners[i] = create_worker_socket(port);
+	}
+
+	// steer requests by client source address
+	attach_steering_program(listeners[0]);
+
+	// print info log message
+	sprintf(log_message, "TFTP Server successfully started with %d "
+		"workers on port %d.", workers, port);
+	print_log(INFO, log_message);
+
+	// fork the workers
+	for (i = 0; i < workers; i++)
+	{
+		spawn_worker(i);
+	}
+
+	// supervise the workers
+	while (1)
+	{
+		// wait for any worker to terminate
+		int status;
+		pid_t pid = wait(&status);
+
+		// interrupted by a signal: statistics are collected by the
+		// workers, forward them the request
+		if (pid < 0 && errno == EINTR)
+		{
+			if (stats_requested)
+			{
+				stats_requested = 0;
+				for (i = 0; i < workers; i++)
+				{
+					kill(worker_pids[i], SIGUSR1);
+				}
+			}
+			continue;
+		}
+
+		// check for errors
+		check_errno(pid, "Error while waiting for workers");
+
+		// spawn again the terminated worker on the same listener
+		for (i = 0; i < workers; i++)
+		{
+			if (worker_pids[i] == pid)
+			{
+				sprintf(log_message, "Worker %d terminated "
+					"unexpectedly. Restarting it.", i);
+				print_log(ERROR, log_message);
+
+				spawn_worker(i);
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,268 @@
+/**
+ * File: timer_wheel.c
+ *       Hierarchical Timer Wheel Source File.
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <string.h>
+
+#include "../include/timer_wheel.h"
+
+/**
+ * Largest delay covered by the wheel: later expirations are clamped and the
+ * timer is simply re-armed by its owner.
+ */
+#define WHEEL_RANGE ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+/**
+ * Links the given timer in the slot matching its expiration time, relative to
+ * the current wheel time. The expiration time must not be in the past.
+ *
+ * @param  wheel  the wheel;
+ * @param  timer  the timer.
+ */
+static void place(TimerWheel *wheel, Timer *timer);
+
+/**
+ * Unlinks the given timer from its slot.
+ *
+ * @param  wheel  the wheel;
+ * @param  timer  the timer.
+ */
+static void unlink_timer(TimerWheel *wheel, Timer *timer);
+
+/**
+ * Returns the distance, between 1 and 64, of the first non empty slot
+ * following the given one, wrapping around.
+ *
+ * @param  bitmap  non empty slots bitmap;
+ * @param  from    slot index.
+ *
+ * @return  the distance in slots.
+ */
+static int next_slot(uint64_t bitmap, int from);
+
+void wheel_init(TimerWheel *wheel, uint64_t now)
+{
+	memset(wheel, 0, sizeof(TimerWheel));
+	wheel->now = now;
+}
+
+void timer_init(Timer *timer, void *data)
+{
+	timer->expires = 0;
+	timer->armed = 0;
+	timer->data = data;
+	timer->prev = NULL;
+	timer->next = NULL;
+}
+
+void timer_arm(TimerWheel *wheel, Timer *timer, uint64_t expires)
+{
+	// already armed for the same time: nothing to do
+	if (timer->armed && timer->expires == expires)
+	{
+		return;
+	}
+
+	if (timer->armed)
+	{
+		unlink_timer(wheel, timer);
+	}
+
+	// the current tick was already processed
+	if (expires <= wheel->now)
+	{
+		expires = wheel->now + 1;
+	}
+
+	// delays beyond the wheel range expire earlier
+	if (expires - wheel->now > WHEEL_RANGE)
+	{
+		expires = wheel->now + WHEEL_RANGE;
+	}
+
+	timer->expires = expires;
+	place(wheel, timer);
+}
+
+void timer_cancel(TimerWheel *wheel, Timer *timer)
+{
+	if (timer->armed)
+	{
+		unlink_timer(wheel, timer);
+	}
+}
+
+void wheel_advance(TimerWheel *wheel, uint64_t now, void (*expire)(Timer *))
+{
+	while (wheel->now < now)
+	{
+		// nothing armed: jump straight to the current time
+		if (wheel->count == 0)
+		{
+			wheel->now = now;
+			break;
+		}
+
+		uint64_t tick = ++wheel->now;
+
+		// cascade the upper levels slots starting with this tick, from
+		// the highest one down
+		int level;
+		for (level = 1; level < WHEEL_LEVELS; level++)
+		{
+			if ((tick & ((1ULL << (WHEEL_BITS * level)) - 1)) != 0)
+			{
+				break;
+			}
+		}
+		while (--level >= 1)
+		{
+			int slot = (tick >> (WHEEL_BITS * level)) &
+				   (WHEEL_SLOTS - 1);
+			Timer *timer = wheel->slots[level][slot];
+			wheel->slots[level][slot] = NULL;
+			wheel->bitmap[level] &= ~(1ULL << slot);
+
+			// move the timers to the lower levels
+			while (timer != NULL)
+			{
+				Timer *next = timer->next;
+				wheel->count--;
+				place(wheel, timer);
+				timer = next;
+			}
+		}
+
+		// expire the timers of this tick
+		int slot = tick & (WHEEL_SLOTS - 1);
+		while (wheel->slots[0][slot] != NULL)
+		{
+			Timer *timer = wheel->slots[0][slot];
+			unlink_timer(wheel, timer);
+			expire(timer);
+		}
+	}
+}
+
+int wheel_next_timeout(TimerWheel *wheel, uint64_t now)
+{
+	// no timer armed
+	if (wheel->count == 0)
+	{
+		return -1;
+	}
+
+	// ticks not processed yet
+	if (now > wheel->now)
+	{
+		return 0;
+	}
+
+	// earliest tick the wheel must be advanced to
+	uint64_t earliest = UINT64_MAX;
+
+	int level;
+	for (level = 0; level < WHEEL_LEVELS; level++)
+	{
+		if (wheel->bitmap[level] == 0)
+		{
+			continue;
+		}
+
+		// first non empty slot after the current one of this level:
+		// upper levels slots are cascaded when their period starts
+		int shift = WHEEL_BITS * level;
+		int current = (wheel->now >> shift) & (WHEEL_SLOTS - 1);
+		int distance = next_slot(wheel->bitmap[level], current);
+		uint64_t tick = ((wheel->now >> shift) + distance) << shift;
+
+		if (tick < earliest)
+		{
+			earliest = tick;
+		}
+	}
+
+	// never sleep longer than the maximum epoll_wait() timeout
+	uint64_t timeout = earliest - wheel->now;
+	return timeout < INT32_MAX ? timeout : INT32_MAX;
+}
+
+static void place(TimerWheel *wheel, Timer *timer)
+{
+	// the level is given by the delay: level l covers delays up to 64^(l+1)
+	uint64_t delay = timer->expires - wheel->now;
+	int level = 0;
+	while (level < WHEEL_LEVELS - 1 &&
+	       delay >= (1ULL << (WHEEL_BITS * (level + 1))))
+	{
+		level++;
+	}
+
+	// the slot is given by the expiration time digit of that level
+	int slot = (timer->expires >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+
+	// push the timer on the head of the slot list
+	timer->prev = NULL;
+	timer->next = wheel->slots[level][slot];
+	if (timer->next != NULL)
+	{
+		timer->next->prev = timer;
+	}
+	wheel->slots[level][slot] = timer;
+	wheel->bitmap[level] |= 1ULL << slot;
+	wheel->count++;
+	timer->armed = 1;
+}
+
+static void unlink_timer(TimerWheel *wheel, Timer *timer)
+{
+	// find the slot the timer was placed in: the slot list head has no
+	// previous timer
+	if (timer->prev != NULL)
+	{
+		timer->prev->next = timer->next;
+	}
+	else
+	{
+		// the timer heads its slot list: look it up among the slots
+		// matching its expiration time
+		int level;
+		for (level = 0; level < WHEEL_LEVELS; level++)
+		{
+			int slot = (timer->expires >> (WHEEL_BITS * level)) &
+				   (WHEEL_SLOTS - 1);
+			if (wheel->slots[level][slot] == timer)
+			{
+				wheel->slots[level][slot] = timer->next;
+				if (timer->next == NULL)
+				{
+					wheel->bitmap[level] &= ~(1ULL << slot);
+				}
+				break;
+			}
+		}
+	}
+	if (timer->next != NULL)
+	{
+		timer->next->prev = timer->prev;
+	}
+
+	timer->prev = NULL;
+	timer->next = NULL;
+	timer->armed = 0;
+	wheel->count--;
+}
+
+static int next_slot(uint64_t bitmap, int from)
+{
+	// rotate the bitmap so that the slot following the given one is bit 0
+	int start = (from + 1) & (WHEEL_SLOTS - 1);
+	uint64_t rotated = start == 0 ? bitmap :
+			   (bitmap >> start) | (bitmap << (WHEEL_SLOTS - start));
+
+	return __builtin_ctzll(rotated) + 1;
+}
@@ -0,0 +1,122 @@
+#!/bin/bash
+#-------------------------------------------------------------------------------
+# File: cc_test.sh
+#       Congestion control loss and delay test.
+#
+#       Windowed downloads cross the link emulator of netem.py: random loss,
+#       a 10 ms one way delay and a 100 Mbit/s bottleneck, with a deep and a
+#       shallow drop tail queue, then a 10 Mbit/s bottleneck congested by the
+#       windows. Each scenario is run with the congestion control and with
+#       --no-cc, but the congested one: whole windows overflow its queue and
+#       their last blocks are only sent again on timeouts. Every transfer must
+#       complete, and the congestion window trace must show slow start, no
+#       loss nor timeout on the clean paths, random losses leaving the window
+#       unchanged and the window halved on congestion. Goodputs vary from
+#       machine to machine: a reference run is kept in tests/cc_expected.txt.
+#
+# Author: Rambod Rahmani <rambodrahmani@autistici.org>
+#         Created on 18/10/2026.
+#-------------------------------------------------------------------------------
+
+. "$(dirname "$0")/common.sh"
+
+# file size in MB
+SIZE=${SIZE:-8}
+
+# client options: the windows are much bigger than the path capacity
+OPTIONS="!blksize 1428\n!windowsize 64"
+
+# pid and port of the link emulator
+NETEM_PID=
+NETEM_PORT=
+
+# start_netem <loss> <delay ms> <rate Mbit/s> <queue packets>: starts the link
+# emulator in front of the running server
+start_netem() {
+	NETEM_PORT=$(free_port)
+	python3 "$(dirname "$0")/netem.py" "$NETEM_PORT" "$PORT" "$@" &
+	NETEM_PID=$!
+	sleep 0.3
+}
+
+# stops the link emulator
+stop_netem() {
+	kill "$NETEM_PID" 2> /dev/null
+	wait "$NETEM_PID" 2> /dev/null
+}
+
+# congestion_stats: prints the congestion window counters of the last transfer
+congestion_stats() {
+	grep "Congestion window" "$WORKDIR/server.log" | tail -1 |
+		sed 's/.*: cwnd/  cwnd/'
+}
+
+# trace_head: prints the first congestion window changes of the last transfer
+trace_head() {
+	grep "cwnd of file:" "$WORKDIR/server.log" | head -"${TRACE_LINES:-8}" |
+		sed 's/.*cwnd of file: /    /'
+}
+
+# traced <event>: checks that the congestion window trace holds the event
+traced() {
+	grep -q "cwnd of file: $1 at" "$WORKDIR/server.log"
+}
+
+# lost: checks that the last transfer reacted to at least a loss
+lost() {
+	congestion_stats | grep -qv " 0 losses"
+}
+
+# lossless: checks that the last transfer had no loss nor timeout
+lossless() {
+	congestion_stats | grep " 0 losses" | grep -q " 0 timeouts"
+}
+
+head -c "${SIZE}M" /dev/urandom > "$BASEDIR/file"
+
+# loss, delay, rate, queue and name of each scenario
+while read -r loss delay rate queue name; do
+	for mode in "--trace-cwnd" "--no-cc"; do
+		if [ "$name" = "congested" ] && [ "$mode" = "--no-cc" ]; then
+			continue
+		fi
+
+		echo "Scenario: $name, ${mode#--}"
+		start_server $mode
+		start_netem "$loss" "$delay" "$rate" "$queue"
+
+		check "transfer completed" throughput "$NETEM_PORT" file "$OPTIONS"
+		if [ "$mode" = "--trace-cwnd" ]; then
+			congestion_stats
+			trace_head
+			check "slow start traced" traced "slow start"
+			case "$name" in
+			loss-*)
+				check "losses detected" lost
+				check "random losses traced" traced "random loss"
+				;;
+			congested)
+				check "losses detected" lost
+				check "window reduced on loss" traced "loss"
+				check "congestion avoidance traced" \
+					traced "congestion avoidance"
+				;;
+			*)
+				check "no loss nor timeout" lossless
+				;;
+			esac
+		fi
+
+		stop_netem
+		stop_server
+	done
+done << 'SCENARIOS'
+0     10 100 1000 clean
+0.001 10 100 1000 loss-0.1%
+0.01  10 100 1000 loss-1%
+0.05  10 100 1000 loss-5%
+0     10 100 30   shallow-queue
+0     10 10  30   congested
+SCENARIOS
+
+summary
@@ -0,0 +1,106 @@
+#-------------------------------------------------------------------------------
+# File: common.sh
+#       Helpers shared by the test and benchmark scripts.
+#
+#       The scripts run the binaries built by the Makefile against a server
+#       listening on the loopback interface, within a temporary directory
+#       removed on exit.
+#
+# Author: Rambod Rahmani <rambodrahmani@autistici.org>
+#         Created on 18/10/2026.
+#-------------------------------------------------------------------------------
+
+# executable files directory, absolute
+BINDIR=$(cd "${BINDIR:-bin}" && pwd)
+
+# temporary directory of the script
+WORKDIR=$(mktemp -d /tmp/tftp_test.XXXXXX)
+
+# base directory served by the test server
+BASEDIR=$WORKDIR/base
+mkdir -p "$BASEDIR"
+
+# checks run and failed
+CHECKS=0
+FAILURES=0
+
+# pid of the running server
+SERVER_PID=
+
+# stop the server and remove the temporary files on exit
+cleanup() {
+	stop_server
+	rm -rf "$WORKDIR"
+}
+trap cleanup EXIT
+
+# prints a free UDP port on the loopback interface
+free_port() {
+	python3 -c 'import socket; s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM); s.bind(("127.0.0.1", 0)); print(s.getsockname()[1])'
+}
+
+# start_server <options...>: starts a server on a free port serving BASEDIR,
+# its port is saved in PORT
+start_server() {
+	PORT=$(free_port)
+	stdbuf -oL "$BINDIR/tftp_server" "$@" "$PORT" "$BASEDIR" > "$WORKDIR/server.log" 2>&1 &
+	SERVER_PID=$!
+	sleep 0.3
+}
+
+# stops the running server
+stop_server() {
+	if [ -n "$SERVER_PID" ]; then
+		kill "$SERVER_PID" 2> /dev/null
+		wait "$SERVER_PID" 2> /dev/null
+		SERVER_PID=
+	fi
+}
+
+# client <port> <commands>: runs the client with the given commands, one per
+# line, in WORKDIR
+client() {
+	(cd "$WORKDIR" && printf "$2\n!quit\n" | timeout "${CLIENT_TIMEOUT:-60}" "$BINDIR/tftp_client" 127.0.0.1 "$1" > "$WORKDIR/client.log" 2>&1)
+}
+
+# throughput <port> <name> <client commands>: downloads the given file from the
+# server after the given client commands and prints the goodput in Mbit/s
+throughput() {
+	local size start end
+	size=$(stat -c %s "$BASEDIR/$2")
+	rm -f "$WORKDIR/out"
+	start=$(date +%s.%N)
+	client "$1" "$3\n!get $2 out"
+	end=$(date +%s.%N)
+	if ! cmp -s "$BASEDIR/$2" "$WORKDIR/out"; then
+		echo "transfer failed"
+		return 1
+	fi
+	awk -v s="$size" -v a="$start" -v b="$end" \
+		'BEGIN { printf "%.1f Mbit/s (%.2f s)\n", s * 8 / (b - a) / 1e6, b - a }'
+}
+
+# server_stats: prints the statistics of the running server
+server_stats() {
+	kill -USR1 "$SERVER_PID"
+	sleep 0.2
+}
+
+# check <description> <command...>: runs the command as a check
+check() {
+	local description=$1
+	shift
+	CHECKS=$((CHECKS + 1))
+	if "$@"; then
+		echo "PASS: $description"
+	else
+		echo "FAIL: $description"
+		FAILURES=$((FAILURES + 1))
+	fi
+}
+
+# prints the checks summary, the exit status of the script
+summary() {
+	echo "$((CHECKS - FAILURES))/$CHECKS checks passed."
+	[ "$FAILURES" -eq 0 ]
+}
@@ -0,0 +1,33 @@
+#!/bin/bash
+#-------------------------------------------------------------------------------
+# File: gso_bench.sh
+#       UDP GSO versus plain sendmmsg() loopback benchmark.
+#
+#       The same file is downloaded with large windows from a server sending
+#       its DATA windows as UDP GSO buffers and from one started with
+#       --no-gso. The goodput of each run is printed along with the batching
+#       counters of the server: with GSO each window should leave in a single
+#       sendmmsg() call carrying one GSO buffer.
+#
+# Author: Rambod Rahmani <rambodrahmani@autistici.org>
+#         Created on 18/10/2026.
+#-------------------------------------------------------------------------------
+
+. "$(dirname "$0")/common.sh"
+
+# file size in MB, number of runs per mode
+SIZE=${SIZE:-64}
+RUNS=${RUNS:-3}
+
+head -c "${SIZE}M" /dev/urandom > "$BASEDIR/file"
+
+for mode in "" "--no-gso"; do
+	echo "Server mode: ${mode:-GSO}"
+	start_server --no-cc $mode
+	for run in $(seq "$RUNS"); do
+		throughput "$PORT" file "!blksize 1428\n!windowsize 64" || exit 1
+	done
+	server_stats
+	stop_server
+	grep -E "sendmmsg:|UDP GSO:" "$WORKDIR/server.log" | sed 's/^/  /'
+done
@@ -0,0 +1,86 @@
+#!/bin/bash
+#-------------------------------------------------------------------------------
+# File: meta_cache_test.sh
+#       Metadata cache fault injection test.
+#
+#       Files are served once, so that they are kept open by the metadata
+#       cache, then changed behind the server: rewritten, deleted, replaced by
+#       renaming the directory holding them or one of its parents. Every
+#       following request must be served with the new contents, or rejected.
+#       Names resolving outside of the base directory must always be refused.
+#
+# Author: Rambod Rahmani <rambodrahmani@autistici.org>
+#         Created on 18/10/2026.
+#-------------------------------------------------------------------------------
+
+. "$(dirname "$0")/common.sh"
+
+# get <name>: downloads the given file as WORKDIR/out
+get() {
+	rm -f "$WORKDIR/out"
+	client "$PORT" "!get $1 out"
+}
+
+# served <name> <contents>: checks that the given file is served with the given
+# contents
+served() {
+	get "$1" && [ "$(cat "$WORKDIR/out" 2> /dev/null)" = "$2" ]
+}
+
+# refused <name>: checks that the given file is not served
+refused() {
+	get "$1"
+	[ ! -e "$WORKDIR/out" ] && grep -q "Error" "$WORKDIR/client.log"
+}
+
+for mode in "" "--fork"; do
+	echo "Server mode: ${mode:-event loop}"
+	rm -rf "$BASEDIR"/*
+	mkdir -p "$BASEDIR/a/b/c"
+	echo "one" > "$BASEDIR/a/b/c/file"
+	echo "top" > "$BASEDIR/top"
+	start_server $mode
+
+	# names outside of the base directory
+	check "absolute name refused" refused /etc/passwd
+	check "parent directory refused" refused ../../../../etc/passwd
+	check "inner parent directory refused" refused a/../../../../etc/passwd
+
+	# cached files changed in place
+	check "file served" served a/b/c/file one
+	check "cached file served" served a/b/c/file one
+	echo "two" > "$BASEDIR/a/b/c/file"
+	check "rewritten file served" served a/b/c/file two
+
+	# the directory holding the file replaced
+	mv "$BASEDIR/a/b/c" "$BASEDIR/a/b/old"
+	mkdir "$BASEDIR/a/b/c"
+	echo "three" > "$BASEDIR/a/b/c/file"
+	check "file of a renamed directory served" served a/b/c/file three
+
+	# an intermediate directory replaced
+	mv "$BASEDIR/a/b" "$BASEDIR/a/old"
+	mkdir -p "$BASEDIR/a/b/c"
+	echo "four" > "$BASEDIR/a/b/c/file"
+	check "file of a renamed parent served" served a/b/c/file four
+
+	# a top level directory replaced
+	mv "$BASEDIR/a" "$BASEDIR/old"
+	mkdir -p "$BASEDIR/a/b/c"
+	echo "five" > "$BASEDIR/a/b/c/file"
+	check "file of a renamed top directory served" served a/b/c/file five
+
+	# deleted files
+	check "top file served" served top top
+	rm "$BASEDIR/top" "$BASEDIR/a/b/c/file"
+	check "deleted file refused" refused top
+	check "deleted nested file refused" refused a/b/c/file
+
+	# missing files created
+	echo "six" > "$BASEDIR/top"
+	check "created file served" served top six
+
+	stop_server
+done
+
+summary
@@ -0,0 +1,323 @@
+/**
+ * File: netascii_bench.c
+ *       Netascii Scanners Check and Microbenchmark.
+ *
+ *       Checks that the SSE2 and AVX2 scanners find the same bytes as the
+ *       scalar one over random buffers, at random alignments, with CR and LF
+ *       placed right before, on and after the vector boundaries, and that
+ *       every scanner encodes the same netascii streams, decoded back to the
+ *       original bytes whatever the output buffer splits. Then measures the
+ *       encoding and decoding throughput of each scanner on text and binary
+ *       contents.
+ *
+ *       Compile using the Provided Makefile.
+ *
+ *       Execute using
+ *          $ ./bin/netascii_bench [--check]
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/netascii.h"
+
+/**
+ * Random buffers checked per scanner.
+ */
+#define CHECK_ROUNDS 200000
+
+/**
+ * Longest random buffer checked.
+ */
+#define CHECK_MAX_LEN 300
+
+/**
+ * Size of the contents encoded and decoded by the benchmark.
+ */
+#define BENCH_SIZE (16 * 1024 * 1024)
+
+/**
+ * Output block size of the benchmark, as a DATA packet payload.
+ */
+#define BENCH_BLKSIZE 1428
+
+/**
+ * Scanners compared against the scalar one and their names.
+ */
+static const NetasciiScanner scanners[] = {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2};
+static const char *names[] = {"scalar", "SSE2", "AVX2"};
+#define SCANNERS (int)(sizeof(scanners) / sizeof(scanners[0]))
+
+/**
+ * State of the pseudo random generator.
+ */
+static unsigned long long seed = 88172645463325252ULL;
+
+/**
+ * Returns the next pseudo random number (xorshift64).
+ *
+ * @return  the pseudo random number.
+ */
+static unsigned long long next_random()
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+
+	return seed;
+}
+
+/**
+ * Returns the current time in nanoseconds.
+ *
+ * @return  the current monotonic time.
+ */
+static unsigned long long time_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Fills the given buffer with random bytes, mostly letters, with CR, LF and
+ * NUL bytes at the given density and at the vector boundaries.
+ *
+ * @param  buf      the buffer;
+ * @param  len      buffer length;
+ * @param  density  one special byte every density bytes on average.
+ */
+static void random_fill(char *buf, size_t len, int density)
+{
+	const char special[] = {'\r', '\n', '\0'};
+
+	size_t i;
+	for (i = 0; i < len; i++)
+	{
+		buf[i] = next_random() % density == 0 ?
+			 special[next_random() % 3] : (char)('a' + next_random() % 26);
+	}
+
+	// a special byte right before, on or after a 16 or 32 bytes boundary
+	if (len > 0 && next_random() % 2 == 0)
+	{
+		size_t boundary = 16 * (1 + next_random() % 4);
+		size_t at = boundary - 1 + next_random() % 3;
+		if (at < len)
+		{
+			buf[at] = special[next_random() % 2];
+		}
+	}
+}
+
+/**
+ * Encodes the given input with output blocks of the given size.
+ *
+ * @param  in       input bytes;
+ * @param  len      input length;
+ * @param  out      output buffer, at least 2 * len bytes long;
+ * @param  blksize  output block size.
+ *
+ * @return  the encoded length.
+ */
+static size_t encode_all(const char *in, size_t len, char *out, size_t blksize)
+{
+	NetasciiEncoder enc;
+	netascii_encoder_init(&enc);
+
+	size_t i = 0;
+	size_t o = 0;
+	for (;;)
+	{
+		size_t consumed;
+		size_t n = netascii_encode(&enc, in + i, len - i, &consumed,
+					   out + o, blksize);
+		i += consumed;
+		o += n;
+
+		// a block shorter than the block size is the last one
+		if (n < blksize)
+		{
+			break;
+		}
+	}
+
+	return o;
+}
+
+/**
+ * Decodes the given input split in blocks of the given size.
+ *
+ * @param  in       input bytes;
+ * @param  len      input length;
+ * @param  out      output buffer, at least len + 1 bytes long;
+ * @param  blksize  input block size.
+ *
+ * @return  the decoded length.
+ */
+static size_t decode_all(const char *in, size_t len, char *out, size_t blksize)
+{
+	NetasciiDecoder dec;
+	netascii_decoder_init(&dec);
+
+	size_t i = 0;
+	size_t o = 0;
+	while (i < len)
+	{
+		size_t n = len - i < blksize ? len - i : blksize;
+		o += netascii_decode(&dec, in + i, n, out + o);
+		i += n;
+	}
+	o += netascii_decode_end(&dec, out + o);
+
+	return o;
+}
+
+/**
+ * Checks every supported scanner against the scalar one.
+ *
+ * @return  the number of mismatches found.
+ */
+static int check()
+{
+	char buf[CHECK_MAX_LEN + 64];
+	char encoded[SCANNERS][2 * (CHECK_MAX_LEN + 64)];
+	size_t encoded_len[SCANNERS];
+	char decoded[CHECK_MAX_LEN + 65];
+	int failures = 0;
+
+	int round;
+	for (round = 0; round < CHECK_ROUNDS && failures < 10; round++)
+	{
+		// random length, alignment, density and output block size
+		size_t len = next_random() % (CHECK_MAX_LEN + 1);
+		size_t align = next_random() % 32;
+		char *in = buf + align;
+		random_fill(in, len, 2 + next_random() % 40);
+		size_t blksize = 1 + next_random() % 64;
+
+		// first match of both scans used by the encoder and decoder
+		size_t lf = 0;
+		size_t cr = 0;
+
+		int s;
+		for (s = 0; s < SCANNERS; s++)
+		{
+			if (netascii_select_scanner(scanners[s]) < 0)
+			{
+				continue;
+			}
+
+			size_t found_lf = netascii_scan(in, len, '\n', '\r');
+			size_t found_cr = netascii_scan(in, len, '\r', '\r');
+			encoded_len[s] = encode_all(in, len, encoded[s], blksize);
+			size_t n = decode_all(encoded[s], encoded_len[s],
+					      decoded, blksize);
+
+			// the scalar scanner is the reference
+			if (s == 0)
+			{
+				lf = found_lf;
+				cr = found_cr;
+			}
+			else if (found_lf != lf || found_cr != cr ||
+				 encoded_len[s] != encoded_len[0] ||
+				 memcmp(encoded[s], encoded[0],
+					encoded_len[0]) != 0)
+			{
+				fprintf(stderr, "%s differs from scalar: length "
+					"%zu, alignment %zu, block size %zu.\n",
+					names[s], len, align, blksize);
+				failures++;
+			}
+
+			// decoding restores the original bytes
+			if (n != len || memcmp(decoded, in, len) != 0)
+			{
+				fprintf(stderr, "%s round trip failed: length "
+					"%zu, alignment %zu, block size %zu.\n",
+					names[s], len, align, blksize);
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+/**
+ * Measures the encoding and decoding throughput of every supported scanner.
+ *
+ * @param  name     name of the contents;
+ * @param  in       contents;
+ * @param  len      contents length;
+ * @param  encoded  encoding buffer, at least 2 * len bytes long;
+ * @param  decoded  decoding buffer, at least len + 1 bytes long.
+ */
+static void bench(const char *name, const char *in, size_t len, char *encoded,
+		  char *decoded)
+{
+	int s;
+	for (s = 0; s < SCANNERS; s++)
+	{
+		if (netascii_select_scanner(scanners[s]) < 0)
+		{
+			printf("%-8s %-7s not supported by this CPU\n", name,
+			       names[s]);
+			continue;
+		}
+
+		unsigned long long start = time_ns();
+		size_t n = encode_all(in, len, encoded, BENCH_BLKSIZE);
+		unsigned long long middle = time_ns();
+		decode_all(encoded, n, decoded, BENCH_BLKSIZE);
+		unsigned long long end = time_ns();
+
+		printf("%-8s %-7s encode %7.0f MB/s, decode %7.0f MB/s\n", name,
+		       names[s], len * 1e3 / (middle - start),
+		       n * 1e3 / (end - middle));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int check_only = argc > 1 && strcmp(argv[1], "--check") == 0;
+
+	// equivalence of the scanners
+	int failures = check();
+	printf("Scanners check: %d random buffers, %d mismatches.\n",
+	       CHECK_ROUNDS, failures);
+	if (failures > 0 || check_only)
+	{
+		return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	char *in = malloc(BENCH_SIZE);
+	char *encoded = malloc(2 * BENCH_SIZE);
+	char *decoded = malloc(BENCH_SIZE + 1);
+	if (in == NULL || encoded == NULL || decoded == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	// text: lines of 60 characters on average
+	random_fill(in, BENCH_SIZE, 60);
+	bench("text", in, BENCH_SIZE, encoded, decoded);
+
+	// binary: a special byte every 4 KB on average
+	random_fill(in, BENCH_SIZE, 4096);
+	bench("binary", in, BENCH_SIZE, encoded, decoded);
+
+	free(in);
+	free(encoded);
+	free(decoded);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#-------------------------------------------------------------------------------
+# File: netem.py
+#       Loss, delay and bottleneck link emulator.
+#
+#       Relays the UDP packets between a client and a server on the loopback
+#       interface, dropping each packet with the given probability and
+#       delaying it by the given one way delay. Packets sent to the client
+#       cross a bottleneck link of the given rate with a drop tail queue of
+#       the given length, which drops the packets exceeding the link capacity
+#       as a router would. The random drops are seeded: a run is repeatable
+#       as long as the packets arrive in the same order.
+#
+#       Execute using
+#          $ python3 tests/netem.py <listen port> <server port> <loss>
+#                <delay ms> <rate Mbit/s> <queue packets>
+#
+#       Clients send their requests to the listen port, server replies are
+#       relayed from the transfer port they come from.
+#
+# Author: Rambod Rahmani <rambodrahmani@autistici.org>
+#         Created on 18/10/2026.
+#-------------------------------------------------------------------------------
+
+import heapq
+import random
+import select
+import socket
+import sys
+import time
+
+# command line arguments
+listen_port, server_port = int(sys.argv[1]), int(sys.argv[2])
+loss, delay = float(sys.argv[3]), float(sys.argv[4]) / 1000
+rate, queue_max = float(sys.argv[5]) * 125000, int(sys.argv[6])
+
+random.seed(7)
+
+# client facing and server facing sockets
+down = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+down.bind(('127.0.0.1', listen_port))
+up = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+up.bind(('127.0.0.1', 0))
+for s in (down, up):
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+
+# last client seen and server transfer address
+client = None
+server = ('127.0.0.1', server_port)
+
+# packets waiting for their delivery time, as (time, sequence, socket,
+# packet, address)
+pending = []
+sequence = 0
+
+# departure times of the packets queued at the bottleneck
+queued = []
+link_free = 0.0
+
+
+def schedule(when, sock, data, addr):
+    """Delivers the given packet at the given time."""
+    global sequence
+    sequence += 1
+    heapq.heappush(pending, (when, sequence, sock, data, addr))
+
+
+while True:
+    timeout = max(0, pending[0][0] - time.time()) if pending else 1.0
+    ready, _, _ = select.select([down, up], [], [], timeout)
+    now = time.time()
+
+    for s in ready:
+        for _ in range(64):
+            try:
+                data, addr = s.recvfrom(70000, socket.MSG_DONTWAIT)
+            except BlockingIOError:
+                break
+
+            if s is down:
+                # a new request goes to the listening server port
+                if data[:2] in (b'\x00\x01', b'\x00\x02'):
+                    client = addr
+                    server = ('127.0.0.1', server_port)
+                if random.random() < loss:
+                    continue
+                schedule(now + delay, up, data, server)
+            else:
+                # replies come from the transfer port
+                if addr[1] != server_port:
+                    server = addr
+                if random.random() < loss:
+                    continue
+
+                # drop tail bottleneck towards the client
+                while queued and queued[0] <= now:
+                    queued.pop(0)
+                if len(queued) >= queue_max:
+                    continue
+                link_free = max(now, link_free) + len(data) / rate
+                queued.append(link_free)
+                schedule(link_free + delay, down, data, client)
+
+    # deliver the packets whose time has come
+    now = time.time()
+    while pending and pending[0][0] <= now:
+        _, _, s, data, addr = heapq.heappop(pending)
+        s.sendto(data, addr)
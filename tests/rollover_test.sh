@@ -0,0 +1,61 @@
+#!/bin/bash
+#-------------------------------------------------------------------------------
+# File: rollover_test.sh
+#       Block number rollover and 64 bits block indexing test.
+#
+#       A sparse file larger than 4 GB, with marks written around the block
+#       number rollovers and the 32 bits offset boundary, is downloaded and
+#       uploaded again on the loopback interface. Its blocks wrap around many
+#       times: both copies must match the original, and the server must count
+#       the same number of bytes and rollovers.
+#
+# Author: Rambod Rahmani <rambodrahmani@autistici.org>
+#         Created on 18/10/2026.
+#-------------------------------------------------------------------------------
+
+. "$(dirname "$0")/common.sh"
+
+# file size in GB, block size
+SIZE=${SIZE:-5}
+BLKSIZE=1428
+
+# transfers of several GB take a while
+CLIENT_TIMEOUT=${CLIENT_TIMEOUT:-900}
+
+# mark <offset>: writes a mark at the given offset of the file
+mark() {
+	printf "mark at %d" "$1" | dd of="$BASEDIR/file" bs=1 seek="$1" \
+		conv=notrunc status=none
+}
+
+truncate -s "${SIZE}G" "$BASEDIR/file"
+BYTES=$(stat -c %s "$BASEDIR/file")
+BLOCKS=$((BYTES / BLKSIZE + 1))
+
+# around the first block number rollovers and the 4 GB boundary
+mark 0
+mark $((65535 * BLKSIZE - 5))
+mark $((65536 * BLKSIZE))
+mark $((2 * 65536 * BLKSIZE + 7))
+mark $((4 * 1024 * 1024 * 1024 - 3))
+mark $((BYTES - 20))
+
+# stats_match <transfer>: checks the bytes and rollovers counted by the server
+# for the last transfer, with rollover 0 a cycle is 65536 blocks long
+stats_match() {
+	grep "Transferred $BYTES bytes of $1 in $BLOCKS blocks" "$WORKDIR/server.log" |
+		grep -q " $(((BLOCKS - 65536) / 65536 + 1)) block number rollovers"
+}
+
+start_server --max-upload $((SIZE * 1024))
+
+rm -f "$WORKDIR/out"
+client "$PORT" "!blksize $BLKSIZE\n!windowsize 64\n!get file out"
+check "download of $SIZE GB matches" cmp -s "$BASEDIR/file" "$WORKDIR/out"
+check "download bytes and rollovers counted" stats_match file
+
+client "$PORT" "!blksize $BLKSIZE\n!windowsize 64\n!put out copy"
+check "upload of $SIZE GB matches" cmp -s "$BASEDIR/file" "$BASEDIR/copy"
+check "upload bytes and rollovers counted" stats_match copy
+
+summary
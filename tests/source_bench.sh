@@ -0,0 +1,33 @@
+#!/bin/bash
+#-------------------------------------------------------------------------------
+# File: source_bench.sh
+#       Block source strategies loopback benchmark.
+#
+#       The same file, already in the page cache, is downloaded from servers
+#       started with each --source strategy, in binary and text mode: the
+#       goodput shows the cost of the preadv() copy against the mapping, whose
+#       size is checked with fstat() before each window, and the block cache.
+#
+# Author: Rambod Rahmani <rambodrahmani@autistici.org>
+#         Created on 18/10/2026.
+#-------------------------------------------------------------------------------
+
+. "$(dirname "$0")/common.sh"
+
+# file size in MB, number of runs per strategy
+SIZE=${SIZE:-64}
+RUNS=${RUNS:-3}
+
+head -c "${SIZE}M" /dev/urandom > "$BASEDIR/file"
+cat "$BASEDIR/file" > /dev/null
+
+for mode in bin txt; do
+	for source in pread mmap cache; do
+		echo "Source: $source, mode: $mode"
+		start_server --no-cc --source $source --cache-size $((SIZE * 3))
+		for run in $(seq "$RUNS"); do
+			throughput "$PORT" file "!mode $mode\n!blksize 1428\n!windowsize 64" || exit 1
+		done
+		stop_server
+	done
+done
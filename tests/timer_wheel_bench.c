@@ -0,0 +1,329 @@
+/**
+ * File: timer_wheel_bench.c
+ *       Timer Wheel Churn Microbenchmark.
+ *
+ *       Simulates the retransmission deadlines of N sessions served by the
+ *       event loop: every wake up of the loop re-arms the sessions receiving
+ *       an ACK and replaces a completed session with a new one, while the
+ *       sessions of stalled clients expire and are re-armed with a backoff.
+ *       The same workload is run on the timer wheel and on a plain array of
+ *       deadlines scanned after each wake up, as the event loop used to do,
+ *       and both must fire the same number of timeouts.
+ *
+ *       Compile using the Provided Makefile.
+ *
+ *       Execute using
+ *          $ ./bin/timer_wheel_bench [wake ups]
+ *
+ * Author: Rambod Rahmani <rambodrahmani@autistici.org>
+ *         Created on 18/10/2026.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/timer_wheel.h"
+
+/**
+ * ACKs received and sessions replaced per wake up of the loop.
+ */
+#define ACKS_PER_WAKEUP 16
+#define CHURN_PER_WAKEUP 1
+
+/**
+ * Wake ups of the loop per millisecond.
+ */
+#define WAKEUPS_PER_MS 4
+
+/**
+ * One session every STALLED_EVERY belongs to a stalled client, never sending
+ * an ACK.
+ */
+#define STALLED_EVERY 10
+
+/**
+ * Retransmission timeouts drawn by the simulated sessions (ms).
+ */
+#define MIN_RTO 200
+#define MAX_RTO 3000
+
+/**
+ * Timeout armed after a retransmission (ms): not drawn at random, so that the
+ * random sequence does not depend on the order the timeouts are fired in.
+ */
+#define BACKOFF_RTO (2 * MAX_RTO)
+
+/**
+ * State of the pseudo random generator, reset before each run so that both
+ * runs see the same workload.
+ */
+static uint64_t seed;
+
+/**
+ * Timeouts fired by the run in progress.
+ */
+static uint64_t fired;
+
+/**
+ * Deadlines of the scanned array run.
+ */
+static uint64_t *deadlines;
+
+/**
+ * Timers of the wheel run.
+ */
+static Timer *timers;
+static TimerWheel wheel;
+
+/**
+ * Simulated time of the run in progress (ms).
+ */
+static uint64_t now;
+
+/**
+ * Returns the next pseudo random number (xorshift64).
+ *
+ * @return  the pseudo random number.
+ */
+static uint64_t next_random()
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+
+	return seed;
+}
+
+/**
+ * Returns a pseudo random retransmission timeout.
+ *
+ * @return  the timeout in milliseconds.
+ */
+static uint64_t random_rto()
+{
+	return MIN_RTO + next_random() % (MAX_RTO - MIN_RTO);
+}
+
+/**
+ * Returns a pseudo random session of a client sending ACKs.
+ *
+ * @param  sessions  number of sessions.
+ *
+ * @return  the session index.
+ */
+static int random_active(int sessions)
+{
+	int i = next_random() % sessions;
+
+	return i % STALLED_EVERY == 0 ? (i + 1) % sessions : i;
+}
+
+/**
+ * Returns the current time in nanoseconds.
+ *
+ * @return  the current monotonic time.
+ */
+static uint64_t time_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Wheel expiration callback: the retransmission deadline is armed again with
+ * the backoff timeout.
+ *
+ * @param  timer  the expired timer.
+ */
+static void expire(Timer *timer)
+{
+	// a timer must never fire before its expiration time
+	if (timer->expires > now)
+	{
+		fprintf(stderr, "Timer fired %llu ms early.\n",
+			(unsigned long long)(timer->expires - now));
+		exit(EXIT_FAILURE);
+	}
+
+	fired++;
+	timer_arm(&wheel, timer, now + BACKOFF_RTO);
+}
+
+/**
+ * Runs the workload on the timer wheel.
+ *
+ * @param  sessions    number of sessions;
+ * @param  iterations  number of wake ups of the loop.
+ *
+ * @return  the elapsed time in nanoseconds.
+ */
+static uint64_t run_wheel(int sessions, int iterations)
+{
+	seed = 88172645463325252ULL;
+	fired = 0;
+	now = 0;
+
+	// every session starts with its own deadline
+	wheel_init(&wheel, now);
+	int i;
+	for (i = 0; i < sessions; i++)
+	{
+		timer_init(&timers[i], NULL);
+		timer_arm(&wheel, &timers[i], now + random_rto());
+	}
+
+	uint64_t start = time_ns();
+	int it;
+	for (it = 0; it < iterations; it++)
+	{
+		now = it / WAKEUPS_PER_MS;
+
+		// ACKs re-arm the deadline of their session
+		for (i = 0; i < ACKS_PER_WAKEUP; i++)
+		{
+			Timer *timer = &timers[random_active(sessions)];
+			timer_arm(&wheel, timer, now + random_rto());
+		}
+
+		// completed sessions are replaced by new ones
+		for (i = 0; i < CHURN_PER_WAKEUP; i++)
+		{
+			Timer *timer = &timers[random_active(sessions)];
+			timer_cancel(&wheel, timer);
+			timer_arm(&wheel, timer, now + random_rto());
+		}
+
+		// fire the expired deadlines and compute the next timeout
+		wheel_advance(&wheel, now, expire);
+		wheel_next_timeout(&wheel, now);
+	}
+
+	return time_ns() - start;
+}
+
+/**
+ * Runs the workload on an array of deadlines scanned after each iteration.
+ *
+ * @param  sessions    number of sessions;
+ * @param  iterations  number of wake ups of the loop.
+ *
+ * @return  the elapsed time in nanoseconds.
+ */
+static uint64_t run_scan(int sessions, int iterations)
+{
+	seed = 88172645463325252ULL;
+	fired = 0;
+	now = 0;
+
+	// every session starts with its own deadline
+	int i;
+	for (i = 0; i < sessions; i++)
+	{
+		deadlines[i] = now + random_rto();
+	}
+
+	// earliest deadline, used as the poll timeout
+	volatile uint64_t earliest = 0;
+
+	uint64_t start = time_ns();
+	int it;
+	for (it = 0; it < iterations; it++)
+	{
+		now = it / WAKEUPS_PER_MS;
+
+		// ACKs re-arm the deadline of their session
+		for (i = 0; i < ACKS_PER_WAKEUP; i++)
+		{
+			int session = random_active(sessions);
+			deadlines[session] = now + random_rto();
+		}
+
+		// completed sessions are replaced by new ones
+		for (i = 0; i < CHURN_PER_WAKEUP; i++)
+		{
+			int session = random_active(sessions);
+			deadlines[session] = now + random_rto();
+		}
+
+		// scan every session: fire the expired deadlines and find the
+		// earliest one
+		uint64_t min = UINT64_MAX;
+		for (i = 0; i < sessions; i++)
+		{
+			if (deadlines[i] <= now)
+			{
+				fired++;
+				deadlines[i] = now + BACKOFF_RTO;
+			}
+			if (deadlines[i] < min)
+			{
+				min = deadlines[i];
+			}
+		}
+		earliest = min;
+	}
+	(void)earliest;
+
+	return time_ns() - start;
+}
+
+int main(int argc, char **argv)
+{
+	// wake ups of the loop of each run
+	int iterations = argc > 1 ? atoi(argv[1]) : 40000;
+	if (iterations <= 0)
+	{
+		fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int sizes[] = {100, 1000, 10000, 100000};
+	int max = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+
+	deadlines = malloc(max * sizeof(uint64_t));
+	timers = malloc(max * sizeof(Timer));
+	if (deadlines == NULL || timers == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%9s %12s %12s %10s %10s\n", "sessions", "wheel ns/op",
+	       "scan ns/op", "speedup", "timeouts");
+
+	int failed = 0;
+	size_t s;
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		int sessions = sizes[s];
+
+		// operations per wake up: ACKs, churn and the timeouts
+		double ops = (double)iterations *
+			     (ACKS_PER_WAKEUP + CHURN_PER_WAKEUP + 1);
+
+		uint64_t wheel_ns = run_wheel(sessions, iterations);
+		uint64_t wheel_fired = fired;
+		uint64_t scan_ns = run_scan(sessions, iterations);
+
+		printf("%9d %12.1f %12.1f %9.1fx %10llu\n", sessions,
+		       wheel_ns / ops, scan_ns / ops, (double)scan_ns / wheel_ns,
+		       (unsigned long long)wheel_fired);
+
+		// both runs must fire the same deadlines
+		if (wheel_fired != fired)
+		{
+			fprintf(stderr, "Timeouts mismatch: wheel %llu, scan "
+				"%llu.\n", (unsigned long long)wheel_fired,
+				(unsigned long long)fired);
+			failed = 1;
+		}
+	}
+
+	free(deadlines);
+	free(timers);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
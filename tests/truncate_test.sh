@@ -0,0 +1,54 @@
+#!/bin/bash
+#-------------------------------------------------------------------------------
+# File: truncate_test.sh
+#       Block source truncation test.
+#
+#       Files are truncated while being downloaded, slowed down by the
+#       bandwidth shaper, with each block source strategy and transfer mode.
+#       The transfer must be cancelled with an error, while the server keeps
+#       running and serving the following requests: a mapped file truncated
+#       under the server must never raise SIGBUS.
+#
+# Author: Rambod Rahmani <rambodrahmani@autistici.org>
+#         Created on 18/10/2026.
+#-------------------------------------------------------------------------------
+
+. "$(dirname "$0")/common.sh"
+
+# cancelled: checks that the last download was cancelled with an error
+cancelled() {
+	! cmp -s "$WORKDIR/original" "$WORKDIR/out" &&
+		grep -q "Error" "$WORKDIR/client.log"
+}
+
+# alive: checks that the server is still running and serving files
+alive() {
+	kill -0 "$SERVER_PID" 2> /dev/null || return 1
+	rm -f "$WORKDIR/out"
+	client "$PORT" "!get small out" &&
+		[ "$(cat "$WORKDIR/out" 2> /dev/null)" = "small" ]
+}
+
+echo "small" > "$BASEDIR/small"
+head -c 8M /dev/urandom | base64 > "$WORKDIR/original"
+
+for source in pread mmap; do
+	for mode in bin txt; do
+		echo "Source: $source, mode: $mode"
+		cp "$WORKDIR/original" "$BASEDIR/file"
+		start_server --source $source --rate 32
+
+		# truncate the file once the transfer is well under way
+		rm -f "$WORKDIR/out"
+		client "$PORT" "!mode $mode\n!blksize 1428\n!windowsize 16\n!get file out" &
+		sleep 1
+		truncate -s 1M "$BASEDIR/file"
+		wait $!
+
+		check "truncated file cancelled" cancelled
+		check "server still serving" alive
+		stop_server
+	done
+done
+
+summary